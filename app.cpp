@@ -1,18 +1,28 @@
 #include "app.hpp"
+#include "drawList.hpp"
 #include "helloVulkanDevice.hpp"
 #include "helloVulkanPipeline.hpp"
 #include "model.hpp"
+#include "profiler.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <glm/fwd.hpp>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -22,23 +32,225 @@ namespace helloVulkan {
     glm::mat4 transform;
   };
 
-  App::App() {
+  struct FragmentConstants {
+    uint32_t colourMode;
+  };
+
+  template <>
+  struct SpecializationLayout<FragmentConstants> {
+    static constexpr auto members = std::make_tuple(&FragmentConstants::colourMode);
+  };
+
+  constexpr uint32_t COLOUR_MODE_COUNT = 3;
+  // how often the main thread checks its job queue while the render thread runs
+  constexpr double MAIN_THREAD_WAKE_SECONDS = 0.005;
+
+  App::App() : App(defaultConfig()) {}
+
+  App::App(AppConfig config) : config{std::move(config)} {
+    const char *disableRenderThread = std::getenv("HELLO_VULKAN_DISABLE_RENDER_THREAD");
+    if (disableRenderThread != nullptr && std::string{disableRenderThread} == "1") {
+      this->config.renderThread = false;
+    }
+    const char *disableOcclusionCulling = std::getenv("HELLO_VULKAN_DISABLE_OCCLUSION_CULLING");
+    if (disableOcclusionCulling != nullptr && std::string{disableOcclusionCulling} == "1") {
+      this->config.occlusionCulling = false;
+    }
+    if (this->config.occlusionCulling && this->config.instancing) {
+      throw std::runtime_error("Occlusion culling tests separate draws, it can't be combined with instancing");
+    }
+    if (this->config.vertexPulling) {
+      if (this->config.instancing || this->config.occlusionCulling || this->config.procedural) {
+        throw std::runtime_error("Vertex pulling draws the mesh as separate objects, without instancing, occlusion culling or procedural geometry");
+      }
+      if (this->config.vertexFormats.empty()) {
+        throw std::runtime_error("Vertex pulling needs at least one vertex format");
+      }
+    }
+    helloVulkanSwapChain = std::make_unique<HelloVulkanSwapChain>(
+        helloVulkanDevice,
+        helloVulkanWindow.getExtent(),
+        this->config.presentMode,
+        nullptr,
+        this->config.occlusionCulling);
     loadModels();
+    if (this->config.particles) {
+      particleSystem = std::make_unique<ParticleSystem>(helloVulkanDevice, *this->config.particles);
+    }
     createPipelineLayout();
-    createPipeline();
+    createPipelines();
     createCommandBuffers();
+    if (this->config.capture) {
+      if (!helloVulkanSwapChain->canCopyImages()) {
+        throw std::runtime_error("Frame capture needs swap chain images that can be copied from");
+      }
+      frameCapture = std::make_unique<FrameCapture>(
+          helloVulkanDevice,
+          helloVulkanSwapChain->getSwapChainExtent(),
+          helloVulkanSwapChain->getSwapChainImageFormat(),
+          *this->config.capture);
+    }
+    if (this->config.occlusionCulling) {
+      depthPyramid = std::make_unique<DepthPyramid>(
+          helloVulkanDevice,
+          helloVulkanSwapChain->getSwapChainExtent(),
+          helloVulkanSwapChain->getDepthImageViews());
+    }
+    for (int i = 0; i < HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+      renderGraphs.push_back(std::make_unique<RenderGraph>(helloVulkanDevice));
+    }
+
+    frameStats.startupMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - constructionStart).count();
   }
 
   App::~App() {
+    particleSystem.reset();
+    destroyComputeAnimation();
+    if (instanceBuffer != VK_NULL_HANDLE) {
+      vkDestroyBuffer(helloVulkanDevice.device(), instanceBuffer, nullptr);
+      helloVulkanDevice.freeMemory(instanceBufferMemory);
+    }
     vkDestroyPipelineLayout(helloVulkanDevice.device(), pipelineLayout, nullptr);
   }
 
+  AppConfig App::defaultConfig() {
+    glm::vec3 colourPurple { 0.3f, 0.0f, 0.5f };
+    AppConfig config{};
+    config.meshVertices = {
+      {{-0.5f, -0.5f, 0.5f, 1.0f}, colourPurple},
+      {{0.5f, -0.5f, 0.5f, 1.0f}, colourPurple},
+      {{0.5f, 0.5f, 0.5f, 1.0f}, colourPurple},
+      {{-0.5f, 0.5f, 0.5f, 1.0f}, colourPurple},
+    };
+    config.meshIndices = {0, 1, 2, 0, 2, 3};
+
+    float xScale = 0.5f;
+    float yScale = 0.5f;
+    float zScale = 0.5f;
+    glm::mat4 transform = {
+      xScale, 0.0f, 0.0f, 0.0f,
+      0.0f, yScale, 0.0f, 0.0f,
+      0.0f, 0.0f, zScale, 0.0f,
+      0.0f, 0.0f, 0.5f, 1.0f
+    };
+    config.objectTransforms = std::vector<glm::mat4>(4, transform);
+    return config;
+  }
+
+  AppConfig App::sierpinskiTriangle(uint32_t depth) {
+    AppConfig config{};
+    ProceduralDesc desc{};
+    desc.shape = ProceduralShape::sierpinskiTriangle;
+    desc.depth = depth;
+    config.procedural = desc;
+
+    glm::mat4 transform = {
+      1.6f, 0.0f, 0.0f, 0.0f,
+      0.0f, 1.6f, 0.0f, 0.0f,
+      0.0f, 0.0f, 0.5f, 0.0f,
+      0.0f, 0.0f, 0.5f, 1.0f
+    };
+    config.objectTransforms = {transform};
+    return config;
+  }
+
   void App::run() {
-    while(!helloVulkanWindow.shouldClose()) {
-      glfwPollEvents();
-      drawFrame();
+    renderLoop(UINT32_MAX, {});
+  }
+
+  void App::runFrames(uint32_t frameCount, const std::function<void(const FrameStats &)> &onFrame) {
+    renderLoop(frameCount, onFrame);
+  }
+
+  void App::renderLoop(uint32_t frameCount, const std::function<void(const FrameStats &)> &onFrame) {
+    auto frames = [&] {
+      for (uint32_t i = 0; i < frameCount && !helloVulkanWindow.shouldClose(); i++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        if (!config.renderThread) {
+          {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+          }
+          jobSystem.pumpMainThread();
+        }
+        drawFrame();
+        PROFILE_FRAME_END();
+        if (!onFrame) {
+          continue;
+        }
+
+        frameStats.cpuFrameTimeMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - frameStart).count();
+        frameStats.deviceMemoryAllocationCount = helloVulkanDevice.memoryAllocationCount();
+        frameStats.deviceMemoryBytes = helloVulkanDevice.liveMemoryBytes();
+        frameStats.pipelineStatisticsAvailable = pipelineStatistics->latest(frameStats.pipelineStatistics);
+        frameStats.pipelinesCreated = Pipeline::createdCount();
+        frameStats.dynamicRendering = helloVulkanSwapChain->usesDynamicRendering();
+        if (asyncCompute) {
+          frameStats.asyncComputeQueue = asyncCompute->separateQueue();
+          frameStats.asyncCompute = asyncCompute->timings();
+        }
+        frameStats.pipelineRegistry = pipelineRegistry.stats();
+        frameStats.shaderLoadMs = ShaderLibrary::loadTimeMs() - shaderLoadMsAtConstruction;
+        frameStats.renderThread = config.renderThread;
+        frameStats.simulationTick = frameState.tick;
+        frameStats.simulationTicks = simulation.ticks();
+        if (frameCapture) {
+          frameStats.capture = frameCapture->stats();
+        }
+        onFrame(frameStats);
+      }
+      vkDeviceWaitIdle(helloVulkanDevice.device());
+      if (frameCapture) {
+        frameCapture->flush();
+      }
+    };
+
+    if (!config.renderThread) {
+      frames();
+      return;
+    }
+    runOnRenderThread(frames);
+  }
+
+  void App::runOnRenderThread(const std::function<void()> &frames) {
+    std::atomic<bool> finished{false};
+    std::exception_ptr error;
+    simulation.start();
+    std::thread renderThread{[&] {
+      // the frames' jobs are queued from here now
+      jobSystem.setSubmitThread();
+      try {
+        frames();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      finished.store(true);
+      glfwPostEmptyEvent();
+    }};
+
+    // GLFW has to stay on the main thread, and the job system's main thread queue with it. The
+    // timeout bounds how long that queue waits when there are no window events.
+    while (!finished.load()) {
+      glfwWaitEventsTimeout(MAIN_THREAD_WAKE_SECONDS);
+      jobSystem.pumpMainThread();
+    }
+    renderThread.join();
+    simulation.stop();
+    jobSystem.setSubmitThread();
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void App::setRenderState(const DynamicRenderState &renderState) {
+    config.renderState = renderState;
+    if (!helloVulkanDevice.extendedDynamicState().enabled) {
+      // baked into the pipeline, the old one may still be in use by a frame in flight
+      vkDeviceWaitIdle(helloVulkanDevice.device());
+      createPipelines();
     }
-    vkDeviceWaitIdle(helloVulkanDevice.device());
   }
 
   enum axis {
@@ -47,10 +259,7 @@ namespace helloVulkan {
     axisz
   };
 
-  glm::mat4 calculateRotationMatrix(axis axisOfRotation) {
-    static float rotation = -.25f * glm::two_pi<float>();
-    rotation += 0.01;
-
+  glm::mat4 calculateRotationMatrix(axis axisOfRotation, float rotation) {
     float ix = glm::cos(rotation);
     float iy = glm::sin(rotation);
     float iz = glm::sin(rotation);
@@ -84,17 +293,86 @@ namespace helloVulkan {
   // 4) Does the attribute description need to match the Vertex.position size?
   
   void App::loadModels() {
-    glm::vec3 colourPurple { 0.3f, 0.0f, 0.5f };
-    std::vector<Model::Vertex> vertices = {
-      {{-0.5f, -0.5f, 0.5f, 1.0f}, colourPurple},
-      {{0.5f, -0.5f, 0.5f, 1.0f}, colourPurple},
-      {{0.5f, 0.5f, 0.5f, 1.0f}, colourPurple},
-      {{-0.5f, -0.5f, 0.5f, 1.0f}, colourPurple},
-      {{0.5f, 0.5f, 0.5f, 1.0f}, colourPurple},
-      {{-0.5f, 0.5f, 0.5f, 1.0f}, colourPurple},
-    };
+    if (config.procedural) {
+      loadProceduralModel();
+    } else {
+      geometryPool = std::make_unique<GeometryPool>(
+          helloVulkanDevice,
+          static_cast<uint32_t>(sizeof(Model::Vertex)),
+          std::max(GeometryPool::DEFAULT_VERTEX_CAPACITY, static_cast<uint32_t>(config.meshVertices.size())),
+          std::max(GeometryPool::DEFAULT_INDEX_CAPACITY, static_cast<uint32_t>(config.meshIndices.size())));
+      model = std::make_unique<Model>(*geometryPool, config.meshVertices, config.meshIndices);
+    }
+
+    // procedural shapes all fit the same box
+    meshBoundsMin = glm::vec3{-0.5f};
+    meshBoundsMax = glm::vec3{0.5f};
+    if (!config.procedural && !config.meshVertices.empty()) {
+      meshBoundsMin = meshBoundsMax = glm::vec3{config.meshVertices[0].position};
+      for (const Model::Vertex &vertex : config.meshVertices) {
+        meshBoundsMin = glm::min(meshBoundsMin, glm::vec3{vertex.position});
+        meshBoundsMax = glm::max(meshBoundsMax, glm::vec3{vertex.position});
+      }
+    }
+    const GeometryRange &range = model->geometryRange();
+    meshTriangles = (range.indexCount > 0 ? range.indexCount : range.vertexCount) / 3;
+
+    if (config.instancing) {
+      createInstanceBuffer();
+      if (config.computeAnimation) {
+        createComputeAnimation();
+      }
+    }
+
+    if (config.vertexPulling) {
+      // the same mesh once in each format, the words needed are at most the full format's
+      size_t formatCount = config.vertexFormats.size();
+      size_t indexCount = config.meshIndices.empty() ? config.meshVertices.size() : config.meshIndices.size();
+      vertexPulling = std::make_unique<VertexPulling>(
+          helloVulkanDevice,
+          HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT,
+          std::max<uint32_t>(
+              GeometryPool::DEFAULT_VERTEX_CAPACITY,
+              static_cast<uint32_t>(formatCount * config.meshVertices.size() * vertexFormatWords(VertexFormat::full))),
+          std::max<uint32_t>(GeometryPool::DEFAULT_INDEX_CAPACITY, static_cast<uint32_t>(formatCount * indexCount)));
+      pulledMeshes.clear();
+      for (VertexFormat format : config.vertexFormats) {
+        pulledMeshes.push_back(vertexPulling->addMesh(config.meshVertices, config.meshIndices, format));
+      }
+    }
+  }
 
-    model = std::make_unique<Model>(helloVulkanDevice, vertices);
+  void App::loadProceduralModel() {
+    PROFILE_FUNCTION();
+    const ProceduralDesc &desc = *config.procedural;
+    uint32_t vertexCount = proceduralVertexCount(desc);
+    geometryPool = std::make_unique<GeometryPool>(
+        helloVulkanDevice,
+        static_cast<uint32_t>(sizeof(Model::Vertex)),
+        std::max(GeometryPool::DEFAULT_VERTEX_CAPACITY, vertexCount));
+    GeometryRange range = geometryPool->reserve(vertexCount, 0);
+    if (config.proceduralBackend == ProceduralBackend::gpu) {
+      ProceduralGpuGenerator{helloVulkanDevice}.generate(desc, *geometryPool, range);
+    } else {
+      generateProceduralCpu(desc, static_cast<Model::Vertex *>(geometryPool->vertexData(range)), jobSystem);
+    }
+    model = std::make_unique<Model>(*geometryPool, range);
+  }
+
+  void App::createInstanceBuffer() {
+    VkDeviceSize bufferSize = sizeof(glm::mat4) * config.objectTransforms.size();
+    // host writes need no ownership transfer, so the compute queue can read it as it is
+    helloVulkanDevice.createBuffer(
+        bufferSize,
+        config.computeAnimation ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        instanceBuffer,
+        instanceBufferMemory);
+
+    void *data;
+    vkMapMemory(helloVulkanDevice.device(), instanceBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, config.objectTransforms.data(), static_cast<size_t>(bufferSize));
+    vkUnmapMemory(helloVulkanDevice.device(), instanceBufferMemory);
   }
 
   void App::createPipelineLayout() {
@@ -114,20 +392,209 @@ namespace helloVulkan {
     };
   }
 
-  void App::createPipeline() {
-    auto pipelineConfigInfo = Pipeline::defaultPipelineConfig(helloVulkanSwapChain.width(), helloVulkanSwapChain.height());
-    pipelineConfigInfo.renderPass = helloVulkanSwapChain.getRenderPass();
+  struct AnimationPushConstantData {
+    float time;
+    uint32_t instanceCount;
+  };
+
+  void App::createComputeAnimation() {
+    constexpr uint32_t frameCount = HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT;
+    VkDevice device = helloVulkanDevice.device();
+    asyncCompute = std::make_unique<AsyncCompute>(helloVulkanDevice, frameCount);
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+      bindings[binding].binding = binding;
+      bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[binding].descriptorCount = 1;
+      bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &animationSetLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create animation descriptor set layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(AnimationPushConstantData);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &animationSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &animationPipelineLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create animation pipeline layout");
+    }
+    animationPipeline = std::make_unique<ComputePipeline>(
+        helloVulkanDevice, "shaders/instanceAnimation.comp.spv", animationPipelineLayout);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * frameCount;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &animationDescriptorPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create animation descriptor pool");
+    }
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount, animationSetLayout);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = animationDescriptorPool;
+    setInfo.descriptorSetCount = frameCount;
+    setInfo.pSetLayouts = setLayouts.data();
+    animationDescriptorSets.resize(frameCount);
+    if (vkAllocateDescriptorSets(device, &setInfo, animationDescriptorSets.data()) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate animation descriptor sets");
+    }
+
+    // one output per frame in flight, compute fills the next frame's while the last one draws
+    VkDeviceSize bufferSize = sizeof(glm::mat4) * config.objectTransforms.size();
+    animatedInstanceBuffers.resize(frameCount);
+    animatedInstanceMemory.resize(frameCount);
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+      helloVulkanDevice.createBuffer(
+          bufferSize,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+          animatedInstanceBuffers[frame],
+          animatedInstanceMemory[frame]);
+
+      std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+      bufferInfos[0] = {instanceBuffer, 0, VK_WHOLE_SIZE};
+      bufferInfos[1] = {animatedInstanceBuffers[frame], 0, VK_WHOLE_SIZE};
+      std::array<VkWriteDescriptorSet, 2> writes{};
+      for (uint32_t binding = 0; binding < writes.size(); binding++) {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = animationDescriptorSets[frame];
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[binding].pBufferInfo = &bufferInfos[binding];
+      }
+      vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+  }
+
+  void App::destroyComputeAnimation() {
+    if (!asyncCompute) {
+      return;
+    }
+    asyncCompute.reset();
+    animationPipeline.reset();
+    for (size_t frame = 0; frame < animatedInstanceBuffers.size(); frame++) {
+      vkDestroyBuffer(helloVulkanDevice.device(), animatedInstanceBuffers[frame], nullptr);
+      helloVulkanDevice.freeMemory(animatedInstanceMemory[frame]);
+    }
+    vkDestroyDescriptorPool(helloVulkanDevice.device(), animationDescriptorPool, nullptr);
+    vkDestroyPipelineLayout(helloVulkanDevice.device(), animationPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(helloVulkanDevice.device(), animationSetLayout, nullptr);
+  }
+
+  void App::recordComputeAnimation(uint32_t frame) {
+    PROFILE_FUNCTION();
+    VkCommandBuffer commandBuffer = asyncCompute->begin(frame);
+    animationPipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        animationPipelineLayout,
+        0,
+        1,
+        &animationDescriptorSets[frame],
+        0,
+        nullptr);
+
+    // a fixed step so runs are repeatable
+    AnimationPushConstantData pushConstant{};
+    pushConstant.time = static_cast<float>(animationFrame++) / 60.0f;
+    pushConstant.instanceCount = static_cast<uint32_t>(config.objectTransforms.size());
+    vkCmdPushConstants(
+        commandBuffer,
+        animationPipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(AnimationPushConstantData),
+        &pushConstant);
+    vkCmdDispatch(commandBuffer, ComputePipeline::groupCount(pushConstant.instanceCount, 64), 1, 1);
+
+    asyncCompute->releaseToGraphics(commandBuffer, animatedInstanceBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT);
+    asyncCompute->submit(frame);
+  }
+
+  void App::createPipelines() {
+    auto pipelineConfigInfo = Pipeline::defaultPipelineConfig();
+    pipelineConfigInfo.renderPass = helloVulkanSwapChain->getRenderPass();
+    pipelineConfigInfo.colorAttachmentFormat = helloVulkanSwapChain->getSwapChainImageFormat();
+    pipelineConfigInfo.depthAttachmentFormat = helloVulkanSwapChain->getDepthFormat();
+    if (particleSystem) {
+      // before the meshes' render state goes in, the particles have their own
+      particleSystem->createRenderPipeline(pipelineRegistry, pipelineConfigInfo);
+    }
+    Pipeline::applyRenderState(helloVulkanDevice, pipelineConfigInfo, config.renderState);
     pipelineConfigInfo.pipelineLayout = pipelineLayout;
-    pipeline = std::make_unique<Pipeline>(
-        helloVulkanDevice,
-        "shaders/simpleShader.vert.spv",
-        "shaders/simpleShader.frag.spv",
-        pipelineConfigInfo
-        );
+
+    std::string vertFilePath = "shaders/simpleShader.vert.spv";
+    if (config.instancing) {
+      // per-instance object transform in binding 1, a mat4 takes up four attribute locations
+      VkVertexInputBindingDescription instanceBinding{};
+      instanceBinding.binding = 1;
+      instanceBinding.stride = sizeof(glm::mat4);
+      instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+      pipelineConfigInfo.bindingDescriptions.push_back(instanceBinding);
+      for (uint32_t column = 0; column < 4; column++) {
+        VkVertexInputAttributeDescription attribute{};
+        attribute.binding = 1;
+        attribute.location = 2 + column;
+        attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attribute.offset = column * sizeof(glm::vec4);
+        pipelineConfigInfo.attributeDescriptions.push_back(attribute);
+      }
+      vertFilePath = "shaders/instancedShader.vert.spv";
+    }
+
+    // nothing waits for the device to go idle first, frames in flight may still use the old
+    // pipelines. Dropping them is safe because ~Pipeline goes through the deletion queue.
+    materialPipelines.clear();
+    materialPipelineIds.clear();
+    if (vertexPulling) {
+      // the one pipeline for every vertex format, with the first material's colour mode
+      pipelineConfigInfo.bindingDescriptions.clear();
+      pipelineConfigInfo.attributeDescriptions.clear();
+      pipelineConfigInfo.pipelineLayout = vertexPulling->pipelineLayout();
+      pipelineConfigInfo.fragmentSpecialization = ShaderSpecialization::from(
+          FragmentConstants{ static_cast<uint32_t>(config.colourMode) % COLOUR_MODE_COUNT });
+      pullingPipeline = pipelineRegistry.acquire(
+          "shaders/vertexPulling.vert.spv",
+          "shaders/simpleShader.frag.spv",
+          pipelineConfigInfo);
+      return;
+    }
+    uint32_t materialCount = config.instancing ? 1 : std::max(1u, config.materialCount);
+    for (uint32_t material = 0; material < materialCount; material++) {
+      uint32_t colourMode = (static_cast<uint32_t>(config.colourMode) + material) % COLOUR_MODE_COUNT;
+      pipelineConfigInfo.fragmentSpecialization = ShaderSpecialization::from(FragmentConstants{ colourMode });
+      materialPipelines.push_back(pipelineRegistry.acquire(
+          vertFilePath,
+          "shaders/simpleShader.frag.spv",
+          pipelineConfigInfo));
+
+      // materials that ended up sharing a pipeline get the same id so they sort next to each other
+      auto firstUse = std::find(materialPipelines.begin(), materialPipelines.end(), materialPipelines.back());
+      materialPipelineIds.push_back(static_cast<uint32_t>(
+          firstUse == materialPipelines.end() - 1 ? material : materialPipelineIds[firstUse - materialPipelines.begin()]));
+    }
   }
 
   void App::createCommandBuffers() {
-    commandBuffers.resize(helloVulkanSwapChain.imageCount());
+    commandBuffers.resize(helloVulkanSwapChain->imageCount());
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -138,11 +605,75 @@ namespace helloVulkan {
     if (vkAllocateCommandBuffers(helloVulkanDevice.device(), &allocInfo, commandBuffers.data()) !=VK_SUCCESS) {
       throw std::runtime_error("Failed to create command buffers");
     };
+
+    pipelineStatistics = std::make_unique<PipelineStatistics>(
+        helloVulkanDevice,
+        static_cast<uint32_t>(commandBuffers.size()));
+  }
+
+  void App::freeCommandBuffers() {
+    // the frames in flight may still be executing them
+    VkDevice device = helloVulkanDevice.device();
+    VkCommandPool commandPool = helloVulkanDevice.getCommandPool();
+    helloVulkanDevice.deferDestruction([device, commandPool, retired = std::move(commandBuffers)] {
+      vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(retired.size()), retired.data());
+    });
+    commandBuffers.clear();
+  }
+
+  void App::recreateSwapChain() {
+    PROFILE_FUNCTION();
+    auto extent = helloVulkanWindow.getExtent();
+    // minimised, there is nothing to present to until the window comes back. Off the main
+    // thread that has to wait for the main thread to see the events.
+    while (extent.width == 0 || extent.height == 0) {
+      if (jobSystem.isMainThread()) {
+        glfwWaitEvents();
+      } else if (helloVulkanWindow.shouldClose()) {
+        return;
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      extent = helloVulkanWindow.getExtent();
+    }
+
+    // no waiting for the device to go idle, the new swap chain carries on with the old one's frames
+    // in flight and what it replaces is freed through the deletion queue
+    auto recreationStart = std::chrono::steady_clock::now();
+    std::unique_ptr<HelloVulkanSwapChain> oldSwapChain = std::move(helloVulkanSwapChain);
+    helloVulkanSwapChain = std::make_unique<HelloVulkanSwapChain>(
+        helloVulkanDevice,
+        extent,
+        config.presentMode,
+        oldSwapChain.get(),
+        config.occlusionCulling);
+    bool formatsChanged = !oldSwapChain->compareSwapFormats(*helloVulkanSwapChain);
+    // its render pass handle is free to be reused once the deletion queue gets to it
+    pipelineRegistry.forgetRenderPass(oldSwapChain->getRenderPass());
+    oldSwapChain.reset();
+
+    // viewport and scissor are dynamic and a render pass with the same formats is compatible, so
+    // the pipeline only has to be rebuilt if the formats changed. Dynamic rendering pipelines only
+    // know the formats in the first place.
+    if (formatsChanged) {
+      createPipelines();
+    }
+    if (depthPyramid) {
+      depthPyramid->setDepthTargets(helloVulkanSwapChain->getSwapChainExtent(), helloVulkanSwapChain->getDepthImageViews());
+    }
+    if (helloVulkanSwapChain->imageCount() != commandBuffers.size()) {
+      freeCommandBuffers();
+      createCommandBuffers();
+    }
+
+    frameStats.swapChainRecreations++;
+    frameStats.lastSwapChainRecreationMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - recreationStart).count();
   }
 
   void App::recordCommandBuffer(int imageIndex) {
-      static int frame = 0;
-      frame = (frame + 1) % 100;
+      PROFILE_FUNCTION();
+      auto recordStart = std::chrono::steady_clock::now();
 
       VkCommandBufferBeginInfo beginInfo{};
       beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -151,66 +682,255 @@ namespace helloVulkan {
         throw std::runtime_error("Failed to begin command buffer");
       };
 
-      VkRenderPassBeginInfo renderPassInfo{};
-      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      renderPassInfo.renderPass = helloVulkanSwapChain.getRenderPass();
-      renderPassInfo.framebuffer = helloVulkanSwapChain.getFrameBuffer(imageIndex);
-
-      renderPassInfo.renderArea.offset = {0, 0};
-      renderPassInfo.renderArea.extent = helloVulkanSwapChain.getSwapChainExtent();
-
-      std::array<VkClearValue, 2> clearValues{};
-      clearValues[0].color = {0.5f, 0.5f, 0.5f};
-      clearValues[1].depthStencil = {1.0f, 0};
-      renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-      renderPassInfo.pClearValues = clearValues.data();
-
-      vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-      
-      pipeline->bind(commandBuffers[imageIndex]);
-      model->bind(commandBuffers[imageIndex]);
-      
-      for (int j = 0; j < 4; j++) {
-        float scalar = frame * 0.01f;
-        float xScale = 0.5f;
-        float yScale = 0.5f;
-        float zScale = 0.5f;
-
-        SimplePushConstantData pushConstant = { {
-          xScale, 0.0f, 0.0f, 0.0f,
-          0.0f, yScale, 0.0f, 0.0f,
-          0.0f, 0.0f, zScale, 0.0f,
-          0.0f, 0.0f, 0.5f, 1.0f
-        }, };
-        pushConstant.transform = pushConstant.transform * calculateRotationMatrix(axisx);
+      pipelineStatistics->reset(commandBuffers[imageIndex], imageIndex);
+      uint32_t frame = static_cast<uint32_t>(helloVulkanSwapChain->currentFrameIndex());
+      if (asyncCompute) {
+        asyncCompute->beginGraphicsTimestamps(commandBuffers[imageIndex], frame);
+        asyncCompute->acquireOnGraphics(
+            commandBuffers[imageIndex],
+            animatedInstanceBuffers[frame],
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+      }
+
+      // rebuilt every frame, it's only a handful of passes. The swap chain image is already
+      // synchronised with the acquire semaphore and the render pass handles its layouts.
+      RenderGraph &renderGraph = *renderGraphs[frame];
+      renderGraph.reset();
+      RenderGraphResource swapChainImage = renderGraph.importImage(
+          "swapChainImage",
+          helloVulkanSwapChain->getImage(imageIndex),
+          VK_IMAGE_ASPECT_COLOR_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED);
+      RenderGraphPass *particleUpdate = nullptr;
+      if (particleSystem) {
+        particleUpdate = &renderGraph.addPass("particleUpdate", [this](VkCommandBuffer commandBuffer) {
+          particleSystem->update(commandBuffer, false);
+        });
+      }
+      RenderGraphPass &scenePass = renderGraph.addPass("scene", [this, imageIndex, frame](VkCommandBuffer commandBuffer) {
+        recordScene(commandBuffer, imageIndex, frame);
+      });
+      scenePass
+          .attachment(swapChainImage, RenderGraphUsage::colorAttachment, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+          .sideEffects();
+      if (particleSystem) {
+        // the particle passes keep their own barriers between each other and against the last
+        // frame's draw, the graph orders them against this frame's
+        RenderGraphResource particles = renderGraph.importBuffer("particles", particleSystem->getParticleBuffer());
+        RenderGraphResource aliveLists = renderGraph.importBuffer("particleAliveLists", particleSystem->getAliveListBuffer());
+        RenderGraphResource deadList = renderGraph.importBuffer("particleDeadList", particleSystem->getDeadListBuffer());
+        RenderGraphResource state = renderGraph.importBuffer("particleState", particleSystem->getStateBuffer());
+        particleUpdate->write(particles, RenderGraphUsage::computeStorage)
+            .write(aliveLists, RenderGraphUsage::computeStorage)
+            .write(deadList, RenderGraphUsage::computeStorage)
+            .write(state, RenderGraphUsage::computeStorage)
+            .read(state, RenderGraphUsage::indirect);
+        scenePass
+            .read(particles, RenderGraphUsage::vertexStorage)
+            .read(aliveLists, RenderGraphUsage::vertexStorage)
+            .read(state, RenderGraphUsage::indirect);
+      }
+      if (depthPyramid) {
+        // the scene's depth is reduced and read back for the occlusion tests of the frames after it
+        RenderGraphResource depth = renderGraph.importImage(
+            "depth",
+            helloVulkanSwapChain->getDepthImage(frame),
+            helloVulkanSwapChain->depthAspectMask(),
+            VK_IMAGE_LAYOUT_UNDEFINED);
+        scenePass.attachment(depth, RenderGraphUsage::depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        renderGraph.addPass("depthPyramid", [this, frame](VkCommandBuffer commandBuffer) {
+          depthPyramid->record(commandBuffer, frame);
+        }).read(depth, RenderGraphUsage::computeSampled).sideEffects();
+      }
+      if (frameCapture) {
+        VkExtent2D extent = helloVulkanSwapChain->getSwapChainExtent();
+        if (extent.width == frameCapture->extent().width && extent.height == frameCapture->extent().height) {
+          // the copy goes between the scene and presenting, the graph moves the image between them
+          renderGraph.addPass("capture", [this, imageIndex](VkCommandBuffer commandBuffer) {
+            frameCapture->recordCopy(commandBuffer, helloVulkanSwapChain->getImage(imageIndex));
+          }).read(swapChainImage, RenderGraphUsage::transfer).sideEffects();
+          renderGraph.addPass("present", [](VkCommandBuffer) {})
+              .read(swapChainImage, RenderGraphUsage::present)
+              .sideEffects();
+        } else {
+          frameCapture->skipFrame();
+        }
+      }
+      renderGraph.compile();
+      renderGraph.execute(commandBuffers[imageIndex]);
+      frameStats.renderGraph = renderGraph.stats();
+
+      if (asyncCompute) {
+        asyncCompute->endGraphicsTimestamps(commandBuffers[imageIndex], frame);
+      }
+      if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to end command buffer");
+      }
+      frameStats.recordTimeMs = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - recordStart).count();
+  }
 
+  void App::recordScene(VkCommandBuffer commandBuffer, int imageIndex, uint32_t frame) {
+      helloVulkanSwapChain->beginRendering(commandBuffer, imageIndex, {{0.5f, 0.5f, 0.5f, 1.0f}});
+      pipelineStatistics->begin(commandBuffer, imageIndex);
+
+      // all the material pipelines share the same dynamic state, so it only needs setting once
+      (vertexPulling ? pullingPipeline : materialPipelines[0])->setDynamicState(
+          commandBuffer,
+          helloVulkanSwapChain->getSwapChainExtent(),
+          config.renderState);
+
+      glm::mat4 rotation = calculateRotationMatrix(axisx, frameState.rotation);
+
+      if (config.instancing) {
+        materialPipelines[0]->bind(commandBuffer);
+        model->bind(commandBuffer);
+
+        SimplePushConstantData pushConstant = { rotation };
         vkCmdPushConstants(
-            commandBuffers[imageIndex],
+            commandBuffer,
             pipelineLayout,
             VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
             0,
             sizeof(SimplePushConstantData),
             &pushConstant);
 
-        model->draw(commandBuffers[imageIndex]);
+        VkBuffer instanceBuffers[] = {asyncCompute ? animatedInstanceBuffers[frame] : instanceBuffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, offsets);
+        model->draw(commandBuffer, static_cast<uint32_t>(config.objectTransforms.size()));
+        frameStats.triangles = meshTriangles * config.objectTransforms.size();
+        frameStats.drawCount = 1;
+        frameStats.pipelineBinds = 1;
+        frameStats.vertexBufferBinds = 1;
+      } else if (vertexPulling) {
+        pullingPipeline->bind(commandBuffer);
+        vertexPulling->resize(config.objectTransforms.size());
+        jobSystem.parallelFor(
+            static_cast<uint32_t>(config.objectTransforms.size()),
+            1024,
+            [&](uint32_t begin, uint32_t end) {
+              for (uint32_t object = begin; object < end; object++) {
+                vertexPulling->set(
+                    object,
+                    pulledMeshes[object % pulledMeshes.size()],
+                    config.objectTransforms[object] * rotation);
+              }
+            });
+        VertexPullingStats pullingStats = vertexPulling->record(commandBuffer, frame);
+        frameStats.drawCount = pullingStats.draws;
+        frameStats.pulledDrawCalls = pullingStats.drawCalls;
+        frameStats.triangles = meshTriangles * pullingStats.draws;
+        frameStats.pipelineBinds = 1;
+        frameStats.vertexBufferBinds = 0;
+      } else {
+        drawList.clear();
+        drawList.resize(config.objectTransforms.size());
+        if (depthPyramid) {
+          objectOccluded.assign(config.objectTransforms.size(), 0);
+        }
+        // transforms, keys and occlusion tests are worked out in jobs, each range filling its own packets
+        jobSystem.parallelFor(
+            static_cast<uint32_t>(config.objectTransforms.size()),
+            1024,
+            [&](uint32_t begin, uint32_t end) {
+              for (uint32_t object = begin; object < end; object++) {
+                uint32_t material = static_cast<uint32_t>(object % materialPipelines.size());
+                const glm::mat4 &objectTransform = config.objectTransforms[object];
+                glm::mat4 transform = objectTransform * rotation;
+                if (depthPyramid && depthPyramid->isOccluded(transform, meshBoundsMin, meshBoundsMax)) {
+                  objectOccluded[object] = 1;
+                  continue;
+                }
+                drawList.packet(object) = {
+                    SortKey::make(0, materialPipelineIds[material], material, 0, objectTransform[3].z),
+                    materialPipelines[material].get(),
+                    model.get(),
+                    transform };
+              }
+            });
+        uint32_t occludedDraws = 0;
+        if (depthPyramid) {
+          // the hidden objects' packets were never filled in, the rest close up over them
+          size_t kept = 0;
+          for (size_t object = 0; object < objectOccluded.size(); object++) {
+            if (!objectOccluded[object]) {
+              drawList.packet(kept++) = drawList.packet(object);
+            }
+          }
+          occludedDraws = static_cast<uint32_t>(objectOccluded.size() - kept);
+          drawList.resize(kept);
+          uint64_t testedFrame = depthPyramid->stats().testedFrame;
+          frameStats.occlusionLatencyFrames = testedFrame == 0 ? 0 : helloVulkanDevice.currentFrame() - testedFrame;
+        }
+        drawList.sort();
+        DrawListStats drawListStats = drawList.record(
+            commandBuffer,
+            pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        frameStats.drawCount = drawListStats.draws;
+        frameStats.triangles = meshTriangles * drawListStats.draws;
+        frameStats.occludedDraws = occludedDraws;
+        frameStats.occludedTriangles = meshTriangles * occludedDraws;
+        frameStats.pipelineBinds = drawListStats.pipelineBinds;
+        frameStats.vertexBufferBinds = drawListStats.vertexBufferBinds;
       }
 
-      vkCmdEndRenderPass(commandBuffers[imageIndex]);
-      if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
-        std::runtime_error("Failed to end command buffer");
+      if (particleSystem) {
+        particleSystem->draw(commandBuffer, helloVulkanSwapChain->getSwapChainExtent());
       }
+
+      pipelineStatistics->end(commandBuffer, imageIndex);
+      helloVulkanSwapChain->endRendering(commandBuffer, imageIndex);
   }
 
+
   void App::drawFrame() {
+    PROFILE_FUNCTION();
     uint32_t imageIndex;
-    auto result = helloVulkanSwapChain.acquireNextImage(&imageIndex);
+    auto result = helloVulkanSwapChain->acquireNextImage(&imageIndex);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      recreateSwapChain();
+      return;
+    }
     if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
       throw std::runtime_error("Failed to acquire swap chain image");
     }
 
+    // as late as possible, once the wait for a frame in flight is over
+    if (!simulation.running()) {
+      simulation.advance();
+    }
+    frameState = simulation.sample();
+    if (frameCapture) {
+      frameCapture->collect();
+    }
+    if (depthPyramid) {
+      depthPyramid->collect();
+    }
+
+    // submitted ahead of the graphics work so it can run while the previous frame still draws
+    VkSemaphore computeFinished = VK_NULL_HANDLE;
+    if (asyncCompute) {
+      uint32_t frame = static_cast<uint32_t>(helloVulkanSwapChain->currentFrameIndex());
+      recordComputeAnimation(frame);
+      computeFinished = asyncCompute->computeFinished(frame);
+    }
     recordCommandBuffer(imageIndex);
-    
-    result = helloVulkanSwapChain.submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);
+
+    result = helloVulkanSwapChain->submitCommandBuffers(
+        &commandBuffers[imageIndex],
+        &imageIndex,
+        computeFinished,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+        helloVulkanWindow.wasWindowResized() || swapChainRecreationRequested) {
+      helloVulkanWindow.resetWindowResizedFlag();
+      swapChainRecreationRequested = false;
+      recreateSwapChain();
+      return;
+    }
     if (result != VK_SUCCESS) {
       throw std::runtime_error("Failed to present swap chain image");
     }
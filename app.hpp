@@ -1,48 +1,241 @@
 #pragma once
 
+#include "asyncCompute.hpp"
+#include "computePipeline.hpp"
+#include "depthPyramid.hpp"
+#include "drawList.hpp"
+#include "frameCapture.hpp"
+#include "geometryPool.hpp"
 #include "helloVulkanWindow.hpp"
 #include "helloVulkanPipeline.hpp"
 #include "helloVulkanDevice.hpp"
 #include "helloVulkanSwapChain.hpp"
+#include "jobSystem.hpp"
 #include "model.hpp"
+#include "particleSystem.hpp"
+#include "pipelineRegistry.hpp"
+#include "pipelineStatistics.hpp"
+#include "proceduralGeometry.hpp"
+#include "renderGraph.hpp"
+#include "shaderLibrary.hpp"
+#include "simulation.hpp"
+#include "vertexPulling.hpp"
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace helloVulkan {
 
+  // selects the fragment shader variant, see simpleShader.frag
+  enum class ColourMode : uint32_t {
+    vertexColour = 0,
+    flatWhite = 1,
+    depth = 2
+  };
+
+  // where a procedural mesh is generated, the vertices end up in the geometry pool either way
+  enum class ProceduralBackend {
+    // generateProceduralCpu into the pool's mapped memory
+    cpu,
+    // ProceduralGpuGenerator, a compute pass writing the pool's vertex buffer
+    gpu
+  };
+
+  struct AppConfig {
+    std::vector<Model::Vertex> meshVertices;
+    // empty to draw meshVertices as a plain triangle list
+    std::vector<uint32_t> meshIndices;
+    // replaces meshVertices and meshIndices with a generated mesh
+    std::optional<ProceduralDesc> procedural;
+    ProceduralBackend proceduralBackend = ProceduralBackend::cpu;
+    // a GPU simulated particle system drawn over the meshes
+    std::optional<ParticleSystemConfig> particles;
+    // one object is drawn per transform, either as separate draws or as instances of one draw
+    std::vector<glm::mat4> objectTransforms;
+    bool instancing = false;
+    // instanced only: a compute pass on the async compute queue spins the instances every frame
+    bool computeAnimation = false;
+    ColourMode colourMode = ColourMode::vertexColour;
+    // materials cycle through the colour modes starting at colourMode, object i uses material
+    // i % materialCount. Instanced draws all use the first material.
+    uint32_t materialCount = 1;
+    bool visible = true;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    DynamicRenderState renderState;
+    // physical device index, UUID or part of its name, empty for the highest scoring one
+    std::string devicePreference;
+    // job system threads including the main thread, 0 for one per hardware thread
+    uint32_t jobThreads = 0;
+    SimulationConfig simulation;
+    // finished frames are read back and written out, see FrameCapture. The capture keeps the size
+    // the window started with, frames after a resize to another size are dropped.
+    std::optional<FrameCaptureConfig> capture;
+    // Separate draws only: objects the depth of a frame or two ago had hidden behind others aren't
+    // drawn, see DepthPyramid. The depth attachments are kept in memory for it rather than being
+    // transient. HELLO_VULKAN_DISABLE_OCCLUSION_CULLING=1 turns it off.
+    bool occlusionCulling = false;
+    // Separate draws only: the mesh is read from a storage buffer by the vertex shader instead of
+    // through fixed-function vertex input, see VertexPulling. It is stored once in each of
+    // vertexFormats and object i uses vertexFormats[i % size], all with one pipeline and, where
+    // the device has multiDrawIndirect, one draw call. Every object gets the first material.
+    bool vertexPulling = false;
+    std::vector<VertexFormat> vertexFormats{VertexFormat::full};
+    // Frames are recorded and submitted on a thread of their own while the main thread handles
+    // window events and the simulation ticks on another. Otherwise all three take turns on the
+    // main thread. HELLO_VULKAN_DISABLE_RENDER_THREAD=1 turns it off.
+    bool renderThread = true;
+  };
+
+  struct FrameStats {
+    double cpuFrameTimeMs = 0.0;
+    double recordTimeMs = 0.0;
+    uint32_t drawCount = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint64_t deviceMemoryAllocationCount = 0;
+    VkDeviceSize deviceMemoryBytes = 0;
+    // lags a few frames behind, false when the device can't do pipeline statistics queries
+    bool pipelineStatisticsAvailable = false;
+    PipelineStatisticsResult pipelineStatistics;
+    // running totals since startup
+    uint64_t pipelinesCreated = 0;
+    uint32_t swapChainRecreations = 0;
+    double lastSwapChainRecreationMs = 0.0;
+    // rendering without a render pass, recreation never rebuilds pipelines or framebuffers then
+    bool dynamicRendering = false;
+    // computeAnimation only, whether compute got its own queue and how it lined up with graphics
+    bool asyncComputeQueue = false;
+    AsyncComputeTimings asyncCompute;
+    PipelineRegistryStats pipelineRegistry;
+    RenderGraphStats renderGraph;
+    // from the start of App construction to the first frame being ready to record
+    double startupMs = 0.0;
+    // time this App spent getting SPIR-V from the ShaderLibrary
+    double shaderLoadMs = 0.0;
+    bool renderThread = false;
+    // the simulation tick the frame was interpolated towards, and how many have run in total
+    uint64_t simulationTick = 0;
+    uint64_t simulationTicks = 0;
+    // running totals, capture only
+    FrameCaptureStats capture;
+    // in the meshes drawn this frame, particles aside
+    uint64_t triangles = 0;
+    // occlusionCulling only: the draws left out and the triangles they'd have drawn, and how many
+    // frames behind this one the depth they were tested against is, 0 before there is any
+    uint32_t occludedDraws = 0;
+    uint64_t occludedTriangles = 0;
+    uint64_t occlusionLatencyFrames = 0;
+    // vertexPulling only: the vkCmdDraw* calls drawCount draws went out in, 1 with multi-draw
+    uint32_t pulledDrawCalls = 0;
+  };
+
   class App {
     public:
       static const int WIDTH = 1000;
       static const int HEIGHT = 750;
 
       App();
+      App(AppConfig config);
       ~App();
 
       App(const App &) = delete;
       App &operator=(const App &) = delete;
 
+      static AppConfig defaultConfig();
+      // one Sierpinski triangle of the given depth filling most of the window
+      static AppConfig sierpinskiTriangle(uint32_t depth);
+
       void run();
+      // Renders a fixed number of frames, reporting each one as it completes. With a render
+      // thread onFrame is called on it, and it is also where the two below have to be called from.
+      void runFrames(uint32_t frameCount, const std::function<void(const FrameStats &)> &onFrame);
+      // only rebuilds the pipeline when the device can't set this state dynamically
+      void setRenderState(const DynamicRenderState &renderState);
+      // recreates the swap chain after the current frame, as if the window had been resized
+      void requestSwapChainRecreation() { swapChainRecreationRequested = true; }
 
     private:
-      void sierpinskiTriangle();
+      // frameCount frames or until the window closes, onFrame may be empty
+      void renderLoop(uint32_t frameCount, const std::function<void(const FrameStats &)> &onFrame);
+      // runs frames on a render thread with the simulation on another, handling window events on
+      // this one until frames returns
+      void runOnRenderThread(const std::function<void()> &frames);
       void loadModels();
-      void createPipeline();
+      void loadProceduralModel();
+      void createInstanceBuffer();
+      void createComputeAnimation();
+      void destroyComputeAnimation();
+      void recordComputeAnimation(uint32_t frame);
+      void createPipelines();
       void createPipelineLayout();
       void createCommandBuffers();
+      void freeCommandBuffers();
+      void recreateSwapChain();
       void drawFrame();
       void recordCommandBuffer(int imageIndex);
+      // the scene pass of the render graph: the meshes and particles drawn to the swap chain image
+      void recordScene(VkCommandBuffer commandBuffer, int imageIndex, uint32_t frame);
 
+      // declared first so it is initialised before the window and device
+      std::chrono::steady_clock::time_point constructionStart = std::chrono::steady_clock::now();
+      AppConfig config;
+      JobSystem jobSystem{config.jobThreads};
       HelloVulkanWindow helloVulkanWindow{
             WIDTH,
             HEIGHT,
-            "elwynn" };
-      HelloVulkanDevice helloVulkanDevice{helloVulkanWindow};
-      HelloVulkanSwapChain helloVulkanSwapChain{ helloVulkanDevice, helloVulkanWindow.getExtent() };
-      std::unique_ptr<Pipeline> pipeline;
+            "elwynn",
+            config.visible };
+      HelloVulkanDevice helloVulkanDevice{helloVulkanWindow, config.devicePreference};
+      std::unique_ptr<HelloVulkanSwapChain> helloVulkanSwapChain;
+      PipelineRegistry pipelineRegistry{helloVulkanDevice};
+      std::vector<std::shared_ptr<Pipeline>> materialPipelines;
+      // dense id of each material's pipeline, for the draw sort keys
+      std::vector<uint32_t> materialPipelineIds;
+      DrawList drawList;
+      // one per frame in flight, so transient images are never rebuilt under a frame still running
+      std::vector<std::unique_ptr<RenderGraph>> renderGraphs;
       VkPipelineLayout pipelineLayout;
       std::vector<VkCommandBuffer> commandBuffers;
+      std::unique_ptr<PipelineStatistics> pipelineStatistics;
+      std::unique_ptr<GeometryPool> geometryPool;
       std::unique_ptr<Model> model;
+      // the mesh's object space bounding box, for occlusion tests
+      glm::vec3 meshBoundsMin{0.0f};
+      glm::vec3 meshBoundsMax{0.0f};
+      uint64_t meshTriangles = 0;
+      // vertexPulling: the mesh in each of config.vertexFormats, and the pipeline decoding them all
+      std::unique_ptr<VertexPulling> vertexPulling;
+      std::vector<uint32_t> pulledMeshes;
+      std::shared_ptr<Pipeline> pullingPipeline;
+      VkBuffer instanceBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory instanceBufferMemory = VK_NULL_HANDLE;
+      // computeAnimation: instanceBuffer holds the base transforms, the animated ones are written
+      // into a buffer per frame in flight
+      std::unique_ptr<AsyncCompute> asyncCompute;
+      std::unique_ptr<ComputePipeline> animationPipeline;
+      VkDescriptorSetLayout animationSetLayout = VK_NULL_HANDLE;
+      VkPipelineLayout animationPipelineLayout = VK_NULL_HANDLE;
+      VkDescriptorPool animationDescriptorPool = VK_NULL_HANDLE;
+      std::vector<VkDescriptorSet> animationDescriptorSets;
+      std::vector<VkBuffer> animatedInstanceBuffers;
+      std::vector<VkDeviceMemory> animatedInstanceMemory;
+      uint64_t animationFrame = 0;
+      std::unique_ptr<ParticleSystem> particleSystem;
+      std::unique_ptr<FrameCapture> frameCapture;
+      std::unique_ptr<DepthPyramid> depthPyramid;
+      // per object, set by the jobs filling the draw list
+      std::vector<uint8_t> objectOccluded;
+      Simulation simulation{config.simulation};
+      // sampled once per frame before recording
+      SimulationState frameState;
+      FrameStats frameStats;
+      double shaderLoadMsAtConstruction = ShaderLibrary::loadTimeMs();
+      bool swapChainRecreationRequested = false;
   };
 }
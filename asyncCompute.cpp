@@ -0,0 +1,224 @@
+#include "asyncCompute.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  AsyncCompute::AsyncCompute(HelloVulkanDevice &device, uint32_t frameCount) : device{device}, frames(frameCount) {
+    QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
+    graphicsFamily = indices.graphicsFamily;
+    computeFamily = indices.computeFamily;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = device.getComputeCommandPool();
+    allocInfo.commandBufferCount = 1;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (FrameResources &frame : frames) {
+      if (vkAllocateCommandBuffers(device.device(), &allocInfo, &frame.commandBuffer) != VK_SUCCESS ||
+          vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &frame.finished) != VK_SUCCESS ||
+          vkCreateFence(device.device(), &fenceInfo, nullptr, &frame.fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create async compute frame resources");
+      }
+    }
+
+    // comparing the two queues' timestamps assumes they share a time base, which desktop drivers do
+    uint32_t validBits = std::min(device.timestampValidBits(graphicsFamily), device.timestampValidBits(computeFamily));
+    if (validBits == 0) {
+      return;
+    }
+    timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t{1} << validBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * frameCount;
+    if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &computeQueries) != VK_SUCCESS ||
+        vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &graphicsQueries) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create async compute timestamp query pools");
+    }
+  }
+
+  AsyncCompute::~AsyncCompute() {
+    for (FrameResources &frame : frames) {
+      vkWaitForFences(device.device(), 1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+      vkDestroyFence(device.device(), frame.fence, nullptr);
+      vkDestroySemaphore(device.device(), frame.finished, nullptr);
+      vkFreeCommandBuffers(device.device(), device.getComputeCommandPool(), 1, &frame.commandBuffer);
+    }
+    vkDestroyQueryPool(device.device(), computeQueries, nullptr);
+    vkDestroyQueryPool(device.device(), graphicsQueries, nullptr);
+  }
+
+  VkCommandBuffer AsyncCompute::begin(uint32_t frame) {
+    PROFILE_FUNCTION();
+    FrameResources &resources = frames[frame];
+    vkWaitForFences(device.device(), 1, &resources.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+    Interval compute{};
+    if (resources.computeFrame != 0 && readInterval(computeQueries, frame, resources.computeFrame, compute)) {
+      timings_.computeMs = toMs(compute.end - compute.start);
+      // the previous frame's graphics timestamps were collected when its slot came round again,
+      // so they are already in lastGraphics
+      if (lastGraphics.frame != 0 && lastGraphics.frame + 1 == compute.frame) {
+        uint64_t overlapStart = std::max(compute.start, lastGraphics.start);
+        uint64_t overlapEnd = std::min(compute.end, lastGraphics.end);
+        timings_.overlapMs = overlapEnd > overlapStart ? toMs(overlapEnd - overlapStart) : 0.0;
+        timings_.available = true;
+      }
+    }
+
+    vkResetCommandBuffer(resources.commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(resources.commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to begin compute command buffer");
+    }
+
+    resources.computeFrame = ++computeFrames;
+    if (computeQueries != VK_NULL_HANDLE) {
+      vkCmdResetQueryPool(resources.commandBuffer, computeQueries, 2 * frame, 2);
+      vkCmdWriteTimestamp(resources.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, computeQueries, 2 * frame);
+    }
+    return resources.commandBuffer;
+  }
+
+  void AsyncCompute::submit(uint32_t frame) {
+    PROFILE_FUNCTION();
+    FrameResources &resources = frames[frame];
+    if (computeQueries != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(resources.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, computeQueries, 2 * frame + 1);
+    }
+    if (vkEndCommandBuffer(resources.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to end compute command buffer");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &resources.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &resources.finished;
+    vkResetFences(device.device(), 1, &resources.fence);
+    if (vkQueueSubmit(device.computeQueue(), 1, &submitInfo, resources.fence) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to submit compute command buffer");
+    }
+  }
+
+  void AsyncCompute::releaseToGraphics(VkCommandBuffer computeCommandBuffer, VkBuffer buffer, VkAccessFlags srcAccess) {
+    // within one family the semaphore alone makes the writes visible
+    if (!transfersOwnership()) {
+      return;
+    }
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = computeFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        computeCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &barrier,
+        0,
+        nullptr);
+  }
+
+  void AsyncCompute::acquireOnGraphics(
+        VkCommandBuffer graphicsCommandBuffer,
+        VkBuffer buffer,
+        VkPipelineStageFlags dstStage,
+        VkAccessFlags dstAccess) {
+    if (!transfersOwnership()) {
+      return;
+    }
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = computeFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        graphicsCommandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        1,
+        &barrier,
+        0,
+        nullptr);
+  }
+
+  void AsyncCompute::beginGraphicsTimestamps(VkCommandBuffer graphicsCommandBuffer, uint32_t frame) {
+    if (graphicsQueries == VK_NULL_HANDLE) {
+      return;
+    }
+    // the slot's last frame finished before its in flight fence let this one start recording
+    FrameResources &resources = frames[frame];
+    Interval graphics{};
+    if (resources.graphicsFrame != 0 && readInterval(graphicsQueries, frame, resources.graphicsFrame, graphics)) {
+      lastGraphics = graphics;
+      timings_.graphicsMs = toMs(graphics.end - graphics.start);
+    }
+    resources.graphicsFrame = ++graphicsFrames;
+    vkCmdResetQueryPool(graphicsCommandBuffer, graphicsQueries, 2 * frame, 2);
+    vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graphicsQueries, 2 * frame);
+  }
+
+  void AsyncCompute::endGraphicsTimestamps(VkCommandBuffer graphicsCommandBuffer, uint32_t frame) {
+    if (graphicsQueries == VK_NULL_HANDLE) {
+      return;
+    }
+    vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graphicsQueries, 2 * frame + 1);
+  }
+
+  bool AsyncCompute::readInterval(VkQueryPool queryPool, uint32_t frame, uint64_t frameNumber, Interval &interval) {
+    // each timestamp followed by its availability word
+    std::array<uint64_t, 4> values{};
+    VkResult result = vkGetQueryPoolResults(
+        device.device(),
+        queryPool,
+        2 * frame,
+        2,
+        sizeof(values),
+        values.data(),
+        2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((result != VK_SUCCESS && result != VK_NOT_READY) || values[1] == 0 || values[3] == 0) {
+      return false;
+    }
+    interval.frame = frameNumber;
+    interval.start = values[0] & timestampMask;
+    interval.end = values[2] & timestampMask;
+    return interval.end >= interval.start;
+  }
+
+  double AsyncCompute::toMs(uint64_t ticks) const {
+    return ticks * static_cast<double>(device.properties.limits.timestampPeriod) / 1e6;
+  }
+}
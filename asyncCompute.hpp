@@ -0,0 +1,97 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  struct AsyncComputeTimings {
+    // false until both queues have reported a frame, or when they can't write timestamps
+    bool available = false;
+    double computeMs = 0.0;
+    double graphicsMs = 0.0;
+    // how long a frame's compute work ran alongside the previous frame's graphics work
+    double overlapMs = 0.0;
+  };
+
+  // Records compute work for the device's compute queue, one command buffer per frame in flight,
+  // and hands the results to the graphics queue through a semaphore. Buffers stay exclusively owned,
+  // so when the queues are in different families the hand over is a queue family ownership transfer.
+  // There is no transfer back: the compute pass overwrites everything graphics read, and without one
+  // only the old contents are lost.
+  //
+  // Each frame, after acquireNextImage so graphics is done with the frame slot's buffers:
+  //   begin(frame), record the dispatches, releaseToGraphics() each output buffer, submit(frame),
+  //   then acquireOnGraphics() each output in the graphics command buffer and have its submit wait
+  //   on computeFinished(frame).
+  // Output buffers need one copy per frame slot so compute can run while the previous frame is
+  // still drawing from its copy.
+  class AsyncCompute {
+    public:
+      AsyncCompute(HelloVulkanDevice &device, uint32_t frameCount);
+      ~AsyncCompute();
+
+      AsyncCompute(const AsyncCompute &) = delete;
+      AsyncCompute &operator=(const AsyncCompute &) = delete;
+
+      // false when compute has to share the graphics queue, the work is then serialised
+      bool separateQueue() { return device.hasAsyncCompute(); }
+
+      // waits for the slot's previous submission, then resets and begins its command buffer
+      VkCommandBuffer begin(uint32_t frame);
+      void submit(uint32_t frame);
+      VkSemaphore computeFinished(uint32_t frame) const { return frames[frame].finished; }
+
+      // release half of the ownership transfer, recorded after the writes in the compute command buffer
+      void releaseToGraphics(VkCommandBuffer computeCommandBuffer, VkBuffer buffer, VkAccessFlags srcAccess);
+      // acquire half, recorded in the graphics command buffer before the buffer is used
+      void acquireOnGraphics(
+          VkCommandBuffer graphicsCommandBuffer,
+          VkBuffer buffer,
+          VkPipelineStageFlags dstStage,
+          VkAccessFlags dstAccess);
+
+      // bracket the frame's graphics work, outside a render pass, so it can be compared against compute
+      void beginGraphicsTimestamps(VkCommandBuffer graphicsCommandBuffer, uint32_t frame);
+      void endGraphicsTimestamps(VkCommandBuffer graphicsCommandBuffer, uint32_t frame);
+      // lags a frame in flight behind
+      const AsyncComputeTimings &timings() const { return timings_; }
+
+    private:
+      struct Interval {
+        uint64_t frame = 0;
+        uint64_t start = 0;
+        uint64_t end = 0;
+      };
+
+      struct FrameResources {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore finished = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // frame number the timestamps in the slot belong to, 0 when nothing was recorded yet
+        uint64_t computeFrame = 0;
+        uint64_t graphicsFrame = 0;
+      };
+
+      bool transfersOwnership() const { return computeFamily != graphicsFamily; }
+      // false while the slot's queries aren't available yet
+      bool readInterval(VkQueryPool queryPool, uint32_t frame, uint64_t frameNumber, Interval &interval);
+      double toMs(uint64_t ticks) const;
+
+      HelloVulkanDevice &device;
+      uint32_t graphicsFamily;
+      uint32_t computeFamily;
+      std::vector<FrameResources> frames;
+      // two timestamps per frame slot, on each queue
+      VkQueryPool computeQueries = VK_NULL_HANDLE;
+      VkQueryPool graphicsQueries = VK_NULL_HANDLE;
+      uint64_t timestampMask = 0;
+      uint64_t computeFrames = 0;
+      uint64_t graphicsFrames = 0;
+      Interval lastGraphics;
+      AsyncComputeTimings timings_;
+  };
+}
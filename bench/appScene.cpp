@@ -0,0 +1,141 @@
+#include "benchScenes.hpp"
+#include "../particleSystem.hpp"
+
+#include <vector>
+
+namespace helloVulkan {
+
+  constexpr uint32_t SWAP_CHAIN_RECREATION_INTERVAL = 30;
+
+  const std::vector<BenchScene> BENCH_SCENES = {
+    {"default", 0, 0, false},
+    {"objects-1k", 1024, 2, false},
+    {"objects-1k-instanced", 1024, 2, true},
+    {"objects-16k", 16384, 2, false},
+    {"objects-16k-instanced", 16384, 2, true},
+    {"mesh-256k", 4, 262144, false},
+    {"mesh-256k-instanced", 4, 262144, true},
+    {"state-churn", 1024, 2, false, true},
+    {"materials-512", 1024, 2, false, false, 512},
+    {"draws-100k", 102400, 2, false, false, 64},
+    {"objects-16k-compute", 16384, 2, true, false, 1, true},
+    {"particles-1m", 0, 0, false, false, 1, false, 1 << 20},
+  };
+
+  SceneResult runScene(const BenchScene &scene, uint32_t warmupFrames, uint32_t frames) {
+    AppConfig config = benchAppConfig(scene.objectCount, scene.trianglesPerMesh);
+    config.instancing = scene.instancing;
+    config.materialCount = scene.materialCount;
+    config.computeAnimation = scene.computeAnimation;
+    if (scene.particles > 0) {
+      ParticleSystemConfig particles{};
+      particles.maxParticles = scene.particles;
+      particles.emitRate = scene.particles / particles.lifetime;
+      config.particles = particles;
+    }
+
+    App app{config};
+    uint64_t drawCount = 0;
+    uint64_t pipelineBinds = 0;
+    uint64_t vertexBufferBinds = 0;
+    double recordTime = 0.0;
+    FrameStats lastFrame{};
+    PipelineStatisticsResult statisticsTotal{};
+    uint32_t statisticsFrames = 0;
+    AsyncComputeTimings computeTotal{};
+    uint32_t computeFrames = 0;
+    FrameStats firstFrame{};
+    std::vector<double> swapChainRecreationTimes;
+    uint64_t allocationsBefore = hostAllocationCount();
+    std::vector<double> frameTimes = runAppFrames(app, warmupFrames, frames, [&](uint32_t frame, const FrameStats &stats) {
+      if (frame == 0) firstFrame = stats;
+      if (frame > 0 && stats.swapChainRecreations != lastFrame.swapChainRecreations) {
+        swapChainRecreationTimes.push_back(stats.lastSwapChainRecreationMs);
+      }
+      if (scene.stateChurn) {
+        DynamicRenderState renderState = config.renderState;
+        renderState.cullMode = frame % 2 == 0 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+        app.setRenderState(renderState);
+        if ((frame + 1) % SWAP_CHAIN_RECREATION_INTERVAL == 0) {
+          app.requestSwapChainRecreation();
+        }
+      }
+      drawCount += stats.drawCount;
+      pipelineBinds += stats.pipelineBinds;
+      vertexBufferBinds += stats.vertexBufferBinds;
+      recordTime += stats.recordTimeMs;
+      lastFrame = stats;
+      if (stats.asyncCompute.available) {
+        computeTotal.computeMs += stats.asyncCompute.computeMs;
+        computeTotal.graphicsMs += stats.asyncCompute.graphicsMs;
+        computeTotal.overlapMs += stats.asyncCompute.overlapMs;
+        computeFrames++;
+      }
+      if (stats.pipelineStatisticsAvailable) {
+        statisticsTotal.inputAssemblyVertices += stats.pipelineStatistics.inputAssemblyVertices;
+        statisticsTotal.inputAssemblyPrimitives += stats.pipelineStatistics.inputAssemblyPrimitives;
+        statisticsTotal.vertexShaderInvocations += stats.pipelineStatistics.vertexShaderInvocations;
+        statisticsTotal.clippingInvocations += stats.pipelineStatistics.clippingInvocations;
+        statisticsTotal.clippingPrimitives += stats.pipelineStatistics.clippingPrimitives;
+        statisticsTotal.fragmentShaderInvocations += stats.pipelineStatistics.fragmentShaderInvocations;
+        statisticsFrames++;
+      }
+    });
+    uint64_t hostAllocations = hostAllocationCount() - allocationsBefore;
+
+    SceneResult result{};
+    result.name = scene.name;
+    result.objectCount = static_cast<uint32_t>(config.objectTransforms.size());
+    size_t meshElements = config.meshIndices.empty() ? config.meshVertices.size() : config.meshIndices.size();
+    result.trianglesPerMesh = static_cast<uint32_t>(meshElements / 3);
+    result.instancing = scene.instancing;
+    result.frames = frames;
+    result.addMetric("cpuFrameTimeMeanMs", mean(frameTimes));
+    result.addMetric("cpuFrameTimeP50Ms", percentile(frameTimes, 0.50));
+    result.addMetric("cpuFrameTimeP90Ms", percentile(frameTimes, 0.90));
+    result.addMetric("cpuFrameTimeP99Ms", percentile(frameTimes, 0.99));
+    result.addMetric("cpuFrameTimeMaxMs", percentile(frameTimes, 1.0));
+    result.addMetric("drawsPerFrame", static_cast<double>(drawCount) / frames);
+    result.addMetric("pipelineBindsPerFrame", static_cast<double>(pipelineBinds) / frames);
+    result.addMetric("vertexBufferBindsPerFrame", static_cast<double>(vertexBufferBinds) / frames);
+    result.addMetric("recordTimeMeanMs", recordTime / frames);
+    result.addMetric("hostAllocationsPerFrame", static_cast<double>(hostAllocations) / frames);
+    result.addMetric("deviceMemoryAllocations", static_cast<double>(lastFrame.deviceMemoryAllocationCount));
+    result.addMetric("deviceMemoryBytes", static_cast<double>(lastFrame.deviceMemoryBytes));
+    result.addMetric("residentSetBytes", static_cast<double>(residentSetBytes()));
+    // counted from the end of the first measured frame, the rebuilds setRenderState caused
+    result.addMetric("pipelinesCreated", static_cast<double>(lastFrame.pipelinesCreated - firstFrame.pipelinesCreated));
+    // since startup, the materials are all set up before the first frame
+    result.addMetric("startupMs", lastFrame.startupMs);
+    result.addMetric("shaderLoadMs", lastFrame.shaderLoadMs);
+    result.addMetric("pipelineRequests", static_cast<double>(lastFrame.pipelineRegistry.requests));
+    result.addMetric("pipelineObjectsCreated", static_cast<double>(lastFrame.pipelineRegistry.pipelinesCreated));
+    result.addMetric("pipelineCreationMs", lastFrame.pipelineRegistry.creationMs);
+    result.addMetric("pipelineCreationMsSaved", lastFrame.pipelineRegistry.estimatedMsSaved);
+    result.addMetric("renderGraphBarrierCalls", lastFrame.renderGraph.barrierCalls);
+    result.addMetric("dynamicRendering", lastFrame.dynamicRendering ? 1.0 : 0.0);
+    if (!swapChainRecreationTimes.empty()) {
+      result.addMetric("swapChainRecreationMeanMs", mean(swapChainRecreationTimes));
+      result.addMetric("swapChainRecreationMaxMs", percentile(swapChainRecreationTimes, 1.0));
+    }
+    if (scene.computeAnimation) {
+      result.addMetric("asyncComputeQueue", lastFrame.asyncComputeQueue ? 1.0 : 0.0);
+    }
+    if (computeFrames > 0) {
+      result.addMetric("computeGpuMeanMs", computeTotal.computeMs / computeFrames);
+      result.addMetric("graphicsGpuMeanMs", computeTotal.graphicsMs / computeFrames);
+      // compute time spent alongside the previous frame's graphics, 0 means fully serialised
+      result.addMetric("computeOverlapMeanMs", computeTotal.overlapMs / computeFrames);
+    }
+    if (statisticsFrames > 0) {
+      double frameCount = statisticsFrames;
+      result.addMetric("inputAssemblyVerticesPerFrame", statisticsTotal.inputAssemblyVertices / frameCount);
+      result.addMetric("inputAssemblyPrimitivesPerFrame", statisticsTotal.inputAssemblyPrimitives / frameCount);
+      result.addMetric("vertexShaderInvocationsPerFrame", statisticsTotal.vertexShaderInvocations / frameCount);
+      result.addMetric("clippingInvocationsPerFrame", statisticsTotal.clippingInvocations / frameCount);
+      result.addMetric("clippingPrimitivesPerFrame", statisticsTotal.clippingPrimitives / frameCount);
+      result.addMetric("fragmentShaderInvocationsPerFrame", statisticsTotal.fragmentShaderInvocations / frameCount);
+    }
+    return result;
+  }
+}
@@ -0,0 +1,152 @@
+#include "benchScenes.hpp"
+#include "../geometryPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // Streams assets in and out every frame with two frames in flight and no vkDeviceWaitIdle: each
+  // frame loads buffers, images and models, fills the new buffers and the ones about to go on the
+  // GPU, then unloads the oldest through the deletion queue. Run without churn first for the
+  // baseline frame time. Throws if releases pile up beyond the frames in flight, or if anything is
+  // left over once the last fences have been waited on.
+  SceneResult runAssetChurn(uint32_t frames) {
+    constexpr uint32_t FRAMES_IN_FLIGHT = BenchFrames::FRAMES_IN_FLIGHT;
+    constexpr uint32_t BUFFERS_PER_FRAME = 8;
+    constexpr uint32_t IMAGES_PER_FRAME = 2;
+    constexpr uint32_t MODELS_PER_FRAME = 4;
+    constexpr size_t LIVE_FRAMES = 16;
+    constexpr VkDeviceSize BUFFER_SIZE = 64 * 1024;
+    constexpr uint32_t IMAGE_SIZE = 256;
+
+    HeadlessDevice headless{"asset-churn"};
+    HelloVulkanDevice &device = headless.device;
+    std::vector<Model::Vertex> mesh = gridMesh(512);
+    // room for the live models and the ones in flight, so the pool only keeps up if released
+    // ranges come back
+    uint32_t vertexCapacity = static_cast<uint32_t>(
+        mesh.size() * MODELS_PER_FRAME * (LIVE_FRAMES + FRAMES_IN_FLIGHT + 2));
+    GeometryPool pool{device, sizeof(Model::Vertex), vertexCapacity, 1024};
+
+    BenchFrames benchFrames{device, "asset-churn"};
+
+    struct Asset {
+      std::vector<std::pair<VkBuffer, VkDeviceMemory>> buffers;
+      std::vector<std::pair<VkImage, VkDeviceMemory>> images;
+      std::vector<std::unique_ptr<Model>> models;
+    };
+    std::deque<Asset> live;
+    size_t baselineAllocations = device.liveMemoryAllocationCount();
+
+    SceneResult result{};
+    result.name = "asset-churn";
+    result.frames = frames;
+    size_t maxPending = 0;
+    uint32_t maxRetiredRanges = 0;
+    double fenceWaitMaxMs = 0.0;
+    for (bool churn : {false, true}) {
+      std::vector<double> frameTimes;
+      for (uint32_t frame = 0; frame < frames; frame++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        VkCommandBuffer commandBuffer = benchFrames.begin(frame);
+        fenceWaitMaxMs = std::max(fenceWaitMaxMs, benchFrames.lastFenceWaitMs());
+        if (churn) {
+          Asset asset;
+          for (uint32_t i = 0; i < BUFFERS_PER_FRAME; i++) {
+            VkBuffer buffer;
+            VkDeviceMemory memory;
+            device.createBuffer(
+                BUFFER_SIZE,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                buffer,
+                memory);
+            vkCmdFillBuffer(commandBuffer, buffer, 0, VK_WHOLE_SIZE, frame);
+            asset.buffers.emplace_back(buffer, memory);
+          }
+          for (uint32_t i = 0; i < IMAGES_PER_FRAME; i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+            imageInfo.extent = {IMAGE_SIZE, IMAGE_SIZE, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImage image;
+            VkDeviceMemory memory;
+            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+            asset.images.emplace_back(image, memory);
+          }
+          for (uint32_t i = 0; i < MODELS_PER_FRAME; i++) {
+            asset.models.push_back(std::make_unique<Model>(pool, mesh));
+          }
+          live.push_back(std::move(asset));
+
+          if (live.size() > LIVE_FRAMES) {
+            // still used by this frame, so the releases have to wait for it
+            Asset &oldest = live.front();
+            for (auto &buffer : oldest.buffers) {
+              vkCmdFillBuffer(commandBuffer, buffer.first, 0, VK_WHOLE_SIZE, 0);
+              device.deferDestroyBuffer(buffer.first, buffer.second);
+            }
+            for (auto &image : oldest.images) {
+              device.deferDestroyImage(image.first, VK_NULL_HANDLE, image.second);
+            }
+            live.pop_front();
+          }
+        }
+        benchFrames.submit();
+
+        maxPending = std::max(maxPending, device.pendingDestructionCount());
+        maxRetiredRanges = std::max(maxRetiredRanges, pool.stats().retiredRanges);
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - frameStart).count());
+      }
+      std::string prefix = churn ? "churn" : "idle";
+      result.addMetric(prefix + "FrameMeanMs", mean(frameTimes));
+      result.addMetric(prefix + "FrameMaxMs", *std::max_element(frameTimes.begin(), frameTimes.end()));
+    }
+
+    // a release waits for at most the frames in flight, plus the one being recorded
+    size_t releasesPerFrame = BUFFERS_PER_FRAME + IMAGES_PER_FRAME;
+    if (maxPending > releasesPerFrame * (FRAMES_IN_FLIGHT + 1)) {
+      throw std::runtime_error(
+          "asset-churn has " + std::to_string(maxPending) + " releases pending, more than the frames in flight hold");
+    }
+
+    // unload the rest, then retire everything by waiting on the last frames alone
+    for (Asset &asset : live) {
+      for (auto &buffer : asset.buffers) {
+        device.deferDestroyBuffer(buffer.first, buffer.second);
+      }
+      for (auto &image : asset.images) {
+        device.deferDestroyImage(image.first, VK_NULL_HANDLE, image.second);
+      }
+    }
+    live.clear();
+    benchFrames.waitAll();
+    // nothing has been recorded since the last submission, so the frame being recorded is empty
+    device.retireFrame(device.submitFrame());
+    if (device.pendingDestructionCount() != 0 || device.liveMemoryAllocationCount() != baselineAllocations) {
+      throw std::runtime_error("asset-churn left releases pending or memory allocated after the last frame");
+    }
+
+    result.objectCount = static_cast<uint32_t>(LIVE_FRAMES * (BUFFERS_PER_FRAME + IMAGES_PER_FRAME + MODELS_PER_FRAME));
+    result.addMetric("maxPendingDestructions", static_cast<double>(maxPending));
+    result.addMetric("maxRetiredRanges", maxRetiredRanges);
+    result.addMetric("deferredDestructions", static_cast<double>(device.deferredDestructionCount()));
+    result.addMetric("fenceWaitMaxMs", fenceWaitMaxMs);
+    return result;
+  }
+}
@@ -0,0 +1,146 @@
+// Headless benchmark: renders a fixed set of scripted scenes for a fixed number of frames and
+// writes a JSON report, optionally comparing it against a stored baseline.
+//
+//   HelloVulkanBench [--frames N] [--warmup N] [--scene NAME] [--output PATH]
+//                    [--baseline PATH] [--threshold FRACTION] [--update-baseline]
+
+#include "benchReport.hpp"
+#include "benchScenes.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// count every host heap allocation so we can report allocations per frame
+static std::atomic<uint64_t> hostAllocations{0};
+
+void *operator new(size_t size) {
+  hostAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+namespace helloVulkan {
+
+  uint64_t hostAllocationCount() {
+    return hostAllocations.load();
+  }
+
+  const std::vector<std::string> COMPARED_METRICS = {
+    "cpuFrameTimeP50Ms",
+    "cpuFrameTimeP99Ms",
+    "drawsPerFrame",
+    "hostAllocationsPerFrame",
+    "deviceMemoryBytes",
+  };
+}
+
+int main(int argc, char **argv) {
+  using namespace helloVulkan;
+
+  uint32_t frames = 600;
+  uint32_t warmupFrames = 60;
+  std::string sceneFilter;
+  std::string outputPath = "build/bench.json";
+  std::string baselinePath = "bench/baseline.json";
+  double threshold = 0.10;
+  bool updateBaseline = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (argument == "--frames" && hasValue) {
+      frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (argument == "--warmup" && hasValue) {
+      warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (argument == "--scene" && hasValue) {
+      sceneFilter = argv[++i];
+    } else if (argument == "--output" && hasValue) {
+      outputPath = argv[++i];
+    } else if (argument == "--baseline" && hasValue) {
+      baselinePath = argv[++i];
+    } else if (argument == "--threshold" && hasValue) {
+      threshold = std::stod(argv[++i]);
+    } else if (argument == "--update-baseline") {
+      updateBaseline = true;
+    } else {
+      std::cerr << "unknown argument " << argument << std::endl;
+      return 2;
+    }
+  }
+
+  BenchReport report{};
+  report.frames = frames;
+  report.warmupFrames = warmupFrames;
+
+  // everything after the BENCH_SCENES, in the order they run
+  const std::vector<std::pair<std::string, std::function<SceneResult()>>> scenes = {
+    {"geometry-churn", [] { return runGeometryChurn(100000); }},
+    {"textures-rgba8", [] { return runTextureLoad("textures-rgba8", VK_FORMAT_R8G8B8A8_UNORM, 32, 1024); }},
+    {"textures-bc1", [] { return runTextureLoad("textures-bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK, 32, 1024); }},
+    {"textures-bc7", [] { return runTextureLoad("textures-bc7", VK_FORMAT_BC7_UNORM_BLOCK, 32, 1024); }},
+    {"textures-astc4x4", [] { return runTextureLoad("textures-astc4x4", VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 32, 1024); }},
+    {"depth-memory", [] { return runDepthMemory(); }},
+    {"device-selection", [] { return runDeviceSelection(); }},
+    {"procedural-sierpinski", [] { return runProceduralGeneration(5); }},
+    {"render-graph", [] { return runRenderGraph(1000); }},
+    {"asset-churn", [&] { return runAssetChurn(frames); }},
+    {"render-thread", [&] { return runRenderThread(warmupFrames, frames); }},
+    {"occlusion-culling", [&] { return runOcclusionCulling(warmupFrames, frames); }},
+    {"log-storm", [&] { return runLogStorm(warmupFrames, frames, "build/log-storm.log"); }},
+    {"vertex-pulling", [&] { return runVertexPulling(warmupFrames, frames); }},
+    {"frame-capture", [] { return runFrameCapture(120); }},
+    {"job-spawn", [] { return runJobSpawn(1 << 20); }},
+    {"parallel-for-scaling", [] { return runParallelForScaling(10); }},
+    {"particles-deterministic", [] { return runParticleDeterminism(120); }},
+    {"texture-streaming", [&] { return runTextureStreaming(frames, "build/texture-streaming.csv"); }},
+  };
+  try {
+    for (const BenchScene &scene : BENCH_SCENES) {
+      if (!sceneFilter.empty() && sceneFilter != scene.name) continue;
+      std::cout << "bench: " << scene.name << std::endl;
+      report.scenes.push_back(runScene(scene, warmupFrames, frames));
+    }
+    for (const auto &scene : scenes) {
+      if (!sceneFilter.empty() && sceneFilter != scene.first) continue;
+      std::cout << "bench: " << scene.first << std::endl;
+      report.scenes.push_back(scene.second());
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "bench failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::ofstream output{outputPath};
+  report.writeJson(output);
+  std::cout << "bench: wrote " << outputPath << std::endl;
+
+  if (updateBaseline) {
+    std::ofstream baselineFile{baselinePath};
+    report.writeJson(baselineFile);
+    std::cout << "bench: updated baseline " << baselinePath << std::endl;
+    return 0;
+  }
+
+  BenchReport baseline{};
+  if (!BenchReport::readJson(baselinePath, baseline)) {
+    std::cout << "bench: no baseline at " << baselinePath << ", run with --update-baseline to record one"
+              << std::endl;
+    return 0;
+  }
+  int regressions = compareToBaseline(report, baseline, COMPARED_METRICS, threshold, std::cout);
+  std::cout << "bench: " << regressions << " regression(s) over " << threshold * 100.0 << "% threshold" << std::endl;
+  return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include "benchHarness.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace helloVulkan {
+
+  uint64_t residentSetBytes() {
+    long pages = 0;
+    long residentPages = 0;
+    if (FILE *statm = std::fopen("/proc/self/statm", "r")) {
+      if (std::fscanf(statm, "%ld %ld", &pages, &residentPages) != 2) residentPages = 0;
+      std::fclose(statm);
+    }
+    return static_cast<uint64_t>(residentPages) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  }
+
+  uint64_t peakResidentSetBytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in KiB on Linux
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+  }
+
+  double processCpuSeconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  std::vector<Model::Vertex> gridMesh(uint32_t triangleCount) {
+    glm::vec3 colourPurple { 0.3f, 0.0f, 0.5f };
+    uint32_t quadCount = std::max(1u, triangleCount / 2);
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(quadCount))));
+    uint32_t rows = (quadCount + columns - 1) / columns;
+    float quadWidth = 1.0f / columns;
+    float quadHeight = 1.0f / rows;
+
+    std::vector<Model::Vertex> vertices;
+    vertices.reserve(quadCount * 6);
+    for (uint32_t quad = 0; quad < quadCount; quad++) {
+      float x = -0.5f + (quad % columns) * quadWidth;
+      float y = -0.5f + (quad / columns) * quadHeight;
+      vertices.push_back({{x, y, 0.5f, 1.0f}, colourPurple});
+      vertices.push_back({{x + quadWidth, y, 0.5f, 1.0f}, colourPurple});
+      vertices.push_back({{x + quadWidth, y + quadHeight, 0.5f, 1.0f}, colourPurple});
+      vertices.push_back({{x, y, 0.5f, 1.0f}, colourPurple});
+      vertices.push_back({{x + quadWidth, y + quadHeight, 0.5f, 1.0f}, colourPurple});
+      vertices.push_back({{x, y + quadHeight, 0.5f, 1.0f}, colourPurple});
+    }
+    return vertices;
+  }
+
+  std::vector<glm::mat4> gridTransforms(uint32_t objectCount) {
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(objectCount))));
+    float scale = 1.0f / side;
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+      float x = -1.0f + (2 * (i % side) + 1) * scale;
+      float y = -1.0f + (2 * (i / side) + 1) * scale;
+      transforms.push_back({
+        scale, 0.0f, 0.0f, 0.0f,
+        0.0f, scale, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.5f, 0.0f,
+        x, y, 0.5f, 1.0f
+      });
+    }
+    return transforms;
+  }
+
+  AppConfig benchAppConfig(uint32_t objectCount, uint32_t trianglesPerMesh) {
+    AppConfig config = App::defaultConfig();
+    if (objectCount > 0) {
+      config.meshVertices = gridMesh(trianglesPerMesh);
+      config.meshIndices.clear();
+      config.objectTransforms = gridTransforms(objectCount);
+    }
+    config.visible = false;
+    config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    return config;
+  }
+
+  std::vector<double> runAppFrames(
+        App &app,
+        uint32_t warmupFrames,
+        uint32_t frames,
+        const std::function<void(uint32_t frame, const FrameStats &stats)> &onFrame) {
+    app.runFrames(warmupFrames, [](const FrameStats &) {});
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frames);
+    app.runFrames(frames, [&](const FrameStats &stats) {
+      if (onFrame) {
+        onFrame(static_cast<uint32_t>(frameTimes.size()), stats);
+      }
+      frameTimes.push_back(stats.cpuFrameTimeMs);
+    });
+    if (frameTimes.size() != frames) {
+      throw std::runtime_error("window closed before the benchmark finished");
+    }
+    return frameTimes;
+  }
+
+  BenchFrames::BenchFrames(HelloVulkanDevice &device, const std::string &name) : device{device}, name{name} {
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    for (VkFence &fence : fences) {
+      if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create " + name + " fence");
+      }
+    }
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = device.getCommandPool();
+    allocInfo.commandBufferCount = FRAMES_IN_FLIGHT;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate " + name + " command buffers");
+    }
+  }
+
+  BenchFrames::~BenchFrames() {
+    waitAll();
+    vkFreeCommandBuffers(device.device(), device.getCommandPool(), FRAMES_IN_FLIGHT, commandBuffers.data());
+    for (VkFence fence : fences) {
+      vkDestroyFence(device.device(), fence, nullptr);
+    }
+  }
+
+  VkCommandBuffer BenchFrames::begin(uint32_t frame) {
+    slot = frame % FRAMES_IN_FLIGHT;
+    auto waitStart = std::chrono::steady_clock::now();
+    vkWaitForFences(device.device(), 1, &fences[slot], VK_TRUE, UINT64_MAX);
+    lastFenceWaitMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+    device.retireFrame(serials[slot]);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffers[slot], &beginInfo);
+    return commandBuffers[slot];
+  }
+
+  void BenchFrames::submit() {
+    vkEndCommandBuffer(commandBuffers[slot]);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffers[slot];
+    vkResetFences(device.device(), 1, &fences[slot]);
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, fences[slot]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit " + name + " frame");
+    }
+    serials[slot] = device.submitFrame();
+  }
+
+  void BenchFrames::waitAll() {
+    vkWaitForFences(device.device(), FRAMES_IN_FLIGHT, fences.data(), VK_TRUE, UINT64_MAX);
+  }
+}
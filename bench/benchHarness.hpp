@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../app.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// What the scenes share: a hidden window with its device for the scenes that drive the device
+// themselves, a frame loop with frames in flight for the ones that submit their own work, and an
+// App config and frame loop for the ones that run the App.
+
+namespace helloVulkan {
+
+  // host heap allocations since startup, counted by the operator new in bench.cpp
+  uint64_t hostAllocationCount();
+  uint64_t residentSetBytes();
+  uint64_t peakResidentSetBytes();
+  // user and system time of the whole process
+  double processCpuSeconds();
+
+  std::vector<Model::Vertex> gridMesh(uint32_t triangleCount);
+  // lays the objects out on a square grid covering the screen
+  std::vector<glm::mat4> gridTransforms(uint32_t objectCount);
+
+  // objectCount copies of a gridMesh of trianglesPerMesh triangles, or the default scene when
+  // objectCount is 0. Hidden and presenting immediately, we want to measure how long a frame
+  // takes, not how long until the next vblank.
+  AppConfig benchAppConfig(uint32_t objectCount, uint32_t trianglesPerMesh);
+
+  // Runs warmupFrames, then frames calling onFrame with the measured frame's index. Returns the
+  // measured frames' CPU frame times, throws if the window closed before they were all run.
+  std::vector<double> runAppFrames(
+      App &app,
+      uint32_t warmupFrames,
+      uint32_t frames,
+      const std::function<void(uint32_t frame, const FrameStats &stats)> &onFrame = {});
+
+  // A hidden window and the device on it
+  struct HeadlessDevice {
+    explicit HeadlessDevice(const char *name) : window{600, 800, name, false}, device{window} {}
+
+    HelloVulkanWindow window;
+    HelloVulkanDevice device;
+  };
+
+  // A fence, command buffer and device frame serial per frame in flight, for scenes recording and
+  // submitting their own frames so deferred destructions retire as they would in the App.
+  class BenchFrames {
+    public:
+      static constexpr uint32_t FRAMES_IN_FLIGHT = HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+      // name goes into the error messages
+      BenchFrames(HelloVulkanDevice &device, const std::string &name);
+      ~BenchFrames();
+
+      BenchFrames(const BenchFrames &) = delete;
+      BenchFrames &operator=(const BenchFrames &) = delete;
+
+      // Waits for frame's slot to come back, retires its serial and begins its command buffer
+      VkCommandBuffer begin(uint32_t frame);
+      // ends and submits the command buffer begin() returned
+      void submit();
+      // waits for every frame in flight
+      void waitAll();
+
+      // how long the last begin() waited on its fence
+      double lastFenceWaitMs() const { return lastFenceWaitMs_; }
+
+    private:
+      HelloVulkanDevice &device;
+      std::string name;
+      std::array<VkFence, FRAMES_IN_FLIGHT> fences{};
+      std::array<VkCommandBuffer, FRAMES_IN_FLIGHT> commandBuffers{};
+      std::array<uint64_t, FRAMES_IN_FLIGHT> serials{};
+      uint32_t slot = 0;
+      double lastFenceWaitMs_ = 0.0;
+  };
+}
@@ -0,0 +1,225 @@
+#include "benchReport.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+namespace helloVulkan {
+
+  namespace {
+    // Just enough of a JSON reader for the reports writeJson produces.
+    struct JsonValue {
+      enum class Type { null, boolean, number, string, array, object } type = Type::null;
+      double number = 0.0;
+      std::string string;
+      std::vector<JsonValue> array;
+      std::vector<std::pair<std::string, JsonValue>> object;
+
+      const JsonValue *find(const std::string &key) const {
+        for (const auto &member : object) {
+          if (member.first == key) return &member.second;
+        }
+        return nullptr;
+      }
+    };
+
+    class JsonParser {
+      public:
+        explicit JsonParser(const std::string &text) : text{text} {}
+
+        bool parse(JsonValue &value) {
+          return parseValue(value) && (skipWhitespace(), position == text.size());
+        }
+
+      private:
+        void skipWhitespace() {
+          while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) position++;
+        }
+
+        bool consume(char expected) {
+          skipWhitespace();
+          if (position < text.size() && text[position] == expected) {
+            position++;
+            return true;
+          }
+          return false;
+        }
+
+        bool parseString(std::string &out) {
+          if (!consume('"')) return false;
+          while (position < text.size() && text[position] != '"') {
+            if (text[position] == '\\' && position + 1 < text.size()) position++;
+            out += text[position++];
+          }
+          return consume('"');
+        }
+
+        bool parseValue(JsonValue &value) {
+          skipWhitespace();
+          if (position >= text.size()) return false;
+          char c = text[position];
+          if (c == '{') {
+            value.type = JsonValue::Type::object;
+            position++;
+            if (consume('}')) return true;
+            do {
+              std::pair<std::string, JsonValue> member;
+              if (!parseString(member.first) || !consume(':') || !parseValue(member.second)) return false;
+              value.object.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+          }
+          if (c == '[') {
+            value.type = JsonValue::Type::array;
+            position++;
+            if (consume(']')) return true;
+            do {
+              value.array.emplace_back();
+              if (!parseValue(value.array.back())) return false;
+            } while (consume(','));
+            return consume(']');
+          }
+          if (c == '"') {
+            value.type = JsonValue::Type::string;
+            return parseString(value.string);
+          }
+          if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value.type = JsonValue::Type::boolean;
+            value.number = text[position] == 't' ? 1.0 : 0.0;
+            position += text[position] == 't' ? 4 : 5;
+            return true;
+          }
+          if (text.compare(position, 4, "null") == 0) {
+            position += 4;
+            return true;
+          }
+          const char *begin = text.c_str() + position;
+          char *end = nullptr;
+          value.type = JsonValue::Type::number;
+          value.number = std::strtod(begin, &end);
+          if (end == begin) return false;
+          position += static_cast<size_t>(end - begin);
+          return true;
+        }
+
+        const std::string &text;
+        size_t position = 0;
+    };
+  }
+
+  const double *SceneResult::findMetric(const std::string &metricName) const {
+    for (const auto &metric : metrics) {
+      if (metric.first == metricName) return &metric.second;
+    }
+    return nullptr;
+  }
+
+  void BenchReport::writeJson(std::ostream &out) const {
+    out << std::setprecision(6) << std::fixed;
+    out << "{\n  \"frames\": " << frames << ",\n  \"warmupFrames\": " << warmupFrames << ",\n  \"scenes\": [";
+    for (size_t i = 0; i < scenes.size(); i++) {
+      const SceneResult &scene = scenes[i];
+      out << (i == 0 ? "\n" : ",\n") << "    {\n"
+          << "      \"name\": \"" << scene.name << "\",\n"
+          << "      \"objectCount\": " << scene.objectCount << ",\n"
+          << "      \"trianglesPerMesh\": " << scene.trianglesPerMesh << ",\n"
+          << "      \"instancing\": " << (scene.instancing ? "true" : "false") << ",\n"
+          << "      \"frames\": " << scene.frames << ",\n"
+          << "      \"metrics\": {";
+      for (size_t m = 0; m < scene.metrics.size(); m++) {
+        out << (m == 0 ? "\n" : ",\n") << "        \"" << scene.metrics[m].first << "\": " << scene.metrics[m].second;
+      }
+      out << "\n      }\n    }";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+  bool BenchReport::readJson(const std::string &path, BenchReport &report) {
+    std::ifstream file{path};
+    if (!file) return false;
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    JsonValue root;
+    if (!JsonParser{text}.parse(root) || root.type != JsonValue::Type::object) return false;
+
+    const JsonValue *scenes = root.find("scenes");
+    if (scenes == nullptr || scenes->type != JsonValue::Type::array) return false;
+    for (const JsonValue &sceneValue : scenes->array) {
+      const JsonValue *name = sceneValue.find("name");
+      const JsonValue *metrics = sceneValue.find("metrics");
+      if (name == nullptr || metrics == nullptr) return false;
+
+      SceneResult scene{};
+      scene.name = name->string;
+      for (const auto &metric : metrics->object) {
+        scene.addMetric(metric.first, metric.second.number);
+      }
+      report.scenes.push_back(std::move(scene));
+    }
+    return true;
+  }
+
+  int compareToBaseline(
+      const BenchReport &current,
+      const BenchReport &baseline,
+      const std::vector<std::string> &comparedMetrics,
+      double threshold,
+      std::ostream &log) {
+    int regressions = 0;
+    log << std::setprecision(3) << std::fixed;
+    for (const SceneResult &scene : current.scenes) {
+      auto baselineScene = std::find_if(
+          baseline.scenes.begin(),
+          baseline.scenes.end(),
+          [&](const SceneResult &other) { return other.name == scene.name; });
+      if (baselineScene == baseline.scenes.end()) {
+        log << scene.name << ": not in baseline, skipped\n";
+        continue;
+      }
+
+      for (const std::string &metricName : comparedMetrics) {
+        const double *value = scene.findMetric(metricName);
+        const double *baselineValue = baselineScene->findMetric(metricName);
+        if (value == nullptr || baselineValue == nullptr) continue;
+
+        double change = *baselineValue > 0.0 ? (*value - *baselineValue) / *baselineValue
+                                             : (*value > 0.0 ? INFINITY : 0.0);
+        bool regressed = change > threshold;
+        regressions += regressed ? 1 : 0;
+        log << (regressed ? "REGRESSION " : "ok         ") << scene.name << " " << metricName << ": "
+            << *baselineValue << " -> " << *value << " (" << std::showpos << change * 100.0
+            << std::noshowpos << "%)\n";
+      }
+    }
+    return regressions;
+  }
+
+  double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::ceil(fraction * values.size()));
+    return values[std::min(values.size() - 1, index == 0 ? 0 : index - 1)];
+  }
+
+  double mean(const std::vector<double> &values) {
+    if (values.empty()) return 0.0;
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+  }
+
+  double standardDeviation(const std::vector<double> &values) {
+    if (values.empty()) return 0.0;
+    double average = mean(values);
+    double variance = 0.0;
+    for (double value : values) {
+      variance += (value - average) * (value - average);
+    }
+    return std::sqrt(variance / values.size());
+  }
+}
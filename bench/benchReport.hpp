@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  struct SceneResult {
+    std::string name;
+    uint32_t objectCount = 0;
+    uint32_t trianglesPerMesh = 0;
+    bool instancing = false;
+    uint32_t frames = 0;
+
+    // metric name -> value, written out in this order
+    std::vector<std::pair<std::string, double>> metrics;
+
+    void addMetric(const std::string &metricName, double value) { metrics.emplace_back(metricName, value); }
+    const double *findMetric(const std::string &metricName) const;
+  };
+
+  struct BenchReport {
+    uint32_t frames = 0;
+    uint32_t warmupFrames = 0;
+    std::vector<SceneResult> scenes;
+
+    void writeJson(std::ostream &out) const;
+    // reads a report previously written by writeJson, only the scene metrics are restored
+    static bool readJson(const std::string &path, BenchReport &report);
+  };
+
+  // Lower is better for every metric we compare, a metric regresses when it grows by more than
+  // threshold (0.1 == 10%) over the baseline. Returns the number of regressions.
+  int compareToBaseline(
+      const BenchReport &current,
+      const BenchReport &baseline,
+      const std::vector<std::string> &comparedMetrics,
+      double threshold,
+      std::ostream &log);
+
+  double percentile(std::vector<double> values, double fraction);
+  // 0 for no values
+  double mean(const std::vector<double> &values);
+  double standardDeviation(const std::vector<double> &values);
+}
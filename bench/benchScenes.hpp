@@ -0,0 +1,52 @@
+#pragma once
+
+#include "benchHarness.hpp"
+#include "benchReport.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// The scripted scenes, one file each (textureScenes.cpp and jobSystemScenes.cpp hold two
+// related ones). bench.cpp runs them in a fixed order and names them in the report.
+
+namespace helloVulkan {
+
+  // A run of the App drawing objectCount copies of a grid mesh
+  struct BenchScene {
+    const char *name;
+    uint32_t objectCount;
+    uint32_t trianglesPerMesh;
+    bool instancing;
+    // flips the cull mode every frame and recreates the swap chain every SWAP_CHAIN_RECREATION_INTERVAL
+    bool stateChurn = false;
+    uint32_t materialCount = 1;
+    // instanced scenes only, animates the instances on the async compute queue
+    bool computeAnimation = false;
+    // maximum particles of a GPU particle system drawn over the objects, 0 for none
+    uint32_t particles = 0;
+  };
+
+  // object count, mesh size and instancing are the axes we care about, keep the names stable
+  // since they are the keys the baseline is matched on
+  extern const std::vector<BenchScene> BENCH_SCENES;
+
+  SceneResult runScene(const BenchScene &scene, uint32_t warmupFrames, uint32_t frames);
+  SceneResult runGeometryChurn(uint32_t operations);
+  SceneResult runTextureLoad(const char *name, VkFormat format, uint32_t textureCount, uint32_t size);
+  SceneResult runTextureStreaming(uint32_t frames, const std::string &csvPath);
+  SceneResult runDepthMemory();
+  SceneResult runRenderGraph(uint32_t recompiles);
+  SceneResult runFrameCapture(uint32_t frames);
+  SceneResult runRenderThread(uint32_t warmupFrames, uint32_t frames);
+  SceneResult runOcclusionCulling(uint32_t warmupFrames, uint32_t frames);
+  SceneResult runLogStorm(uint32_t warmupFrames, uint32_t frames, const std::string &logPath);
+  SceneResult runVertexPulling(uint32_t warmupFrames, uint32_t frames);
+  SceneResult runAssetChurn(uint32_t frames);
+  SceneResult runParticleDeterminism(uint32_t updates);
+  SceneResult runProceduralGeneration(uint32_t repetitions);
+  SceneResult runJobSpawn(uint32_t jobCount);
+  SceneResult runParallelForScaling(uint32_t repetitions);
+  SceneResult runDeviceSelection();
+}
@@ -0,0 +1,49 @@
+#include "benchScenes.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace helloVulkan {
+
+  // What the depth attachments cost at common resolutions, one per swap chain image as before
+  // against one per frame in flight, without creating swap chains at those sizes
+  SceneResult runDepthMemory() {
+    const std::vector<std::pair<const char *, VkExtent2D>> resolutions = {
+      {"720p", {1280, 720}},
+      {"1080p", {1920, 1080}},
+      {"1440p", {2560, 1440}},
+      {"4k", {3840, 2160}},
+    };
+    HeadlessDevice headless{"depth-memory"};
+    HelloVulkanDevice &device = headless.device;
+    HelloVulkanSwapChain swapChain{device, headless.window.getExtent()};
+
+    SceneResult result{};
+    result.name = "depth-memory";
+    result.frames = 1;
+    result.addMetric("swapChainImages", static_cast<double>(swapChain.imageCount()));
+    result.addMetric("framesInFlight", HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+    result.addMetric("lazilyAllocated", swapChain.depthIsLazilyAllocated() ? 1.0 : 0.0);
+    for (const auto &resolution : resolutions) {
+      VkImageCreateInfo imageInfo = HelloVulkanSwapChain::depthImageInfo(resolution.second, swapChain.findDepthFormat());
+      VkImage image;
+      if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth image!");
+      }
+      VkMemoryRequirements memRequirements;
+      vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
+      vkDestroyImage(device.device(), image, nullptr);
+
+      double perImageBytes = static_cast<double>(swapChain.imageCount() * memRequirements.size);
+      double perFrameBytes = static_cast<double>(HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT * memRequirements.size);
+      std::string suffix = resolution.first;
+      result.addMetric("perSwapChainImageBytes" + suffix, perImageBytes);
+      result.addMetric("perFrameInFlightBytes" + suffix, perFrameBytes);
+      // lazily allocated memory may never be committed at all, the saving is then everything
+      result.addMetric("savedBytes" + suffix, swapChain.depthIsLazilyAllocated() ? perImageBytes : perImageBytes - perFrameBytes);
+    }
+    return result;
+  }
+}
@@ -0,0 +1,76 @@
+#include "benchScenes.hpp"
+#include "../physicalDeviceSelection.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // Scores a made up hybrid laptop's device list, so the selection can be checked without the
+  // hardware. Throws if the wrong device comes out.
+  SceneResult runDeviceSelection() {
+    auto device = [](const char *name, VkPhysicalDeviceType type, VkDeviceSize deviceLocalMiB, uint8_t uuidByte) {
+      PhysicalDeviceInfo info{};
+      info.name = name;
+      info.type = type;
+      info.apiVersion = VK_MAKE_VERSION(1, 3, 0);
+      info.uuid.fill(uuidByte);
+      info.deviceLocalBytes = deviceLocalMiB << 20;
+      info.meetsRequirements = true;
+      info.features.samplerAnisotropy = VK_TRUE;
+      info.extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+      return info;
+    };
+    std::vector<PhysicalDeviceInfo> devices = {
+      device("llvmpipe (LLVM 15.0.7, 256 bits)", VK_PHYSICAL_DEVICE_TYPE_CPU, 32768, 0x11),
+      // integrated GPUs report most of system memory as device local
+      device("Intel(R) UHD Graphics 630", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 24576, 0x22),
+      device("NVIDIA GeForce RTX 3060 Laptop GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 6144, 0x33),
+      device("NVIDIA GeForce RTX 3060 Laptop GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 6144, 0x44),
+    };
+    devices[1].features.textureCompressionBC = VK_TRUE;
+    devices[1].extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    devices[2].dedicatedComputeQueue = true;
+    devices[2].dedicatedTransferQueue = true;
+    // same card without a present capable queue, as it is behind some displays
+    devices[3].meetsRequirements = false;
+
+    auto expect = [&](const std::string &preference, size_t expected) {
+      size_t selected = selectPhysicalDevice(devices, preference);
+      if (selected != expected) {
+        throw std::runtime_error("device selection with preference \"" + preference + "\" picked " +
+            std::to_string(selected) + ", expected " + std::to_string(expected));
+      }
+    };
+    auto selectionStart = std::chrono::steady_clock::now();
+    expect("", 2);
+    expect("1", 1);
+    expect("LLVMPIPE", 0);
+    expect("rtx 3060", 2);
+    expect(formatUuid(devices[1].uuid), 1);
+    double selectionMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - selectionStart).count();
+
+    bool unsuitableRejected = false;
+    try {
+      selectPhysicalDevice(devices, "3");
+    } catch (const std::runtime_error &) {
+      unsuitableRejected = true;
+    }
+    if (!unsuitableRejected) {
+      throw std::runtime_error("device selection accepted a device that doesn't meet the requirements");
+    }
+
+    SceneResult result{};
+    result.name = "device-selection";
+    result.frames = 1;
+    result.addMetric("devices", static_cast<double>(devices.size()));
+    result.addMetric("selectionMs", selectionMs);
+    for (size_t i = 0; i < devices.size(); i++) {
+      result.addMetric("score" + std::to_string(i), static_cast<double>(scorePhysicalDevice(devices[i])));
+    }
+    return result;
+  }
+}
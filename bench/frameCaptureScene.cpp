@@ -0,0 +1,162 @@
+#include "benchScenes.hpp"
+#include "../frameCapture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // A 1080p image cleared to a colour that changes every frame, two frames in flight, read back
+  // with each FrameCapture output in turn and once without capturing for the baseline. The
+  // callback run checks every captured frame came back with its colour. Reports what capturing
+  // adds to the frame time and the rate frames are written out at. Throws on a wrong colour.
+  SceneResult runFrameCapture(uint32_t frames) {
+    constexpr VkExtent2D EXTENT{1920, 1080};
+    constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    HeadlessDevice headless{"frame-capture"};
+    HelloVulkanDevice &device = headless.device;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = FORMAT;
+    imageInfo.extent = {EXTENT.width, EXTENT.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+    BenchFrames benchFrames{device, "frame-capture"};
+
+    auto colourOf = [](uint32_t frame) {
+      return std::array<uint8_t, 4>{
+          static_cast<uint8_t>(frame), static_cast<uint8_t>(frame * 7), static_cast<uint8_t>(255 - frame), 255};
+    };
+
+    SceneResult result{};
+    result.name = "frame-capture";
+    result.objectCount = 1;
+    result.frames = frames;
+    double baselineMs = 0.0;
+    std::atomic<uint32_t> wrongFrames{0};
+    const std::vector<std::pair<const char *, std::optional<FrameCaptureOutput>>> modes = {
+      {"none", std::nullopt},
+      {"raw", FrameCaptureOutput::raw},
+      {"y4m", FrameCaptureOutput::y4m},
+      {"callback", FrameCaptureOutput::callback},
+    };
+    for (const auto &mode : modes) {
+      // the colour of every frame that made it into a slot, by capture index. Sized up front, the
+      // worker reads it while frames are still being recorded.
+      std::vector<std::array<uint8_t, 4>> expected(frames);
+      std::unique_ptr<FrameCapture> capture;
+      std::string path = std::string{"build/frame-capture."} + mode.first;
+      if (mode.second) {
+        FrameCaptureConfig config{};
+        config.output = *mode.second;
+        config.path = path;
+        config.callback = [&](const CapturedFrame &frame) {
+          // a row from the middle, the clear covers all of it
+          const uint8_t *row = frame.pixels + static_cast<size_t>(frame.height / 2) * frame.width * 4;
+          for (uint32_t x = 0; x < frame.width; x++) {
+            if (std::memcmp(row + x * 4, expected[frame.index].data(), 4) != 0) {
+              wrongFrames.fetch_add(1);
+              return;
+            }
+          }
+        };
+        capture = std::make_unique<FrameCapture>(device, EXTENT, FORMAT, config);
+      }
+
+      std::vector<double> frameTimes;
+      uint64_t captureIndex = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t frame = 0; frame < frames; frame++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        VkCommandBuffer commandBuffer = benchFrames.begin(frame);
+        if (capture) {
+          capture->collect();
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        std::array<uint8_t, 4> colour = colourOf(frame);
+        VkClearColorValue clear{};
+        for (int c = 0; c < 4; c++) {
+          clear.float32[c] = colour[c] / 255.0f;
+        }
+        vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &barrier.subresourceRange);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        if (capture && capture->recordCopy(commandBuffer, image)) {
+          expected[captureIndex++] = colour;
+        }
+        benchFrames.submit();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - frameStart).count());
+      }
+      double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      benchFrames.waitAll();
+
+      double meanMs = mean(frameTimes);
+      std::string prefix = mode.first;
+      result.addMetric(prefix + "FrameMeanMs", meanMs);
+      result.addMetric(prefix + "FrameP99Ms", percentile(frameTimes, 0.99));
+      if (!capture) {
+        baselineMs = meanMs;
+        continue;
+      }
+      // the rate the worker kept up with while frames were coming in, then everything left
+      FrameCaptureStats during = capture->stats();
+      capture->flush();
+      FrameCaptureStats stats = capture->stats();
+      result.addMetric(prefix + "AddedFrameMs", meanMs - baselineMs);
+      result.addMetric(prefix + "CapturedFps", during.framesWritten / renderSeconds);
+      result.addMetric(prefix + "DroppedFrames", static_cast<double>(stats.framesDropped));
+      result.addMetric(prefix + "WriteMeanMs", stats.writeMs / std::max<uint64_t>(stats.framesWritten, 1));
+      result.addMetric(prefix + "MBWritten", stats.bytesWritten / 1e6);
+      capture.reset();
+      // gigabytes at 1080p, only how fast it was written matters
+      std::remove(path.c_str());
+    }
+    if (wrongFrames.load() != 0) {
+      throw std::runtime_error("frame-capture read back " + std::to_string(wrongFrames.load()) + " frames with the wrong colour");
+    }
+
+    benchFrames.waitAll();
+    vkDestroyImage(device.device(), image, nullptr);
+    device.freeMemory(imageMemory);
+    return result;
+  }
+}
@@ -0,0 +1,63 @@
+#include "benchScenes.hpp"
+#include "../geometryPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace helloVulkan {
+
+  // Loads and unloads meshes of random sizes against the geometry pool's range allocator, CPU only.
+  // Reports how fragmented the free space ends up and how often a load doesn't fit.
+  SceneResult runGeometryChurn(uint32_t operations) {
+    constexpr uint32_t CAPACITY = GeometryPool::DEFAULT_VERTEX_CAPACITY;
+    constexpr size_t TARGET_LIVE_MESHES = 256;
+    RangeAllocator allocator{CAPACITY};
+    std::mt19937 random{1234};
+    // mostly small meshes with the odd large one, like props next to terrain chunks
+    std::uniform_int_distribution<uint32_t> smallMesh{24, 2048};
+    std::uniform_int_distribution<uint32_t> largeMesh{2048, 16384};
+    std::uniform_int_distribution<uint32_t> percent{0, 99};
+
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    uint64_t loads = 0;
+    uint64_t failedLoads = 0;
+    double worstFragmentation = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < operations; i++) {
+      bool unload = !live.empty() && (live.size() >= TARGET_LIVE_MESHES || percent(random) < 40);
+      if (unload) {
+        size_t victim = random() % live.size();
+        allocator.free(live[victim].first, live[victim].second);
+        live[victim] = live.back();
+        live.pop_back();
+        continue;
+      }
+      uint32_t count = percent(random) < 10 ? largeMesh(random) : smallMesh(random);
+      uint32_t offset = allocator.allocate(count);
+      loads++;
+      if (offset == RangeAllocator::INVALID_OFFSET) {
+        failedLoads++;
+        continue;
+      }
+      live.emplace_back(offset, count);
+      worstFragmentation = std::max(worstFragmentation, allocator.fragmentation());
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    SceneResult result{};
+    result.name = "geometry-churn";
+    result.objectCount = static_cast<uint32_t>(live.size());
+    result.frames = operations;
+    result.addMetric("operationMeanNs", elapsedNs / operations);
+    result.addMetric("loads", static_cast<double>(loads));
+    result.addMetric("failedLoads", static_cast<double>(failedLoads));
+    result.addMetric("utilization", static_cast<double>(allocator.used()) / CAPACITY);
+    result.addMetric("freeRanges", static_cast<double>(allocator.freeRangeCount()));
+    result.addMetric("largestFreeRange", static_cast<double>(allocator.largestFreeRange()));
+    result.addMetric("fragmentation", allocator.fragmentation());
+    result.addMetric("worstFragmentation", worstFragmentation);
+    return result;
+  }
+}
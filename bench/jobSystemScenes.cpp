@@ -0,0 +1,132 @@
+#include "benchScenes.hpp"
+#include "../jobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace helloVulkan {
+
+  // Cost of a job from run to the end of wait: batches of empty jobs queued from the main thread,
+  // then a tree of them each queueing two more, which is how parallelFor spreads out. Throws if a
+  // job is lost.
+  SceneResult runJobSpawn(uint32_t jobCount) {
+    JobSystem jobs{};
+    SceneResult result{};
+    result.name = "job-spawn";
+    result.frames = 1;
+    result.addMetric("threads", jobs.threadCount());
+    result.addMetric("jobs", jobCount);
+
+    std::atomic<uint32_t> ran{0};
+    auto start = std::chrono::steady_clock::now();
+    JobCounter counter;
+    for (uint32_t i = 0; i < jobCount; i++) {
+      jobs.run(counter, [&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+      // keep under the per-thread pool so this measures the pool and not the heap fallback
+      if (i % 1024 == 1023) {
+        jobs.wait(counter);
+      }
+    }
+    jobs.wait(counter);
+    double flatNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (ran.load() != jobCount) {
+      throw std::runtime_error("job-spawn ran " + std::to_string(ran.load()) + " of " + std::to_string(jobCount) + " jobs");
+    }
+    result.addMetric("flatNsPerJob", flatNs / jobCount);
+
+    struct Tree {
+      JobSystem &jobs;
+      JobCounter &counter;
+      std::atomic<uint32_t> &ran;
+
+      void spawn(uint32_t depth) {
+        ran.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) {
+          return;
+        }
+        for (int child = 0; child < 2; child++) {
+          jobs.run(counter, [this, depth] { spawn(depth - 1); });
+        }
+      }
+    };
+    // 2^17 - 1 jobs
+    constexpr uint32_t TREE_DEPTH = 16;
+    ran.store(0);
+    JobCounter treeCounter;
+    Tree tree{jobs, treeCounter, ran};
+    start = std::chrono::steady_clock::now();
+    tree.spawn(TREE_DEPTH);
+    jobs.wait(treeCounter);
+    double treeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    uint32_t treeJobs = (1u << (TREE_DEPTH + 1)) - 1;
+    if (ran.load() != treeJobs) {
+      throw std::runtime_error("job-spawn tree ran " + std::to_string(ran.load()) + " of " + std::to_string(treeJobs) + " jobs");
+    }
+    result.addMetric("treeNsPerJob", treeNs / treeJobs);
+
+    JobSystemStats stats = jobs.stats();
+    result.addMetric("steals", static_cast<double>(stats.steals));
+    result.addMetric("heapAllocations", static_cast<double>(stats.heapAllocations));
+    return result;
+  }
+
+  // The same parallelFor, a few transcendental functions per element so it's compute bound, on job
+  // systems of 1 thread up to one per hardware thread. Throws if any run's sum differs.
+  SceneResult runParallelForScaling(uint32_t repetitions) {
+    constexpr uint32_t ELEMENT_COUNT = 1 << 22;
+    constexpr uint32_t GRAIN_SIZE = 4096;
+    std::vector<float> values(ELEMENT_COUNT);
+
+    SceneResult result{};
+    result.name = "parallel-for-scaling";
+    result.frames = repetitions;
+    result.addMetric("elements", ELEMENT_COUNT);
+    result.addMetric("grainSize", GRAIN_SIZE);
+
+    // powers of two, then every hardware thread, e.g. 1 2 4 8 12
+    uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+      threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double singleThreadMs = 0.0;
+    double expectedSum = 0.0;
+    for (uint32_t threads : threadCounts) {
+      JobSystem jobs{threads};
+      auto body = [&values](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          float x = static_cast<float>(i) * 0.001f;
+          values[i] = std::sin(x) * std::cos(x * 0.5f) + std::sqrt(x);
+        }
+      };
+      // warm up the workers and the pages
+      jobs.parallelFor(ELEMENT_COUNT, GRAIN_SIZE, body);
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < repetitions; i++) {
+        jobs.parallelFor(ELEMENT_COUNT, GRAIN_SIZE, body);
+      }
+      double meanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repetitions;
+
+      double sum = std::accumulate(values.begin(), values.end(), 0.0);
+      if (threads == 1) {
+        singleThreadMs = meanMs;
+        expectedSum = sum;
+      } else if (sum != expectedSum) {
+        throw std::runtime_error("parallel-for-scaling got a different result on " + std::to_string(threads) + " threads");
+      }
+      std::string prefix = "threads" + std::to_string(threads);
+      result.addMetric(prefix + "MeanMs", meanMs);
+      result.addMetric(prefix + "Speedup", singleThreadMs / meanMs);
+    }
+    return result;
+  }
+}
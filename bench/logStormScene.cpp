@@ -0,0 +1,136 @@
+#include "benchScenes.hpp"
+#include "../logger.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace helloVulkan {
+
+  // A validation message storm: 500 messages a frame from the thread running the frames, cycling
+  // through 32 message ids the way a broken draw repeats its error, and two more threads standing
+  // in for driver threads. Run quiet, then writing each message straight to the file with a flush
+  // as std::cerr << std::endl did, then through the logger. Everything goes to a file so the
+  // terminal doesn't set the pace. Reports the frame period, which includes the storm, and what the
+  // storm cost the frame thread.
+  SceneResult runLogStorm(uint32_t warmupFrames, uint32_t frames, const std::string &logPath) {
+    constexpr uint32_t MESSAGES_PER_FRAME = 500;
+    constexpr uint32_t MESSAGE_IDS = 32;
+    constexpr uint32_t DRIVER_THREADS = 2;
+    SceneResult result{};
+    result.name = "log-storm";
+    result.objectCount = 1024;
+    result.trianglesPerMesh = 2;
+    result.frames = frames;
+
+    std::FILE *file = std::fopen(logPath.c_str(), "w");
+    if (file == nullptr) {
+      throw std::runtime_error("failed to open " + logPath);
+    }
+    Logger::redirect(file);
+
+    char message[256];
+    std::snprintf(message, sizeof(message), "%s",
+        "Validation Error: [ VUID-vkCmdDrawIndexed-None-02699 ] Object 0: handle = 0x5a000000005a, "
+        "type = VK_OBJECT_TYPE_DESCRIPTOR_SET; | MessageID = 0x2a2b10e5 | the descriptor set bound at "
+        "index 0 is invalid");
+    enum class Mode { quiet, direct, logger };
+    std::mutex directMutex;
+    auto emit = [&](Mode mode, uint32_t messageId) {
+      if (mode == Mode::direct) {
+        std::lock_guard<std::mutex> lock{directMutex};
+        std::fprintf(file, "validation layer: %s\n", message);
+        std::fflush(file);
+      } else {
+        Logger::write(LogSeverity::error, "validation layer", messageId, message);
+      }
+    };
+
+    for (Mode mode : {Mode::quiet, Mode::direct, Mode::logger}) {
+      App app{benchAppConfig(result.objectCount, result.trianglesPerMesh)};
+
+      std::atomic<bool> stopping{false};
+      std::atomic<uint64_t> driverMessages{0};
+      std::vector<std::thread> driverThreads;
+      auto stopDrivers = [&] {
+        stopping.store(true);
+        for (std::thread &thread : driverThreads) {
+          thread.join();
+        }
+      };
+
+      LogStats statsBefore = Logger::stats();
+      std::vector<double> framePeriods;
+      framePeriods.reserve(frames);
+      double stormMs = 0.0;
+      std::chrono::steady_clock::time_point lastFrame{};
+      try {
+        runAppFrames(app, warmupFrames, frames, [&](uint32_t frame, const FrameStats &) {
+          auto now = std::chrono::steady_clock::now();
+          // the driver threads start with the first measured frame, which only starts the first period
+          if (frame == 0) {
+            for (uint32_t thread = 0; mode != Mode::quiet && thread < DRIVER_THREADS; thread++) {
+              driverThreads.emplace_back([&, thread] {
+                for (uint32_t i = 0; !stopping.load(std::memory_order_relaxed); i++) {
+                  emit(mode, 0x1000 + thread * MESSAGE_IDS + i % MESSAGE_IDS);
+                  driverMessages.fetch_add(1, std::memory_order_relaxed);
+                  std::this_thread::sleep_for(std::chrono::microseconds{20});
+                }
+              });
+            }
+          } else {
+            framePeriods.push_back(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+          }
+          if (mode != Mode::quiet) {
+            for (uint32_t i = 0; i < MESSAGES_PER_FRAME; i++) {
+              emit(mode, 1 + i % MESSAGE_IDS);
+            }
+            auto stormEnd = std::chrono::steady_clock::now();
+            stormMs += std::chrono::duration<double, std::milli>(stormEnd - now).count();
+            now = stormEnd;
+          }
+          lastFrame = now;
+        });
+      } catch (...) {
+        stopDrivers();
+        throw;
+      }
+      stopDrivers();
+      Logger::flush();
+
+      std::string prefix = mode == Mode::quiet ? "quiet" : mode == Mode::direct ? "direct" : "logger";
+      result.addMetric(prefix + "FramePeriodMeanMs", mean(framePeriods));
+      result.addMetric(prefix + "FramePeriodP99Ms", percentile(framePeriods, 0.99));
+      result.addMetric(prefix + "FramePeriodMaxMs", percentile(framePeriods, 1.0));
+      if (mode == Mode::quiet) {
+        continue;
+      }
+      uint64_t emitted = static_cast<uint64_t>(MESSAGES_PER_FRAME) * frames + driverMessages.load();
+      result.addMetric(prefix + "StormCostPerFrameMs", stormMs / frames);
+      result.addMetric(prefix + "StormCostPerMessageNs", stormMs * 1e6 / (static_cast<double>(MESSAGES_PER_FRAME) * frames));
+      if (mode == Mode::logger) {
+        LogStats stats = Logger::stats();
+        uint64_t written = stats.written - statsBefore.written;
+        uint64_t suppressed = stats.suppressed - statsBefore.suppressed;
+        uint64_t dropped = stats.dropped - statsBefore.dropped;
+        // suppression summaries are written on top of the messages themselves
+        if (written + suppressed + dropped < emitted) {
+          throw std::runtime_error("the logger lost track of messages");
+        }
+        result.addMetric("loggerMessagesEmitted", static_cast<double>(emitted));
+        result.addMetric("loggerMessagesWritten", static_cast<double>(written));
+        result.addMetric("loggerMessagesSuppressed", static_cast<double>(suppressed));
+        result.addMetric("loggerMessagesDropped", static_cast<double>(dropped));
+      }
+    }
+
+    Logger::redirect(nullptr);
+    std::fclose(file);
+    return result;
+  }
+}
@@ -0,0 +1,106 @@
+#include "benchScenes.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // A wall across the middle 80% of the screen close to the camera with a 64x64 grid of objects
+  // behind it, run without and then with occlusion culling against the depth pyramid. The scene
+  // holds still so every frame hides the same objects. Throws if anything outside the wall is
+  // culled, or if nothing is culled once the pyramid has been read back.
+  SceneResult runOcclusionCulling(uint32_t warmupFrames, uint32_t frames) {
+    constexpr float WALL_EXTENT = 0.8f;
+    SceneResult result{};
+    result.name = "occlusion-culling";
+    result.trianglesPerMesh = 2;
+    result.frames = frames;
+
+    // with no rotation the grid mesh's quad ends up spanning x in [-0.5, 0.5] and y in [0, 1]
+    std::vector<glm::mat4> transforms;
+    transforms.push_back({
+      2 * WALL_EXTENT, 0.0f, 0.0f, 0.0f,
+      0.0f, 2 * WALL_EXTENT, 0.0f, 0.0f,
+      0.0f, 0.0f, 0.01f, 0.0f,
+      0.0f, -WALL_EXTENT, 0.1f, 1.0f
+    });
+    for (glm::mat4 transform : gridTransforms(64 * 64)) {
+      transform[2][2] = 0.1f;
+      transform[3].z = 0.6f;
+      transforms.push_back(transform);
+    }
+    uint32_t potentiallyHidden = 0;
+    for (size_t object = 1; object < transforms.size(); object++) {
+      const glm::mat4 &transform = transforms[object];
+      float halfWidth = transform[0].x * 0.5f;
+      float left = transform[3].x - halfWidth;
+      float right = transform[3].x + halfWidth;
+      float bottom = transform[3].y;
+      float top = transform[3].y + transform[1].y;
+      if (left >= -WALL_EXTENT && right <= WALL_EXTENT && bottom >= -WALL_EXTENT && top <= WALL_EXTENT) {
+        potentiallyHidden++;
+      }
+    }
+    result.objectCount = static_cast<uint32_t>(transforms.size());
+
+    double draws[2] = {};
+    double triangles[2] = {};
+    for (bool occlusionCulling : {false, true}) {
+      AppConfig config = benchAppConfig(result.objectCount, result.trianglesPerMesh);
+      // the wall and the grid behind it rather than the plain grid
+      config.objectTransforms = transforms;
+      config.simulation.initialRotation = 0.0f;
+      config.simulation.rotationSpeed = 0.0f;
+      config.occlusionCulling = occlusionCulling;
+
+      App app{config};
+      uint64_t drawCount = 0;
+      uint64_t triangleCount = 0;
+      uint64_t latency = 0;
+      double recordTime = 0.0;
+      uint64_t primitives = 0;
+      uint32_t statisticsFrames = 0;
+      std::vector<double> frameTimes = runAppFrames(app, warmupFrames, frames, [&](uint32_t, const FrameStats &stats) {
+        if (stats.occludedDraws > potentiallyHidden) {
+          throw std::runtime_error("occlusion culling dropped objects that aren't behind the wall");
+        }
+        // nothing can be culled until the first pyramid has been read back
+        bool tested = stats.occlusionLatencyFrames > 0;
+        if (occlusionCulling ? tested && stats.occludedDraws == 0 : stats.occludedDraws != 0) {
+          throw std::runtime_error(occlusionCulling
+              ? "occlusion culling hid nothing behind the wall"
+              : "objects were culled with occlusion culling off");
+        }
+        drawCount += stats.drawCount;
+        triangleCount += stats.triangles;
+        latency = std::max<uint64_t>(latency, stats.occlusionLatencyFrames);
+        recordTime += stats.recordTimeMs;
+        if (stats.pipelineStatisticsAvailable) {
+          primitives += stats.pipelineStatistics.inputAssemblyPrimitives;
+          statisticsFrames++;
+        }
+      });
+
+      std::string prefix = occlusionCulling ? "culled" : "unculled";
+      draws[occlusionCulling] = static_cast<double>(drawCount) / frames;
+      triangles[occlusionCulling] = static_cast<double>(triangleCount) / frames;
+      result.addMetric(prefix + "DrawsPerFrame", draws[occlusionCulling]);
+      result.addMetric(prefix + "TrianglesPerFrame", triangles[occlusionCulling]);
+      result.addMetric(prefix + "CpuFrameTimeMeanMs", mean(frameTimes));
+      result.addMetric(prefix + "RecordTimeMeanMs", recordTime / frames);
+      if (statisticsFrames > 0) {
+        result.addMetric(prefix + "InputAssemblyPrimitivesPerFrame", static_cast<double>(primitives) / statisticsFrames);
+      }
+      if (occlusionCulling) {
+        // frames between the pyramid tested against and the frame drawn
+        result.addMetric("occlusionLatencyFrames", static_cast<double>(latency));
+      }
+    }
+    result.addMetric("potentiallyHidden", potentiallyHidden);
+    result.addMetric("drawReduction", 1.0 - draws[1] / draws[0]);
+    result.addMetric("triangleReduction", 1.0 - triangles[1] / triangles[0]);
+    return result;
+  }
+}
@@ -0,0 +1,79 @@
+#include "benchScenes.hpp"
+#include "../particleSystem.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // A small particle system stepped on its own, small enough for lavapipe. The emission rate and
+  // time step are exact in binary, so the alive count after every update is known exactly. Two runs
+  // have to end up with the same particles, in whatever order the atomics left them. Throws if
+  // either check fails.
+  SceneResult runParticleDeterminism(uint32_t updates) {
+    ParticleSystemConfig config{};
+    config.maxParticles = 16384;
+    config.timeStep = 1.0f / 64.0f;
+    config.emitRate = 3840.0f;
+    config.lifetime = 1.0f;
+
+    HeadlessDevice headless{"particles-deterministic"};
+    HelloVulkanDevice &device = headless.device;
+
+    // emitted particles are simulated in the same update, so one emitted in update u has aged
+    // (n - u + 1) steps after update n and is gone once that reaches lifetime
+    uint32_t emitPerUpdate = static_cast<uint32_t>(config.emitRate * config.timeStep);
+    uint32_t stepsLived = static_cast<uint32_t>(config.lifetime / config.timeStep) - 1;
+    uint32_t expectedAlive = emitPerUpdate * std::min(updates, stepsLived);
+
+    auto run = [&](ParticleCounters &counters, double &updateMeanMs) {
+      ParticleSystem particles{device, config};
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t update = 0; update < updates; update++) {
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+        particles.update(commandBuffer);
+        device.endSingleTimeCommands(commandBuffer);
+      }
+      updateMeanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / updates;
+      counters = particles.readCounters();
+      std::vector<Particle> alive = particles.readAliveParticles();
+      std::vector<std::array<float, 8>> sorted;
+      sorted.reserve(alive.size());
+      for (const Particle &particle : alive) {
+        sorted.push_back({
+            particle.position.x, particle.position.y, particle.position.z, particle.position.w,
+            particle.velocity.x, particle.velocity.y, particle.velocity.z, particle.velocity.w});
+      }
+      std::sort(sorted.begin(), sorted.end());
+      return sorted;
+    };
+
+    ParticleCounters first{};
+    ParticleCounters second{};
+    double firstUpdateMs = 0.0;
+    double secondUpdateMs = 0.0;
+    auto firstParticles = run(first, firstUpdateMs);
+    auto secondParticles = run(second, secondUpdateMs);
+    if (first.alive != expectedAlive || first.alive + first.dead != config.maxParticles) {
+      throw std::runtime_error("particles-deterministic: " + std::to_string(first.alive) + " alive and " +
+          std::to_string(first.dead) + " dead, expected " + std::to_string(expectedAlive) + " alive");
+    }
+    if (firstParticles != secondParticles) {
+      throw std::runtime_error("particles-deterministic: two runs of the same updates ended with different particles");
+    }
+
+    SceneResult result{};
+    result.name = "particles-deterministic";
+    result.frames = updates;
+    result.addMetric("alive", first.alive);
+    result.addMetric("dead", first.dead);
+    result.addMetric("emittedLastUpdate", first.emittedLastUpdate);
+    // includes a submit and a wait per update
+    result.addMetric("updateMeanMs", (firstUpdateMs + secondUpdateMs) / 2.0);
+    return result;
+  }
+}
@@ -0,0 +1,72 @@
+#include "benchScenes.hpp"
+#include "../jobSystem.hpp"
+#include "../proceduralGeometry.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+
+namespace helloVulkan {
+
+  // A depth 13 Sierpinski triangle, 1.6M triangles, generated on the CPU into the geometry pool's
+  // mapped memory and by the compute shader into its vertex buffer. The first run of each path is
+  // reported on its own since it pays for faulting the pool's pages in, resident set growth over it
+  // is the host memory the path costs. GPU times include the submit and the wait for the queue.
+  SceneResult runProceduralGeneration(uint32_t repetitions) {
+    ProceduralDesc desc{};
+    desc.shape = ProceduralShape::sierpinskiTriangle;
+    desc.depth = 13;
+    uint32_t vertexCount = proceduralVertexCount(desc);
+
+    HeadlessDevice headless{"procedural-sierpinski"};
+    HelloVulkanDevice &device = headless.device;
+
+    SceneResult result{};
+    result.name = "procedural-sierpinski";
+    result.frames = repetitions;
+    result.addMetric("depth", desc.depth);
+    result.addMetric("triangles", static_cast<double>(proceduralPrimitiveCount(desc)));
+    result.addMetric("vertices", vertexCount);
+    result.addMetric("vertexBytes", static_cast<double>(vertexCount) * sizeof(Model::Vertex));
+
+    auto measure = [&](const std::string &prefix, const std::function<void(GeometryPool &, const GeometryRange &)> &generate) {
+      GeometryPool pool{device, static_cast<uint32_t>(sizeof(Model::Vertex)), vertexCount, 1};
+      GeometryRange range = pool.reserve(vertexCount, 0);
+      uint64_t residentBefore = residentSetBytes();
+      auto start = std::chrono::steady_clock::now();
+      generate(pool, range);
+      double firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      uint64_t residentAfter = residentSetBytes();
+      result.addMetric(prefix + "FirstMs", firstMs);
+      result.addMetric(prefix + "ResidentSetGrowthBytes",
+          residentAfter > residentBefore ? static_cast<double>(residentAfter - residentBefore) : 0.0);
+
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < repetitions; i++) {
+        generate(pool, range);
+      }
+      double meanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repetitions;
+      result.addMetric(prefix + "MeanMs", meanMs);
+      result.addMetric(prefix + "VerticesPerSecond", vertexCount / (meanMs / 1000.0));
+    };
+
+    JobSystem singleThread{1};
+    measure("cpuSingleThread", [&](GeometryPool &pool, const GeometryRange &range) {
+      generateProceduralCpu(desc, static_cast<Model::Vertex *>(pool.vertexData(range)), singleThread);
+    });
+    JobSystem jobs{};
+    result.addMetric("jobThreads", jobs.threadCount());
+    measure("cpu", [&](GeometryPool &pool, const GeometryRange &range) {
+      generateProceduralCpu(desc, static_cast<Model::Vertex *>(pool.vertexData(range)), jobs);
+    });
+    if (static_cast<VkDeviceSize>(vertexCount) * sizeof(Model::Vertex) > device.properties.limits.maxStorageBufferRange) {
+      std::cout << "bench: procedural-sierpinski mesh exceeds maxStorageBufferRange, gpu path skipped" << std::endl;
+    } else {
+      ProceduralGpuGenerator generator{device};
+      measure("gpu", [&](GeometryPool &pool, const GeometryRange &range) { generator.generate(desc, pool, range); });
+    }
+    result.addMetric("peakResidentSetBytes", static_cast<double>(peakResidentSetBytes()));
+    return result;
+  }
+}
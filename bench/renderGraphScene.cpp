@@ -0,0 +1,156 @@
+#include "benchScenes.hpp"
+#include "../renderGraph.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace helloVulkan {
+
+  // A deferred style frame at 1080p made of transfer passes, so it runs without shaders: two G-buffer
+  // targets, lighting into an HDR target, a bloom down and up chain and a composite into an
+  // imported image. A debug pass whose output nothing reads has to be culled. The graph is compiled
+  // and submitted with aliasing on and off, the G-buffer memory should be reused by the bloom
+  // targets. Also times a steady state recompile, what the App pays every frame. Throws if the
+  // debug pass survives or aliasing saves nothing.
+  SceneResult runRenderGraph(uint32_t recompiles) {
+    HeadlessDevice headless{"render-graph"};
+    HelloVulkanDevice &device = headless.device;
+    const VkExtent2D full{1920, 1080};
+    const VkExtent2D half{960, 540};
+
+    VkImageCreateInfo outputInfo{};
+    outputInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    outputInfo.imageType = VK_IMAGE_TYPE_2D;
+    outputInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    outputInfo.extent = {full.width, full.height, 1};
+    outputInfo.mipLevels = 1;
+    outputInfo.arrayLayers = 1;
+    outputInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    outputInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    outputInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    outputInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    outputInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImage output;
+    VkDeviceMemory outputMemory;
+    device.createImageWithInfo(outputInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, output, outputMemory);
+
+    RenderGraph graph{device};
+    auto clear = [&graph](RenderGraphResource target, float value) {
+      return [&graph, target, value](VkCommandBuffer commandBuffer) {
+        VkClearColorValue colour{{value, value, value, 1.0f}};
+        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdClearColorImage(commandBuffer, graph.image(target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &colour, 1, &range);
+      };
+    };
+    auto blit = [&graph](RenderGraphResource source, VkExtent2D sourceExtent, RenderGraphResource target, VkExtent2D targetExtent) {
+      return [&graph, source, sourceExtent, target, targetExtent](VkCommandBuffer commandBuffer) {
+        VkImageBlit region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.srcOffsets[1] = {static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstOffsets[1] = {static_cast<int32_t>(targetExtent.width), static_cast<int32_t>(targetExtent.height), 1};
+        vkCmdBlitImage(
+            commandBuffer,
+            graph.image(source),
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            graph.image(target),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &region,
+            VK_FILTER_LINEAR);
+      };
+    };
+    auto declare = [&] {
+      graph.reset();
+      RenderGraphResource albedo = graph.createImage("albedo", {VK_FORMAT_R8G8B8A8_UNORM, full});
+      RenderGraphResource normal = graph.createImage("normal", {VK_FORMAT_R16G16B16A16_SFLOAT, full});
+      RenderGraphResource hdr = graph.createImage("hdr", {VK_FORMAT_R16G16B16A16_SFLOAT, full});
+      RenderGraphResource bloomHalf = graph.createImage("bloomHalf", {VK_FORMAT_R16G16B16A16_SFLOAT, half});
+      RenderGraphResource bloomFull = graph.createImage("bloomFull", {VK_FORMAT_R16G16B16A16_SFLOAT, full});
+      RenderGraphResource debug = graph.createImage("debug", {VK_FORMAT_R8G8B8A8_UNORM, full});
+      RenderGraphResource composite = graph.importImage("output", output, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+
+      graph.addPass("gbufferAlbedo", clear(albedo, 0.25f)).write(albedo, RenderGraphUsage::transfer);
+      graph.addPass("gbufferNormal", clear(normal, 0.5f)).write(normal, RenderGraphUsage::transfer);
+      graph.addPass("lighting", [blit, albedo, normal, hdr, full](VkCommandBuffer commandBuffer) {
+            blit(albedo, full, hdr, full)(commandBuffer);
+            blit(normal, full, hdr, full)(commandBuffer);
+          })
+          .read(albedo, RenderGraphUsage::transfer)
+          .read(normal, RenderGraphUsage::transfer)
+          .write(hdr, RenderGraphUsage::transfer);
+      graph.addPass("debugOverlay", clear(debug, 1.0f)).write(debug, RenderGraphUsage::transfer);
+      graph.addPass("bloomDown", blit(hdr, full, bloomHalf, half))
+          .read(hdr, RenderGraphUsage::transfer)
+          .write(bloomHalf, RenderGraphUsage::transfer);
+      graph.addPass("bloomUp", blit(bloomHalf, half, bloomFull, full))
+          .read(bloomHalf, RenderGraphUsage::transfer)
+          .write(bloomFull, RenderGraphUsage::transfer);
+      graph.addPass("composite", [&graph, hdr, bloomFull, output, full](VkCommandBuffer commandBuffer) {
+            VkImageBlit region{};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.srcOffsets[1] = {static_cast<int32_t>(full.width), static_cast<int32_t>(full.height), 1};
+            region.dstSubresource = region.srcSubresource;
+            region.dstOffsets[1] = region.srcOffsets[1];
+            for (RenderGraphResource source : {hdr, bloomFull}) {
+              vkCmdBlitImage(
+                  commandBuffer,
+                  graph.image(source),
+                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                  output,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                  1,
+                  &region,
+                  VK_FILTER_NEAREST);
+            }
+          })
+          .read(hdr, RenderGraphUsage::transfer)
+          .read(bloomFull, RenderGraphUsage::transfer)
+          .write(composite, RenderGraphUsage::transfer);
+    };
+
+    SceneResult result{};
+    result.name = "render-graph";
+    result.frames = recompiles;
+    for (bool aliasing : {true, false}) {
+      graph.setAliasing(aliasing);
+      declare();
+      graph.compile();
+      VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+      graph.execute(commandBuffer);
+      device.endSingleTimeCommands(commandBuffer);
+
+      const RenderGraphStats &stats = graph.stats();
+      if (!graph.isCulled("debugOverlay") || stats.culledPasses != 1) {
+        throw std::runtime_error("render-graph didn't cull exactly the debug pass");
+      }
+      std::string prefix = aliasing ? "aliased" : "unaliased";
+      result.addMetric(prefix + "TransientBytes", static_cast<double>(stats.transientBytes));
+      result.addMetric(prefix + "BarrierCalls", stats.barrierCalls);
+      result.addMetric(prefix + "ImageBarriers", stats.imageBarriers);
+      if (aliasing) {
+        result.addMetric("passes", stats.passes);
+        result.addMetric("culledPasses", stats.culledPasses);
+        result.addMetric("transientImages", stats.transientImages);
+        if (stats.transientBytes >= stats.transientBytesWithoutAliasing) {
+          throw std::runtime_error("render-graph aliasing saved no memory");
+        }
+      }
+    }
+
+    graph.setAliasing(true);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < recompiles; i++) {
+      declare();
+      graph.compile();
+    }
+    result.addMetric("recompileMeanUs",
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / recompiles);
+
+    vkDeviceWaitIdle(device.device());
+    vkDestroyImage(device.device(), output, nullptr);
+    device.freeMemory(outputMemory);
+    return result;
+  }
+}
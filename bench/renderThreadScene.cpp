@@ -0,0 +1,49 @@
+#include "benchScenes.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // 1024 objects with a simulation whose 60 Hz tick takes 4 ms, stepped in between frames on one
+  // thread and then on its own thread with recording and submitting on a render thread. Reports
+  // frame time spread and how many cores' worth of CPU time the process used over the frames.
+  SceneResult runRenderThread(uint32_t warmupFrames, uint32_t frames) {
+    SceneResult result{};
+    result.name = "render-thread";
+    result.objectCount = 1024;
+    result.frames = frames;
+    for (bool renderThread : {false, true}) {
+      AppConfig config = benchAppConfig(result.objectCount, 2);
+      config.simulation.stepCostMs = 4.0;
+      config.renderThread = renderThread;
+
+      App app{config};
+      // timed from the first measured frame so the warmup stays out of the rates
+      uint64_t firstTick = 0;
+      uint64_t lastTick = 0;
+      double cpuStart = 0.0;
+      std::chrono::steady_clock::time_point wallStart{};
+      std::vector<double> frameTimes = runAppFrames(app, warmupFrames, frames, [&](uint32_t frame, const FrameStats &stats) {
+        if (frame == 0) {
+          firstTick = stats.simulationTicks;
+          cpuStart = processCpuSeconds();
+          wallStart = std::chrono::steady_clock::now();
+        }
+        lastTick = stats.simulationTicks;
+      });
+      double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+      double cpuSeconds = processCpuSeconds() - cpuStart;
+
+      std::string prefix = renderThread ? "threaded" : "serial";
+      result.addMetric(prefix + "FrameTimeMeanMs", mean(frameTimes));
+      result.addMetric(prefix + "FrameTimeStdDevMs", standardDeviation(frameTimes));
+      result.addMetric(prefix + "FrameTimeP99Ms", percentile(frameTimes, 0.99));
+      result.addMetric(prefix + "FrameTimeMaxMs", percentile(frameTimes, 1.0));
+      result.addMetric(prefix + "CpuCoresUsed", cpuSeconds / wallSeconds);
+      result.addMetric(prefix + "SimulationTicksPerSecond", (lastTick - firstTick) / wallSeconds);
+    }
+    return result;
+  }
+}
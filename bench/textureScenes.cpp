@@ -0,0 +1,206 @@
+#include "benchScenes.hpp"
+#include "../texture.hpp"
+#include "../textureStreamer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  namespace {
+    // A KTX2 file with a full mip chain of noise, the content doesn't matter to the upload
+    std::vector<uint8_t> syntheticKtx2(VkFormat format, uint32_t size, std::mt19937 &random) {
+      FormatBlockInfo block = formatBlockInfo(format);
+      uint32_t levelCount = fullMipLevelCount(size, size);
+      size_t headerSize = 80 + 24 * static_cast<size_t>(levelCount);
+      std::vector<uint8_t> bytes(headerSize);
+      auto write = [&bytes](size_t offset, auto value) { std::memcpy(bytes.data() + offset, &value, sizeof(value)); };
+
+      const uint8_t identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+      std::memcpy(bytes.data(), identifier, sizeof(identifier));
+      write(12, static_cast<uint32_t>(format));
+      write(16, uint32_t{1});
+      write(20, size);
+      write(24, size);
+      write(36, uint32_t{1});
+      write(40, levelCount);
+      for (uint32_t level = 0; level < levelCount; level++) {
+        uint32_t levelSize = std::max(size >> level, 1u);
+        uint64_t length = block.levelSize(levelSize, levelSize);
+        write(80 + 24 * static_cast<size_t>(level), static_cast<uint64_t>(bytes.size()));
+        write(88 + 24 * static_cast<size_t>(level), length);
+        write(96 + 24 * static_cast<size_t>(level), length);
+        size_t start = bytes.size();
+        bytes.resize(start + length);
+        std::generate(bytes.begin() + start, bytes.end(), [&random] { return static_cast<uint8_t>(random()); });
+      }
+      return bytes;
+    }
+  }
+
+  // Loads textureCount square textures in one batch. Uncompressed formats upload the top level and
+  // blit the rest of the chain, compressed ones upload every level from a KTX2 file. Reports the
+  // load time and how much GPU memory the format saves over RGBA8.
+  SceneResult runTextureLoad(const char *name, VkFormat format, uint32_t textureCount, uint32_t size) {
+    HeadlessDevice headless{name};
+    HelloVulkanDevice &device = headless.device;
+    SamplerCache samplerCache{device};
+    TextureLoader loader{device, samplerCache};
+
+    SceneResult result{};
+    result.name = name;
+    result.objectCount = textureCount;
+    result.frames = 1;
+    if ((device.getFormatProperties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+      std::cout << "bench: " << name << " format not supported by the device, skipped" << std::endl;
+      result.addMetric("supported", 0.0);
+      return result;
+    }
+
+    std::mt19937 random{1234};
+    std::vector<std::vector<uint8_t>> sources;
+    for (uint32_t i = 0; i < textureCount; i++) {
+      if (formatBlockInfo(format).compressed()) {
+        sources.push_back(syntheticKtx2(format, size, random));
+      } else {
+        sources.emplace_back(formatBlockInfo(format).levelSize(size, size));
+        std::generate(sources.back().begin(), sources.back().end(), [&random] { return static_cast<uint8_t>(random()); });
+      }
+    }
+
+    std::vector<std::shared_ptr<Texture>> textures;
+    for (uint32_t i = 0; i < textureCount; i++) {
+      if (formatBlockInfo(format).compressed()) {
+        textures.push_back(loader.loadKtx2(sources[i], name));
+      } else {
+        textures.push_back(loader.loadPixels(size, size, format, sources[i].data()));
+      }
+    }
+    loader.flush();
+
+    const TextureLoadStats &stats = loader.stats();
+    result.addMetric("supported", 1.0);
+    result.addMetric("loadMs", stats.loadMs);
+    result.addMetric("loadMsPerTexture", stats.loadMs / textureCount);
+    result.addMetric("bytesUploaded", static_cast<double>(stats.bytesUploaded));
+    result.addMetric("textureGpuBytes", static_cast<double>(stats.gpuBytes));
+    result.addMetric("rgba8GpuBytes", static_cast<double>(stats.uncompressedGpuBytes));
+    result.addMetric("gpuBytesSaved", static_cast<double>(stats.uncompressedGpuBytes) - static_cast<double>(stats.gpuBytes));
+    result.addMetric("generatedMipLevels", static_cast<double>(stats.generatedMipLevels));
+    result.addMetric("samplers", static_cast<double>(samplerCache.size()));
+    return result;
+  }
+
+  // A camera wanders over a 16x8 grid of textured tiles whose full chains add up to 4x the streaming
+  // budget. Every frame the tiles near the camera request the level their distance calls for. Reports
+  // update cost and hitches, and writes residency per frame to csvPath.
+  SceneResult runTextureStreaming(uint32_t frames, const std::string &csvPath) {
+    constexpr uint32_t COLUMNS = 16;
+    constexpr uint32_t ROWS = 8;
+    constexpr uint32_t TEXTURE_SIZE = 512;
+    constexpr float VIEW_DISTANCE = 4.0f;
+    constexpr float SCREEN_HEIGHT = 1080.0f;
+    constexpr double HITCH_MS = 4.0;
+
+    HeadlessDevice headless{"texture-streaming"};
+    HelloVulkanDevice &device = headless.device;
+    SamplerCache samplerCache{device};
+
+    std::mt19937 random{1234};
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> sources;
+    VkDeviceSize fullChainBytes = 0;
+    FormatBlockInfo block = formatBlockInfo(VK_FORMAT_R8G8B8A8_UNORM);
+    for (uint32_t i = 0; i < COLUMNS * ROWS; i++) {
+      sources.push_back(std::make_shared<const std::vector<uint8_t>>(
+          syntheticKtx2(VK_FORMAT_R8G8B8A8_UNORM, TEXTURE_SIZE, random)));
+      for (uint32_t level = 0; level < fullMipLevelCount(TEXTURE_SIZE, TEXTURE_SIZE); level++) {
+        fullChainBytes += block.levelSize(std::max(TEXTURE_SIZE >> level, 1u), std::max(TEXTURE_SIZE >> level, 1u));
+      }
+    }
+
+    TextureStreamerConfig config{};
+    config.budgetBytes = fullChainBytes / 4;
+    TextureStreamer streamer{device, samplerCache, config};
+    std::vector<StreamedTextureId> ids;
+    for (uint32_t i = 0; i < sources.size(); i++) {
+      ids.push_back(streamer.add(sources[i], "tile-" + std::to_string(i)));
+    }
+
+    std::ofstream csv{csvPath};
+    csv << "frame,updateMs,committedBytes,residentBytes,budgetBytes,uploadsInFlight,levelDeficit\n";
+    std::vector<double> updateTimes;
+    double residentSum = 0.0;
+    double deficitSum = 0.0;
+    VkDeviceSize residentMax = 0;
+    uint32_t overBudgetFrames = 0;
+    // nothing is drawn, but replaced images are released through the device's frame serials, so
+    // advance them as if each update were a frame retired MAX_FRAMES_IN_FLIGHT frames later
+    std::deque<uint64_t> serials;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      float t = frame / 60.0f;
+      glm::vec3 camera{
+          COLUMNS / 2.0f + (COLUMNS / 2.0f - 1.0f) * std::sin(t * 0.5f),
+          ROWS / 2.0f + (ROWS / 2.0f - 1.0f) * std::cos(t * 0.35f),
+          1.5f + std::sin(t * 0.2f)};
+      for (uint32_t i = 0; i < ids.size(); i++) {
+        glm::vec3 tile{(i % COLUMNS) + 0.5f, (i / COLUMNS) + 0.5f, 0.0f};
+        float distance = glm::length(tile - camera);
+        if (distance < VIEW_DISTANCE) {
+          // a unit tile seen with a ~60 degree vertical field of view
+          streamer.request(ids[i], SCREEN_HEIGHT / (distance * 1.15f));
+        }
+      }
+
+      auto updateStart = std::chrono::steady_clock::now();
+      streamer.update();
+      double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+      updateTimes.push_back(updateMs);
+      serials.push_back(device.submitFrame());
+      if (serials.size() > HelloVulkanSwapChain::MAX_FRAMES_IN_FLIGHT) {
+        device.retireFrame(serials.front());
+        serials.pop_front();
+      }
+
+      const TextureStreamerStats &stats = streamer.stats();
+      residentSum += static_cast<double>(stats.residentBytes);
+      residentMax = std::max(residentMax, stats.residentBytes);
+      deficitSum += stats.levelDeficit;
+      overBudgetFrames += stats.committedBytes > stats.budgetBytes ? 1 : 0;
+      csv << frame << "," << updateMs << "," << stats.committedBytes << "," << stats.residentBytes << ","
+          << stats.budgetBytes << "," << stats.uploadsInFlight << "," << stats.levelDeficit << "\n";
+    }
+    vkDeviceWaitIdle(device.device());
+
+    std::vector<double> sorted = updateTimes;
+    std::sort(sorted.begin(), sorted.end());
+    const TextureStreamerStats &stats = streamer.stats();
+    SceneResult result{};
+    result.name = "texture-streaming";
+    result.objectCount = static_cast<uint32_t>(ids.size());
+    result.frames = frames;
+    result.addMetric("updateMeanMs", std::accumulate(sorted.begin(), sorted.end(), 0.0) / frames);
+    result.addMetric("updateP99Ms", sorted[std::min<size_t>(sorted.size() - 1, sorted.size() * 99 / 100)]);
+    result.addMetric("updateMaxMs", sorted.back());
+    result.addMetric("hitchFrames", static_cast<double>(std::count_if(
+        sorted.begin(), sorted.end(), [](double ms) { return ms > HITCH_MS; })));
+    result.addMetric("budgetBytes", static_cast<double>(stats.budgetBytes));
+    result.addMetric("textureSetBytes", static_cast<double>(fullChainBytes));
+    result.addMetric("residentBytesMean", residentSum / frames);
+    result.addMetric("residentBytesMax", static_cast<double>(residentMax));
+    result.addMetric("overBudgetFrames", overBudgetFrames);
+    result.addMetric("uploads", static_cast<double>(stats.uploadsCompleted));
+    result.addMetric("evictions", static_cast<double>(stats.evictions));
+    result.addMetric("levelDeficitMean", deficitSum / frames);
+    return result;
+  }
+}
@@ -0,0 +1,73 @@
+#include "benchScenes.hpp"
+#include "../vertexPulling.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  // 1024 objects of 512 triangles, drawn with fixed-function vertex input and then pulled from
+  // storage buffers with the mesh stored in three vertex formats, objects cycling through them.
+  // Fixed-function input would need a pipeline per format for that; pulled, the formats share one
+  // pipeline and, with multiDrawIndirect, one draw call. Throws if the pulled frames draw a
+  // different number of triangles or build more than the one pipeline.
+  SceneResult runVertexPulling(uint32_t warmupFrames, uint32_t frames) {
+    const std::vector<VertexFormat> formats = {VertexFormat::full, VertexFormat::compact, VertexFormat::quantized};
+    SceneResult result{};
+    result.name = "vertex-pulling";
+    result.objectCount = 1024;
+    result.trianglesPerMesh = 512;
+    result.frames = frames;
+
+    double trianglesPerFrame[2] = {};
+    for (bool vertexPulling : {false, true}) {
+      AppConfig config = benchAppConfig(result.objectCount, result.trianglesPerMesh);
+      config.vertexPulling = vertexPulling;
+      config.vertexFormats = formats;
+
+      App app{config};
+      uint64_t draws = 0;
+      uint64_t drawCalls = 0;
+      uint64_t triangles = 0;
+      double recordTime = 0.0;
+      uint64_t vertexInvocations = 0;
+      uint32_t statisticsFrames = 0;
+      FrameStats lastFrame{};
+      std::vector<double> frameTimes = runAppFrames(app, warmupFrames, frames, [&](uint32_t, const FrameStats &stats) {
+        draws += stats.drawCount;
+        drawCalls += vertexPulling ? stats.pulledDrawCalls : stats.drawCount;
+        triangles += stats.triangles;
+        recordTime += stats.recordTimeMs;
+        if (stats.pipelineStatisticsAvailable) {
+          vertexInvocations += stats.pipelineStatistics.vertexShaderInvocations;
+          statisticsFrames++;
+        }
+        lastFrame = stats;
+      });
+
+      double meanMs = mean(frameTimes);
+      std::string prefix = vertexPulling ? "pulled" : "fixed";
+      trianglesPerFrame[vertexPulling] = static_cast<double>(triangles) / frames;
+      result.addMetric(prefix + "PipelinesCreated", static_cast<double>(lastFrame.pipelineRegistry.pipelinesCreated));
+      result.addMetric(prefix + "DrawsPerFrame", static_cast<double>(draws) / frames);
+      result.addMetric(prefix + "DrawCallsPerFrame", static_cast<double>(drawCalls) / frames);
+      result.addMetric(prefix + "CpuFrameTimeMeanMs", meanMs);
+      result.addMetric(prefix + "CpuFrameTimeP99Ms", percentile(frameTimes, 0.99));
+      result.addMetric(prefix + "RecordTimeMeanMs", recordTime / frames);
+      result.addMetric(prefix + "DrawsPerSecond", static_cast<double>(draws) / frames / (meanMs / 1000.0));
+      if (statisticsFrames > 0) {
+        result.addMetric(prefix + "VertexShaderInvocationsPerFrame", static_cast<double>(vertexInvocations) / statisticsFrames);
+      }
+      if (vertexPulling && lastFrame.pipelineRegistry.pipelinesCreated != 1) {
+        throw std::runtime_error("vertex pulling built more than one pipeline for its formats");
+      }
+    }
+    if (trianglesPerFrame[0] != trianglesPerFrame[1]) {
+      throw std::runtime_error("vertex pulling drew a different number of triangles");
+    }
+    // one per format with fixed-function vertex input, the run above only had the one format
+    result.addMetric("fixedPipelinesForFormats", static_cast<double>(formats.size()));
+    return result;
+  }
+}
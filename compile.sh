@@ -1,2 +1,4 @@
-glslc shaders/simpleShader.vert -o shaders/simpleShader.vert.spv
-glslc shaders/simpleShader.frag -o shaders/simpleShader.frag.spv
+# the same shaders the Makefile builds, for when only the .spv files are wanted
+for shader in shaders/*.vert shaders/*.frag shaders/*.comp; do
+  glslc "$shader" -o "$shader.spv" || exit 1
+done
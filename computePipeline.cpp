@@ -0,0 +1,50 @@
+#include "computePipeline.hpp"
+
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  ComputePipeline::ComputePipeline(
+        HelloVulkanDevice &device,
+        const std::string &shaderPath,
+        VkPipelineLayout pipelineLayout,
+        const ShaderSpecialization &specialization) :
+        helloVulkanDevice{device},
+        pipelineLayout{pipelineLayout} {
+    ShaderCode code = ShaderLibrary::load(shaderPath);
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.sizeInBytes();
+    moduleInfo.pCode = code.words;
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device.device(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create shader module for " + shaderPath);
+    }
+
+    VkSpecializationInfo specializationInfo = specialization.info();
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkResult result = vkCreateComputePipelines(
+        device.device(), device.pipelineCache(), 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device.device(), shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create compute pipeline for " + shaderPath);
+    }
+  }
+
+  ComputePipeline::~ComputePipeline() {
+    vkDestroyPipeline(helloVulkanDevice.device(), pipeline, nullptr);
+  }
+
+  void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+#include "helloVulkanPipeline.hpp"
+#include "shaderLibrary.hpp"
+
+#include <string>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // A compute shader and the layout it was built against
+  class ComputePipeline {
+    public:
+      // the path is looked up in the ShaderLibrary
+      ComputePipeline(
+          HelloVulkanDevice &device,
+          const std::string &shaderPath,
+          VkPipelineLayout pipelineLayout,
+          const ShaderSpecialization &specialization = {});
+      ~ComputePipeline();
+
+      ComputePipeline(const ComputePipeline &) = delete;
+      ComputePipeline &operator=(const ComputePipeline &) = delete;
+
+      void bind(VkCommandBuffer commandBuffer);
+      VkPipelineLayout layout() const { return pipelineLayout; }
+
+      // workgroups needed to cover count invocations
+      static uint32_t groupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+
+    private:
+      HelloVulkanDevice &helloVulkanDevice;
+      VkPipelineLayout pipelineLayout;
+      VkPipeline pipeline = VK_NULL_HANDLE;
+  };
+}
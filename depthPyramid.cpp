@@ -0,0 +1,450 @@
+#include "depthPyramid.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    struct DepthPyramidPushConstantData {
+      glm::ivec2 sourceSize;
+      glm::ivec2 destinationSize;
+    };
+
+    // matches local_size_x and local_size_y in depthPyramid.comp
+    constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+    // the finest level read back is the first one at most this big, 125x94 texels of 8x8 pixels
+    // for the default window
+    constexpr uint32_t MAX_READBACK_TEXELS = 128 * 128;
+    constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+  }
+
+  DepthPyramid::DepthPyramid(
+        HelloVulkanDevice &device,
+        VkExtent2D depthExtent,
+        const std::vector<VkImageView> &depthViews)
+      : device{device},
+        depthExtent{depthExtent} {
+    createPipeline();
+    targets.resize(depthViews.size());
+    for (size_t frame = 0; frame < depthViews.size(); frame++) {
+      targets[frame].depthView = depthViews[frame];
+    }
+    createTargets();
+  }
+
+  DepthPyramid::~DepthPyramid() {
+    destroyTargets();
+    pipeline.reset();
+    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device.device(), setLayout, nullptr);
+    vkDestroySampler(device.device(), sampler, nullptr);
+  }
+
+  void DepthPyramid::setDepthTargets(VkExtent2D extent, const std::vector<VkImageView> &depthViews) {
+    destroyTargets();
+    depthExtent = extent;
+    targets.assign(depthViews.size(), Target{});
+    for (size_t frame = 0; frame < depthViews.size(); frame++) {
+      targets[frame].depthView = depthViews[frame];
+    }
+    createTargets();
+    tested.clear();
+    testedFrame = 0;
+  }
+
+  void DepthPyramid::createPipeline() {
+    VkDevice vkDevice = device.device();
+    // only ever read with texelFetch, but a sampled image needs one
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(vkDevice, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid sampler");
+    }
+
+    // the level above, or the depth attachment, and the level being written
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(vkDevice, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid descriptor set layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DepthPyramidPushConstantData);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vkDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid pipeline layout");
+    }
+    pipeline = std::make_unique<ComputePipeline>(device, "shaders/depthPyramid.comp.spv", pipelineLayout);
+  }
+
+  void DepthPyramid::createTargets() {
+    levels.clear();
+    VkExtent2D extent = depthExtent;
+    do {
+      extent = {(extent.width + 1) / 2, (extent.height + 1) / 2};
+      levels.push_back({extent, 0});
+    } while (extent.width > 1 || extent.height > 1);
+
+    readbackLevel = 0;
+    while (readbackLevel + 1 < levels.size() &&
+        levels[readbackLevel].extent.width * levels[readbackLevel].extent.height > MAX_READBACK_TEXELS) {
+      readbackLevel++;
+    }
+    readbackBytes = 0;
+    for (uint32_t level = readbackLevel; level < levels.size(); level++) {
+      levels[level].readbackOffset = readbackBytes;
+      readbackBytes += sizeof(float) * static_cast<VkDeviceSize>(levels[level].extent.width) * levels[level].extent.height;
+    }
+
+    uint32_t setCount = static_cast<uint32_t>(targets.size() * levels.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = setCount;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid descriptor pool");
+    }
+
+    for (Target &target : targets) {
+      createTarget(target);
+    }
+  }
+
+  void DepthPyramid::createTarget(Target &target) {
+    VkDevice vkDevice = device.device();
+    uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {levels[0].extent.width, levels[0].extent.height, 1};
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = PYRAMID_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.image, target.memory);
+
+    // a view per level, written through as a storage image and then read by the next level
+    target.levelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = target.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = PYRAMID_FORMAT;
+      viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+      if (vkCreateImageView(vkDevice, &viewInfo, nullptr, &target.levelViews[level]) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create depth pyramid level view");
+      }
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(levelCount, setLayout);
+    target.descriptorSets.resize(levelCount);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = levelCount;
+    setInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(vkDevice, &setInfo, target.descriptorSets.data()) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate depth pyramid descriptor sets");
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+      // the pyramid stays in GENERAL while it's built, the depth attachment is handed over sampled
+      VkDescriptorImageInfo sourceInfo{};
+      sourceInfo.sampler = sampler;
+      sourceInfo.imageView = level == 0 ? target.depthView : target.levelViews[level - 1];
+      sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+      VkDescriptorImageInfo destinationInfo{};
+      destinationInfo.imageView = target.levelViews[level];
+      destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      std::array<VkWriteDescriptorSet, 2> writes{};
+      writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[0].dstSet = target.descriptorSets[level];
+      writes[0].dstBinding = 0;
+      writes[0].descriptorCount = 1;
+      writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      writes[0].pImageInfo = &sourceInfo;
+      writes[1] = writes[0];
+      writes[1].dstBinding = 1;
+      writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[1].pImageInfo = &destinationInfo;
+      vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = readbackBytes;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &target.readbackBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid readback buffer");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(vkDevice, target.readbackBuffer, &memRequirements);
+    // every texel is read on the host, which is slow from uncached memory
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    if (device.hasMemoryType(memRequirements.memoryTypeBits, properties | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+      properties |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    } else if (!device.hasMemoryType(memRequirements.memoryTypeBits, properties)) {
+      properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+    readbackCoherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    target.readbackMemory = device.allocateMemory(memRequirements, properties);
+    vkBindBufferMemory(vkDevice, target.readbackBuffer, target.readbackMemory, 0);
+    void *mapped;
+    vkMapMemory(vkDevice, target.readbackMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    target.readbackMapped = static_cast<const float *>(mapped);
+  }
+
+  void DepthPyramid::destroyTargets() {
+    // frames in flight may still be building or copying them
+    VkDevice vkDevice = device.device();
+    for (Target &target : targets) {
+      for (VkImageView view : target.levelViews) {
+        device.deferDestruction([vkDevice, view] { vkDestroyImageView(vkDevice, view, nullptr); });
+      }
+      device.deferDestroyImage(target.image, VK_NULL_HANDLE, target.memory);
+      device.deferDestroyBuffer(target.readbackBuffer, target.readbackMemory);
+    }
+    targets.clear();
+    if (descriptorPool != VK_NULL_HANDLE) {
+      VkDescriptorPool retiredPool = descriptorPool;
+      device.deferDestruction([vkDevice, retiredPool] { vkDestroyDescriptorPool(vkDevice, retiredPool, nullptr); });
+      descriptorPool = VK_NULL_HANDLE;
+    }
+  }
+
+  void DepthPyramid::record(VkCommandBuffer commandBuffer, uint32_t frame) {
+    PROFILE_FUNCTION();
+    Target &target = targets[frame];
+    uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+    // rebuilt from scratch, the last frame to use it was waited on before this one was recorded
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = target.image;
+    imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &imageBarrier);
+
+    pipeline->bind(commandBuffer);
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    for (uint32_t level = 0; level < levelCount; level++) {
+      vkCmdBindDescriptorSets(
+          commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSets[level], 0, nullptr);
+      VkExtent2D source = level == 0 ? depthExtent : levels[level - 1].extent;
+      VkExtent2D destination = levels[level].extent;
+      DepthPyramidPushConstantData push{};
+      push.sourceSize = {static_cast<int>(source.width), static_cast<int>(source.height)};
+      push.destinationSize = {static_cast<int>(destination.width), static_cast<int>(destination.height)};
+      vkCmdPushConstants(
+          commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidPushConstantData), &push);
+      vkCmdDispatch(
+          commandBuffer,
+          ComputePipeline::groupCount(destination.width, PYRAMID_GROUP_SIZE),
+          ComputePipeline::groupCount(destination.height, PYRAMID_GROUP_SIZE),
+          1);
+
+      // the next level reads this one, the copy reads the coarse end
+      bool last = level + 1 == levelCount;
+      levelBarrier.dstAccessMask = last ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+      vkCmdPipelineBarrier(
+          commandBuffer,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          last ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          0,
+          1, &levelBarrier,
+          0, nullptr,
+          0, nullptr);
+    }
+
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t level = readbackLevel; level < levelCount; level++) {
+      VkBufferImageCopy region{};
+      region.bufferOffset = levels[level].readbackOffset;
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+      region.imageExtent = {levels[level].extent.width, levels[level].extent.height, 1};
+      regions.push_back(region);
+    }
+    vkCmdCopyImageToBuffer(
+        commandBuffer,
+        target.image,
+        VK_IMAGE_LAYOUT_GENERAL,
+        target.readbackBuffer,
+        static_cast<uint32_t>(regions.size()),
+        regions.data());
+
+    // waiting on the fence alone doesn't make the copy visible to the host
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = target.readbackBuffer;
+    hostBarrier.offset = 0;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0, nullptr,
+        1, &hostBarrier,
+        0, nullptr);
+    target.recordedFrame = device.currentFrame();
+  }
+
+  void DepthPyramid::collect() {
+    PROFILE_FUNCTION();
+    uint64_t completed = device.completedFrame();
+    const Target *newest = nullptr;
+    for (const Target &target : targets) {
+      if (target.recordedFrame > testedFrame && target.recordedFrame <= completed &&
+          (newest == nullptr || target.recordedFrame > newest->recordedFrame)) {
+        newest = &target;
+      }
+    }
+    if (newest == nullptr) {
+      return;
+    }
+    if (!readbackCoherent) {
+      VkMappedMemoryRange range{};
+      range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+      range.memory = newest->readbackMemory;
+      range.offset = 0;
+      range.size = VK_WHOLE_SIZE;
+      vkInvalidateMappedMemoryRanges(device.device(), 1, &range);
+    }
+    // copied out, the buffer is written again as soon as its frame in flight comes round
+    tested.assign(newest->readbackMapped, newest->readbackMapped + readbackBytes / sizeof(float));
+    testedFrame = newest->recordedFrame;
+  }
+
+  bool DepthPyramid::isOccluded(
+        const glm::mat4 &transform,
+        const glm::vec3 &boundsMin,
+        const glm::vec3 &boundsMax) const {
+    if (testedFrame == 0) {
+      return false;
+    }
+    glm::vec2 lower{std::numeric_limits<float>::max()};
+    glm::vec2 upper{std::numeric_limits<float>::lowest()};
+    float nearest = std::numeric_limits<float>::max();
+    for (uint32_t corner = 0; corner < 8; corner++) {
+      glm::vec4 position{
+          (corner & 1) != 0 ? boundsMax.x : boundsMin.x,
+          (corner & 2) != 0 ? boundsMax.y : boundsMin.y,
+          (corner & 4) != 0 ? boundsMax.z : boundsMin.z,
+          1.0f};
+      glm::vec4 clip = transform * position;
+      // reaches behind the eye, the corners don't bound its projection
+      if (clip.w <= 0.0f) {
+        return false;
+      }
+      glm::vec3 ndc = glm::vec3{clip} / clip.w;
+      lower = glm::min(lower, glm::vec2{ndc});
+      upper = glm::max(upper, glm::vec2{ndc});
+      nearest = std::min(nearest, ndc.z);
+    }
+    // cut by the near plane rather than hidden
+    if (nearest < 0.0f) {
+      return false;
+    }
+
+    // to depth attachment pixels, anything outside the view is left to clipping
+    glm::vec2 size{static_cast<float>(depthExtent.width), static_cast<float>(depthExtent.height)};
+    glm::vec2 low = (lower * 0.5f + 0.5f) * size;
+    glm::vec2 high = (upper * 0.5f + 0.5f) * size;
+    if (high.x < 0.0f || high.y < 0.0f || low.x >= size.x || low.y >= size.y) {
+      return false;
+    }
+    low = glm::max(low, glm::vec2{0.0f});
+    high = glm::min(high, size - 1.0f);
+    uint32_t x0 = static_cast<uint32_t>(low.x);
+    uint32_t y0 = static_cast<uint32_t>(low.y);
+    uint32_t x1 = static_cast<uint32_t>(high.x);
+    uint32_t y1 = static_cast<uint32_t>(high.y);
+
+    // a texel of level n covers 2^(n + 1) pixels a side, the first level at least as wide as the
+    // bounds covers them with two texels a side at most
+    uint32_t span = std::max(x1 - x0, y1 - y0) + 1;
+    uint32_t level = readbackLevel;
+    while ((2u << level) < span && level + 1 < levels.size()) {
+      level++;
+    }
+    const Level &pyramidLevel = levels[level];
+    const float *texels = tested.data() + pyramidLevel.readbackOffset / sizeof(float);
+    uint32_t shift = level + 1;
+    float farthest = 0.0f;
+    for (uint32_t y = y0 >> shift; y <= y1 >> shift; y++) {
+      for (uint32_t x = x0 >> shift; x <= x1 >> shift; x++) {
+        farthest = std::max(farthest, texels[y * pyramidLevel.extent.width + x]);
+      }
+    }
+    return nearest > farthest;
+  }
+
+  DepthPyramidStats DepthPyramid::stats() const {
+    DepthPyramidStats stats{};
+    stats.levels = static_cast<uint32_t>(levels.size());
+    stats.readbackLevel = readbackLevel;
+    stats.readbackBytes = readbackBytes;
+    stats.testedFrame = testedFrame;
+    return stats;
+  }
+}
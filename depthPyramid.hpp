@@ -0,0 +1,107 @@
+#pragma once
+
+#include "computePipeline.hpp"
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace helloVulkan {
+
+  struct DepthPyramidStats {
+    uint32_t levels = 0;
+    // the first level read back and the bytes copied for each frame
+    uint32_t readbackLevel = 0;
+    VkDeviceSize readbackBytes = 0;
+    // device frame the tests are running against, 0 before the first readback
+    uint64_t testedFrame = 0;
+  };
+
+  // Hierarchical depth for occlusion culling. Every frame shaders/depthPyramid.comp reduces the
+  // frame's depth attachment to a chain of half resolution levels holding the farthest depth under
+  // each texel, and the coarse end of the chain is copied to a host visible buffer. Once the device
+  // has retired that frame, collect() takes the copy and isOccluded() tests bounds against it on
+  // the host, so the draws are decided before they are recorded.
+  //
+  // The tests run against a frame up to MAX_FRAMES_IN_FLIGHT behind the one being recorded. An
+  // object that comes out from behind its occluder is drawn again once a pyramid without the
+  // occluder in front of it has been read back, so it can appear that many frames late.
+  //
+  // Depth has to run from 0 at the near plane to 1 at the far one with a LESS test, as the scene
+  // draws it.
+  class DepthPyramid {
+    public:
+      // one depth view per frame in flight, see setDepthTargets
+      DepthPyramid(HelloVulkanDevice &device, VkExtent2D depthExtent, const std::vector<VkImageView> &depthViews);
+      ~DepthPyramid();
+
+      DepthPyramid(const DepthPyramid &) = delete;
+      DepthPyramid &operator=(const DepthPyramid &) = delete;
+
+      // for a new swap chain, the old pyramids go through the deletion queue and the readback
+      // taken from them is dropped
+      void setDepthTargets(VkExtent2D depthExtent, const std::vector<VkImageView> &depthViews);
+
+      // Builds frame's pyramid from its depth view, which has to be in SHADER_READ_ONLY_OPTIMAL with
+      // the depth writes already made visible to compute, and copies it for the host
+      void record(VkCommandBuffer commandBuffer, uint32_t frame);
+      // takes the newest copy of a frame the device has retired, call once a frame before testing
+      void collect();
+
+      // true when everything inside the box, put through transform to clip space, is behind the
+      // depth of the pyramid being tested against. False without one. Safe to call from several
+      // threads between collect() calls.
+      bool isOccluded(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const;
+
+      DepthPyramidStats stats() const;
+
+    private:
+      struct Level {
+        VkExtent2D extent;
+        // into the readback buffer, readback levels only
+        VkDeviceSize readbackOffset;
+      };
+
+      // per frame in flight
+      struct Target {
+        VkImageView depthView = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        std::vector<VkImageView> levelViews;
+        std::vector<VkDescriptorSet> descriptorSets;
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+        const float *readbackMapped = nullptr;
+        // device frame that last copied into the readback buffer, 0 for none
+        uint64_t recordedFrame = 0;
+      };
+
+      void createPipeline();
+      void createTargets();
+      void destroyTargets();
+      void createTarget(Target &target);
+
+      HelloVulkanDevice &device;
+      VkExtent2D depthExtent;
+      std::vector<Level> levels;
+      uint32_t readbackLevel = 0;
+      VkDeviceSize readbackBytes = 0;
+      bool readbackCoherent = true;
+
+      VkSampler sampler = VK_NULL_HANDLE;
+      VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+      VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+      std::unique_ptr<ComputePipeline> pipeline;
+      VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+      std::vector<Target> targets;
+
+      // the readback levels of the pyramid isOccluded tests against, levels[readbackLevel] first
+      std::vector<float> tested;
+      uint64_t testedFrame = 0;
+  };
+}
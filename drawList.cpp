@@ -0,0 +1,108 @@
+#include "drawList.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <string>
+
+namespace helloVulkan {
+
+  uint64_t SortKey::make(uint32_t layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+    constexpr uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+    uint64_t quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * DEPTH_MAX);
+
+    uint64_t key = layer & ((1u << LAYER_BITS) - 1);
+    key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+    key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+    key = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+    key = (key << DEPTH_BITS) | quantizedDepth;
+    return key;
+  }
+
+  DrawList::DrawList() {
+    const char *disable = std::getenv("HELLO_VULKAN_DISABLE_DRAW_SORT");
+    sortEnabled = disable == nullptr || std::string{disable} != "1";
+  }
+
+  void DrawList::clear() {
+    packets.clear();
+    order.clear();
+  }
+
+  void DrawList::sort() {
+    PROFILE_FUNCTION();
+    order.resize(packets.size());
+    for (uint32_t i = 0; i < packets.size(); i++) {
+      order[i] = {packets[i].sortKey, i};
+    }
+    if (!sortEnabled || order.size() < 2) {
+      return;
+    }
+
+    scratch.resize(order.size());
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+      std::array<uint32_t, 256> counts{};
+      for (const SortEntry &entry : order) {
+        counts[(entry.key >> shift) & 0xff]++;
+      }
+      // every key has the same byte here, the pass wouldn't move anything
+      if (counts[(order[0].key >> shift) & 0xff] == order.size()) {
+        continue;
+      }
+
+      uint32_t offset = 0;
+      for (uint32_t &count : counts) {
+        uint32_t bucketSize = count;
+        count = offset;
+        offset += bucketSize;
+      }
+      for (const SortEntry &entry : order) {
+        scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+      }
+      order.swap(scratch);
+    }
+  }
+
+  DrawListStats DrawList::record(
+        VkCommandBuffer commandBuffer,
+        VkPipelineLayout pipelineLayout,
+        VkShaderStageFlags pushConstantStages) {
+    PROFILE_FUNCTION();
+    // sort() wasn't called, record in submission order
+    if (order.size() != packets.size()) {
+      order.resize(packets.size());
+      for (uint32_t i = 0; i < packets.size(); i++) {
+        order[i] = {packets[i].sortKey, i};
+      }
+    }
+
+    DrawListStats stats{};
+    Pipeline *boundPipeline = nullptr;
+    GeometryPool *boundPool = nullptr;
+    for (const SortEntry &entry : order) {
+      const DrawPacket &packet = packets[entry.packet];
+      if (packet.pipeline != boundPipeline) {
+        packet.pipeline->bind(commandBuffer);
+        boundPipeline = packet.pipeline;
+        stats.pipelineBinds++;
+      }
+      if (&packet.model->geometryPool() != boundPool) {
+        packet.model->bind(commandBuffer);
+        boundPool = &packet.model->geometryPool();
+        stats.vertexBufferBinds++;
+      }
+
+      vkCmdPushConstants(
+          commandBuffer,
+          pipelineLayout,
+          pushConstantStages,
+          0,
+          sizeof(glm::mat4),
+          &packet.transform);
+      packet.model->draw(commandBuffer);
+      stats.draws++;
+    }
+    return stats;
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "helloVulkanPipeline.hpp"
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // 64 bit draw sort key, most significant field first so sorting groups draws by layer, then
+  // pipeline, then material, then mesh, and finally front to back:
+  //
+  //   | layer 4 | pipeline 12 | material 16 | mesh 12 | depth 20 |
+  struct SortKey {
+    static constexpr uint32_t LAYER_BITS = 4;
+    static constexpr uint32_t PIPELINE_BITS = 12;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t MESH_BITS = 12;
+    static constexpr uint32_t DEPTH_BITS = 20;
+
+    // ids are truncated to their field width, depth is clamped to [0, 1]
+    static uint64_t make(uint32_t layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+  };
+
+  struct DrawPacket {
+    uint64_t sortKey;
+    Pipeline *pipeline;
+    Model *model;
+    // pushed as the vertex stage push constant
+    glm::mat4 transform;
+  };
+
+  struct DrawListStats {
+    uint32_t draws = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+  };
+
+  // Collects a frame's draws, sorts them by key and records them, skipping binds of the pipeline
+  // or geometry pool that is already bound. Storage is kept between frames so steady state doesn't
+  // allocate. HELLO_VULKAN_DISABLE_DRAW_SORT=1 records in submission order instead, to compare.
+  class DrawList {
+    public:
+      DrawList();
+
+      void clear();
+      void push(const DrawPacket &packet) { packets.push_back(packet); }
+      // for filling the list from several jobs at once, each writing its own slots with packet()
+      void resize(size_t count) { packets.resize(count); }
+      DrawPacket &packet(size_t index) { return packets[index]; }
+      size_t size() const { return packets.size(); }
+
+      // LSD radix sort over the keys, 8 bits per pass, passes where every key has the same byte are skipped
+      void sort();
+      // dynamic state has to be set by the caller, the list only binds and draws
+      DrawListStats record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkShaderStageFlags pushConstantStages);
+
+    private:
+      struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+      };
+
+      bool sortEnabled = true;
+      std::vector<DrawPacket> packets;
+      std::vector<SortEntry> order;
+      std::vector<SortEntry> scratch;
+  };
+}
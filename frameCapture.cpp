@@ -0,0 +1,274 @@
+#include "frameCapture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    bool isBgra(VkFormat format) {
+      return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    }
+  }
+
+  FrameCapture::FrameCapture(
+        HelloVulkanDevice &device,
+        VkExtent2D extent,
+        VkFormat format,
+        const FrameCaptureConfig &config)
+      : device{device},
+        extent_{extent},
+        format{format},
+        config{config},
+        frameBytes{static_cast<VkDeviceSize>(extent.width) * extent.height * 4} {
+    if (!supportsFormat(format)) {
+      throw std::runtime_error("Frame capture only supports 8 bit RGBA and BGRA images");
+    }
+    if (config.output == FrameCaptureOutput::callback && !config.callback) {
+      throw std::runtime_error("Frame capture to a callback without a callback");
+    }
+    if (config.output != FrameCaptureOutput::callback) {
+      file.open(config.path, std::ios::binary | std::ios::trunc);
+      if (!file) {
+        throw std::runtime_error("Failed to open " + config.path + " for frame capture");
+      }
+    }
+    if (config.output == FrameCaptureOutput::y4m) {
+      file << "YUV4MPEG2 W" << extent.width << " H" << extent.height << " F" << config.framesPerSecond
+           << ":1 Ip A1:1 C444\n";
+      planes.resize(static_cast<size_t>(extent.width) * extent.height * 3);
+    }
+    createSlots();
+    worker = std::thread{&FrameCapture::workerLoop, this};
+  }
+
+  FrameCapture::~FrameCapture() {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      stopping = true;
+    }
+    workAvailable.notify_all();
+    worker.join();
+    // slots still in flight are dropped, the GPU may be copying into them until their frame retires
+    for (Slot &slot : slots) {
+      device.deferDestroyBuffer(slot.buffer, slot.memory);
+    }
+  }
+
+  bool FrameCapture::supportsFormat(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_R8G8B8A8_UNORM:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void FrameCapture::createSlots() {
+    slots.resize(std::max(config.ringSize, 1u));
+    for (Slot &slot : slots) {
+      VkBufferCreateInfo bufferInfo{};
+      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferInfo.size = frameBytes;
+      bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      if (vkCreateBuffer(device.device(), &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create frame capture buffer!");
+      }
+      VkMemoryRequirements memRequirements;
+      vkGetBufferMemoryRequirements(device.device(), slot.buffer, &memRequirements);
+
+      // the worker reads every byte, which is slow from uncached memory
+      VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      if (device.hasMemoryType(memRequirements.memoryTypeBits, properties | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        properties |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      } else if (!device.hasMemoryType(memRequirements.memoryTypeBits, properties)) {
+        properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      }
+      coherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+      slot.memory = device.allocateMemory(memRequirements, properties);
+      vkBindBufferMemory(device.device(), slot.buffer, slot.memory, 0);
+      void *mapped;
+      vkMapMemory(device.device(), slot.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+      slot.mapped = static_cast<const uint8_t *>(mapped);
+    }
+  }
+
+  bool FrameCapture::recordCopy(VkCommandBuffer commandBuffer, VkImage image) {
+    Slot *slot = nullptr;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      auto free = std::find_if(slots.begin(), slots.end(), [](const Slot &s) { return s.state == SlotState::free; });
+      if (free == slots.end()) {
+        stats_.framesDropped++;
+        return false;
+      }
+      slot = &*free;
+      slot->state = SlotState::inFlight;
+      slot->deviceFrame = device.currentFrame();
+      slot->index = nextIndex++;
+      stats_.framesCopied++;
+    }
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent_.width, extent_.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    // waiting on the fence alone doesn't make the copy visible to the host
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot->buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0, nullptr,
+        1, &barrier,
+        0, nullptr);
+    return true;
+  }
+
+  void FrameCapture::skipFrame() {
+    std::lock_guard<std::mutex> lock{mutex};
+    stats_.framesDropped++;
+  }
+
+  void FrameCapture::collect() {
+    uint64_t completed = device.completedFrame();
+    std::vector<Slot *> done;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      for (Slot &slot : slots) {
+        if (slot.state == SlotState::inFlight && slot.deviceFrame <= completed) {
+          done.push_back(&slot);
+        }
+      }
+      // written out in the order they were rendered
+      std::sort(done.begin(), done.end(), [](const Slot *a, const Slot *b) { return a->index < b->index; });
+      for (Slot *slot : done) {
+        queueForWriting(*slot);
+      }
+    }
+    if (!done.empty()) {
+      workAvailable.notify_one();
+    }
+  }
+
+  void FrameCapture::flush() {
+    std::unique_lock<std::mutex> lock{mutex};
+    std::vector<Slot *> recorded;
+    for (Slot &slot : slots) {
+      if (slot.state == SlotState::inFlight) {
+        recorded.push_back(&slot);
+      }
+    }
+    std::sort(recorded.begin(), recorded.end(), [](const Slot *a, const Slot *b) { return a->index < b->index; });
+    for (Slot *slot : recorded) {
+      queueForWriting(*slot);
+    }
+    workAvailable.notify_one();
+    workDone.wait(lock, [&] { return queue.empty() && !writing; });
+  }
+
+  void FrameCapture::queueForWriting(Slot &slot) {
+    slot.state = SlotState::writing;
+    queue.push_back(&slot);
+  }
+
+  void FrameCapture::workerLoop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      workAvailable.wait(lock, [&] { return stopping || !queue.empty(); });
+      // whatever was already queued is written out before stopping
+      if (queue.empty()) {
+        break;
+      }
+      Slot *slot = queue.front();
+      queue.pop_front();
+      writing = true;
+      lock.unlock();
+
+      auto writeStart = std::chrono::steady_clock::now();
+      if (!coherent) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot->memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device.device(), 1, &range);
+      }
+      uint64_t bytes = write(*slot);
+      double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+
+      lock.lock();
+      slot->state = SlotState::free;
+      writing = false;
+      stats_.framesWritten++;
+      stats_.bytesWritten += bytes;
+      stats_.writeMs += writeMs;
+      workDone.notify_all();
+    }
+  }
+
+  uint64_t FrameCapture::write(const Slot &slot) {
+    switch (config.output) {
+      case FrameCaptureOutput::raw:
+        file.write(reinterpret_cast<const char *>(slot.mapped), static_cast<std::streamsize>(frameBytes));
+        return frameBytes;
+      case FrameCaptureOutput::y4m:
+        return writeY4mFrame(slot.mapped);
+      case FrameCaptureOutput::callback: {
+        CapturedFrame frame{};
+        frame.index = slot.index;
+        frame.width = extent_.width;
+        frame.height = extent_.height;
+        frame.format = format;
+        frame.pixels = slot.mapped;
+        config.callback(frame);
+        return frameBytes;
+      }
+    }
+    return 0;
+  }
+
+  uint64_t FrameCapture::writeY4mFrame(const uint8_t *pixels) {
+    size_t pixelCount = static_cast<size_t>(extent_.width) * extent_.height;
+    uint8_t *y = planes.data();
+    uint8_t *u = y + pixelCount;
+    uint8_t *v = u + pixelCount;
+    int red = isBgra(format) ? 2 : 0;
+    int blue = 2 - red;
+    // BT.709 studio range in 8.8 fixed point, rounded so each chroma row sums to zero and greys
+    // land on 128. The chroma offsets are folded in so nothing is negative before the shift.
+    for (size_t i = 0; i < pixelCount; i++) {
+      int r = pixels[i * 4 + red];
+      int g = pixels[i * 4 + 1];
+      int b = pixels[i * 4 + blue];
+      y[i] = static_cast<uint8_t>(((47 * r + 157 * g + 16 * b + 128) >> 8) + 16);
+      u[i] = static_cast<uint8_t>((-26 * r - 86 * g + 112 * b + (128 << 8) + 128) >> 8);
+      v[i] = static_cast<uint8_t>((112 * r - 102 * g - 10 * b + (128 << 8) + 128) >> 8);
+    }
+    static const char FRAME_HEADER[] = "FRAME\n";
+    file.write(FRAME_HEADER, sizeof(FRAME_HEADER) - 1);
+    file.write(reinterpret_cast<const char *>(planes.data()), static_cast<std::streamsize>(planes.size()));
+    return sizeof(FRAME_HEADER) - 1 + planes.size();
+  }
+
+  FrameCaptureStats FrameCapture::stats() {
+    std::lock_guard<std::mutex> lock{mutex};
+    return stats_;
+  }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // a finished frame as the worker hands it over, pixels are tightly packed rows of 4 bytes each
+  // and only valid during the callback
+  struct CapturedFrame {
+    uint64_t index = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    const uint8_t *pixels = nullptr;
+  };
+
+  enum class FrameCaptureOutput {
+    // the pixels exactly as copied, frame after frame
+    raw,
+    // YUV4MPEG2 with 4:4:4 BT.709 studio range, plays in ffmpeg and mpv
+    y4m,
+    callback
+  };
+
+  struct FrameCaptureConfig {
+    FrameCaptureOutput output = FrameCaptureOutput::raw;
+    // raw and y4m only
+    std::string path = "capture.raw";
+    // callback only, called on the worker thread
+    std::function<void(const CapturedFrame &)> callback;
+    // y4m header only
+    uint32_t framesPerSecond = 60;
+    // readback buffers, enough for the frames in flight plus one being written out and a spare.
+    // When all of them are busy the frame isn't captured.
+    uint32_t ringSize = 4;
+  };
+
+  struct FrameCaptureStats {
+    uint64_t framesCopied = 0;
+    uint64_t framesWritten = 0;
+    // every ring slot was still in flight or being written out, or skipFrame()
+    uint64_t framesDropped = 0;
+    // including what went to the callback
+    uint64_t bytesWritten = 0;
+    // the worker's time converting and writing
+    double writeMs = 0.0;
+  };
+
+  // Reads rendered frames back without the render loop waiting on them. recordCopy() copies the
+  // frame's image into a host visible ring slot, collect() hands slots whose frame the device has
+  // retired to a worker thread, which writes them out and frees the slot again. Nothing is mapped
+  // or read before the frame's fence has signalled.
+  //
+  // Only 4 byte RGBA and BGRA formats. Frames still in flight when it is destroyed are dropped,
+  // flush() first once the device is idle to keep them.
+  class FrameCapture {
+    public:
+      FrameCapture(HelloVulkanDevice &device, VkExtent2D extent, VkFormat format, const FrameCaptureConfig &config);
+      ~FrameCapture();
+
+      FrameCapture(const FrameCapture &) = delete;
+      FrameCapture &operator=(const FrameCapture &) = delete;
+
+      static bool supportsFormat(VkFormat format);
+
+      // Copies image, in TRANSFER_SRC_OPTIMAL and with the transfer read already synchronised, into
+      // a free slot for the frame being recorded. Returns false if the frame was dropped.
+      bool recordCopy(VkCommandBuffer commandBuffer, VkImage image);
+      // counts a frame that couldn't be copied as dropped, e.g. one at another size
+      void skipFrame();
+      // call once a frame, after the device has retired the frames it can
+      void collect();
+      // everything recorded is written out, only once the GPU is done with it
+      void flush();
+
+      VkExtent2D extent() const { return extent_; }
+      FrameCaptureStats stats();
+
+    private:
+      enum class SlotState { free, inFlight, writing };
+
+      struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        const uint8_t *mapped = nullptr;
+        SlotState state = SlotState::free;
+        // device frame that copied into it
+        uint64_t deviceFrame = 0;
+        uint64_t index = 0;
+      };
+
+      void createSlots();
+      void queueForWriting(Slot &slot);
+      void workerLoop();
+      // the bytes written or handed to the callback
+      uint64_t write(const Slot &slot);
+      uint64_t writeY4mFrame(const uint8_t *pixels);
+
+      HelloVulkanDevice &device;
+      VkExtent2D extent_;
+      VkFormat format;
+      FrameCaptureConfig config;
+      VkDeviceSize frameBytes;
+      // non-coherent memory has to be invalidated before the worker reads it
+      bool coherent = true;
+      std::vector<Slot> slots;
+      uint64_t nextIndex = 0;
+
+      std::ofstream file;
+      // y4m planes, reused between frames
+      std::vector<uint8_t> planes;
+
+      // slots and stats are shared with the worker
+      std::mutex mutex;
+      std::condition_variable workAvailable;
+      std::condition_variable workDone;
+      std::deque<Slot *> queue;
+      bool writing = false;
+      bool stopping = false;
+      FrameCaptureStats stats_;
+      std::thread worker;
+  };
+}
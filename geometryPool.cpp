@@ -0,0 +1,204 @@
+#include "geometryPool.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace helloVulkan {
+
+  RangeAllocator::RangeAllocator(uint32_t capacity) : capacity_{capacity} {
+    if (capacity > 0) {
+      freeRanges[0] = capacity;
+    }
+  }
+
+  uint32_t RangeAllocator::allocate(uint32_t count) {
+    if (count == 0) {
+      return 0;
+    }
+    for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range) {
+      if (range->second < count) {
+        continue;
+      }
+      uint32_t offset = range->first;
+      uint32_t remaining = range->second - count;
+      freeRanges.erase(range);
+      if (remaining > 0) {
+        freeRanges[offset + count] = remaining;
+      }
+      used_ += count;
+      return offset;
+    }
+    return INVALID_OFFSET;
+  }
+
+  void RangeAllocator::free(uint32_t offset, uint32_t count) {
+    if (count == 0) {
+      return;
+    }
+    used_ -= count;
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + count == next->first) {
+      count += next->second;
+      next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == offset) {
+        previous->second += count;
+        return;
+      }
+    }
+    freeRanges.emplace_hint(next, offset, count);
+  }
+
+  uint32_t RangeAllocator::largestFreeRange() const {
+    uint32_t largest = 0;
+    for (const auto &range : freeRanges) {
+      largest = std::max(largest, range.second);
+    }
+    return largest;
+  }
+
+  double RangeAllocator::fragmentation() const {
+    uint32_t free = capacity_ - used_;
+    if (free == 0) {
+      return 0.0;
+    }
+    return 1.0 - static_cast<double>(largestFreeRange()) / free;
+  }
+
+  GeometryPool::GeometryPool(
+        HelloVulkanDevice &device,
+        uint32_t vertexStride,
+        uint32_t vertexCapacity,
+        uint32_t indexCapacity) :
+        device{device},
+        vertexStride{vertexStride},
+        vertexRanges{vertexCapacity},
+        indexRanges{indexCapacity} {
+    VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(vertexStride) * vertexCapacity;
+    device.createBuffer(
+        vertexBufferSize,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        vertexBuffer,
+        vertexBufferMemory);
+    VkDeviceSize indexBufferSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity);
+    device.createBuffer(
+        indexBufferSize,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        indexBuffer,
+        indexBufferMemory);
+
+    void *data;
+    vkMapMemory(device.device(), vertexBufferMemory, 0, vertexBufferSize, 0, &data);
+    mappedVertices = static_cast<char *>(data);
+    vkMapMemory(device.device(), indexBufferMemory, 0, indexBufferSize, 0, &data);
+    mappedIndices = static_cast<uint32_t *>(data);
+  }
+
+  GeometryPool::~GeometryPool() {
+    // freeing memory unmaps it, the buffers go once the frames drawing from them have finished
+    device.deferDestroyBuffer(vertexBuffer, vertexBufferMemory);
+    device.deferDestroyBuffer(indexBuffer, indexBufferMemory);
+  }
+
+  GeometryRange GeometryPool::allocate(
+        const void *vertices,
+        uint32_t vertexCount,
+        const uint32_t *indices,
+        uint32_t indexCount) {
+    PROFILE_FUNCTION();
+    GeometryRange range = reserve(vertexCount, indexCount);
+    std::memcpy(vertexData(range), vertices, static_cast<size_t>(vertexCount) * vertexStride);
+    if (indexCount > 0) {
+      std::memcpy(indexData(range), indices, sizeof(uint32_t) * indexCount);
+    }
+    return range;
+  }
+
+  GeometryRange GeometryPool::reserve(uint32_t vertexCount, uint32_t indexCount) {
+    reclaimRetiredRanges();
+    GeometryRange range{};
+    range.firstVertex = vertexRanges.allocate(vertexCount);
+    if (range.firstVertex == RangeAllocator::INVALID_OFFSET) {
+      throw std::runtime_error(
+          "Geometry pool has no room for " + std::to_string(vertexCount) + " vertices");
+    }
+    range.vertexCount = vertexCount;
+    range.firstIndex = indexRanges.allocate(indexCount);
+    if (range.firstIndex == RangeAllocator::INVALID_OFFSET) {
+      vertexRanges.free(range.firstVertex, vertexCount);
+      throw std::runtime_error(
+          "Geometry pool has no room for " + std::to_string(indexCount) + " indices");
+    }
+    range.indexCount = indexCount;
+    liveRanges++;
+    return range;
+  }
+
+  void GeometryPool::release(const GeometryRange &range) {
+    vertexRanges.free(range.firstVertex, range.vertexCount);
+    indexRanges.free(range.firstIndex, range.indexCount);
+    liveRanges--;
+  }
+
+  void GeometryPool::releaseDeferred(const GeometryRange &range) {
+    retiredRanges.emplace_back(device.currentFrame(), range);
+    liveRanges--;
+  }
+
+  void GeometryPool::reclaimRetiredRanges() {
+    uint64_t completed = device.completedFrame();
+    while (!retiredRanges.empty() && retiredRanges.front().first <= completed) {
+      const GeometryRange &range = retiredRanges.front().second;
+      vertexRanges.free(range.firstVertex, range.vertexCount);
+      indexRanges.free(range.firstIndex, range.indexCount);
+      retiredRanges.pop_front();
+    }
+  }
+
+  void GeometryPool::bind(VkCommandBuffer commandBuffer) {
+    VkBuffer buffers[] = {vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  }
+
+  void GeometryPool::draw(VkCommandBuffer commandBuffer, const GeometryRange &range, uint32_t instanceCount) {
+    if (range.indexCount == 0) {
+      vkCmdDraw(commandBuffer, range.vertexCount, instanceCount, range.firstVertex, 0);
+      return;
+    }
+    // indices are relative to the mesh, the vertex offset moves them to where it lives in the pool
+    vkCmdDrawIndexed(
+        commandBuffer,
+        range.indexCount,
+        instanceCount,
+        range.firstIndex,
+        static_cast<int32_t>(range.firstVertex),
+        0);
+  }
+
+  GeometryPoolStats GeometryPool::stats() const {
+    GeometryPoolStats stats{};
+    stats.retiredRanges = static_cast<uint32_t>(retiredRanges.size());
+    stats.vertexCapacity = vertexRanges.capacity();
+    stats.verticesUsed = vertexRanges.used();
+    stats.indexCapacity = indexRanges.capacity();
+    stats.indicesUsed = indexRanges.used();
+    stats.liveRanges = liveRanges;
+    stats.vertexFreeRanges = vertexRanges.freeRangeCount();
+    stats.largestVertexFreeRange = vertexRanges.largestFreeRange();
+    stats.vertexFragmentation = vertexRanges.fragmentation();
+    stats.indexFreeRanges = indexRanges.freeRangeCount();
+    stats.largestIndexFreeRange = indexRanges.largestFreeRange();
+    stats.indexFragmentation = indexRanges.fragmentation();
+    return stats;
+  }
+}
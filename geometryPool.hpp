@@ -0,0 +1,125 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // First-fit free list over [0, capacity) in whatever unit the caller likes, adjacent free ranges
+  // are merged back together on free.
+  class RangeAllocator {
+    public:
+      static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+      explicit RangeAllocator(uint32_t capacity);
+
+      // INVALID_OFFSET when no free range is big enough
+      uint32_t allocate(uint32_t count);
+      void free(uint32_t offset, uint32_t count);
+
+      uint32_t capacity() const { return capacity_; }
+      uint32_t used() const { return used_; }
+      size_t freeRangeCount() const { return freeRanges.size(); }
+      uint32_t largestFreeRange() const;
+      // 0 when all the free space is one range, approaching 1 as it gets split into small pieces
+      double fragmentation() const;
+
+    private:
+      uint32_t capacity_;
+      uint32_t used_ = 0;
+      // offset -> count
+      std::map<uint32_t, uint32_t> freeRanges;
+  };
+
+  // Where a mesh lives in the pool. indexCount is 0 for meshes drawn without indices.
+  struct GeometryRange {
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+  };
+
+  struct GeometryPoolStats {
+    uint32_t vertexCapacity = 0;
+    uint32_t verticesUsed = 0;
+    uint32_t indexCapacity = 0;
+    uint32_t indicesUsed = 0;
+    uint32_t liveRanges = 0;
+    // released with releaseDeferred, still waiting on the frames that drew them
+    uint32_t retiredRanges = 0;
+    size_t vertexFreeRanges = 0;
+    uint32_t largestVertexFreeRange = 0;
+    double vertexFragmentation = 0.0;
+    size_t indexFreeRanges = 0;
+    uint32_t largestIndexFreeRange = 0;
+    double indexFragmentation = 0.0;
+  };
+
+  // All meshes share one vertex buffer and one 32 bit index buffer, so drawing any number of them
+  // needs a single bind and the draws differ only in their offsets. Both buffers are host visible
+  // and stay mapped, uploads are a memcpy. The vertex buffer is also a storage buffer so compute
+  // shaders can write meshes into it. Ranges have to be released only once the GPU has stopped
+  // using them.
+  class GeometryPool {
+    public:
+      static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 18;
+      static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 20;
+
+      GeometryPool(
+          HelloVulkanDevice &device,
+          uint32_t vertexStride,
+          uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+          uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+      ~GeometryPool();
+
+      GeometryPool(const GeometryPool &) = delete;
+      GeometryPool &operator=(const GeometryPool &) = delete;
+
+      // copies the data in, vertices are vertexStride bytes each. Throws when the pool is out of space.
+      GeometryRange allocate(
+          const void *vertices,
+          uint32_t vertexCount,
+          const uint32_t *indices,
+          uint32_t indexCount);
+      // space without any data, for generators writing straight into vertexData/indexData
+      GeometryRange reserve(uint32_t vertexCount, uint32_t indexCount);
+      void release(const GeometryRange &range);
+      // for ranges frames in flight may still draw, the space is reused once the device has
+      // retired the frame being recorded
+      void releaseDeferred(const GeometryRange &range);
+
+      void *vertexData(const GeometryRange &range) { return mappedVertices + static_cast<size_t>(range.firstVertex) * vertexStride; }
+      uint32_t *indexData(const GeometryRange &range) { return mappedIndices + range.firstIndex; }
+      VkBuffer getVertexBuffer() { return vertexBuffer; }
+      VkBuffer getIndexBuffer() { return indexBuffer; }
+      uint32_t getVertexStride() const { return vertexStride; }
+
+      void bind(VkCommandBuffer commandBuffer);
+      void draw(VkCommandBuffer commandBuffer, const GeometryRange &range, uint32_t instanceCount = 1);
+
+      GeometryPoolStats stats() const;
+
+    private:
+      void reclaimRetiredRanges();
+
+      HelloVulkanDevice &device;
+      uint32_t vertexStride;
+      RangeAllocator vertexRanges;
+      RangeAllocator indexRanges;
+      uint32_t liveRanges = 0;
+      // with the device frame each was released in, oldest first
+      std::deque<std::pair<uint64_t, GeometryRange>> retiredRanges;
+
+      VkBuffer vertexBuffer;
+      VkDeviceMemory vertexBufferMemory;
+      VkBuffer indexBuffer;
+      VkDeviceMemory indexBufferMemory;
+      char *mappedVertices = nullptr;
+      uint32_t *mappedIndices = nullptr;
+  };
+}
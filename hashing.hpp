@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace helloVulkan {
+
+  constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+  constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+  // FNV-1a, fine for cache keys, not for anything adversarial
+  inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+    }
+    return hash;
+  }
+
+  template <typename T>
+  uint64_t hashValue(const T &value, uint64_t seed = FNV_OFFSET_BASIS) {
+    return hashBytes(&value, sizeof(T), seed);
+  }
+
+  // for keys kept in full next to their hash, so a lookup can compare them instead of trusting it
+  inline void appendBytes(std::vector<uint8_t> &key, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    key.insert(key.end(), bytes, bytes + size);
+  }
+
+  template <typename T>
+  void appendValue(std::vector<uint8_t> &key, const T &value) {
+    appendBytes(key, &value, sizeof(T));
+  }
+}
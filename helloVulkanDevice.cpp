@@ -1,8 +1,12 @@
 #include "helloVulkanDevice.hpp"
+#include "logger.hpp"
 
 // std headers
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <fstream>
+#include <iterator>
 #include <set>
 #include <unordered_set>
 
@@ -14,7 +18,21 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageTypeFlagsEXT messageType,
     const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
     void *pUserData) {
-  std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+  // called on whichever thread made the offending call, often the render thread, so it mustn't
+  // wait on the console
+  LogSeverity severity = LogSeverity::verbose;
+  if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    severity = LogSeverity::error;
+  } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    severity = LogSeverity::warning;
+  } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+    severity = LogSeverity::info;
+  }
+  Logger::write(
+      severity,
+      "validation layer",
+      static_cast<uint32_t>(pCallbackData->messageIdNumber),
+      pCallbackData->pMessage);
 
   return VK_FALSE;
 }
@@ -47,17 +65,26 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-HelloVulkanDevice::HelloVulkanDevice(HelloVulkanWindow &window) : window{window} {
+HelloVulkanDevice::HelloVulkanDevice(HelloVulkanWindow &window, const std::string &devicePreference)
+    : window{window} {
   createInstance();
   setupDebugMessenger();
   createSurface();
-  pickPhysicalDevice();
+  pickPhysicalDevice(devicePreference);
   createLogicalDevice();
   createCommandPool();
+  createPipelineCache();
 }
 
 HelloVulkanDevice::~HelloVulkanDevice() {
+  // whatever is still waiting on a frame, the owners are gone and nothing will retire it
+  vkDeviceWaitIdle(device_);
+  runDestructions(UINT64_MAX);
+
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  vkDestroyCommandPool(device_, computeCommandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -86,6 +113,11 @@ void HelloVulkanDevice::createInstance() {
   createInfo.pApplicationInfo = &appInfo;
 
   auto extensions = getRequiredExtensions();
+  // optional, a 1.0 instance needs it to query VK_EXT_memory_budget
+  if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    physicalDeviceProperties2Enabled = true;
+  }
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -108,59 +140,195 @@ void HelloVulkanDevice::createInstance() {
   hasGflwRequiredInstanceExtensions();
 }
 
-void HelloVulkanDevice::pickPhysicalDevice() {
+void HelloVulkanDevice::pickPhysicalDevice(const std::string &devicePreference) {
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
   if (deviceCount == 0) {
     throw std::runtime_error("failed to find GPUs with Vulkan support!");
   }
-  std::cout << "Device count: " << deviceCount << std::endl;
+  LogLine{LogSeverity::info} << "Device count: " << deviceCount;
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-  for (const auto &device : devices) {
-    if (isDeviceSuitable(device)) {
-      physicalDevice = device;
-      break;
+  // hybrid machines list the integrated GPU and software rasterisers alongside the discrete one,
+  // so score them all instead of taking the first that works
+  std::vector<PhysicalDeviceInfo> infos;
+  for (size_t i = 0; i < devices.size(); i++) {
+    infos.push_back(queryPhysicalDeviceInfo(devices[i]));
+    LogLine{LogSeverity::info} << "  " << i << ": " << infos[i].name << " (" << physicalDeviceTypeName(infos[i].type)
+                               << ", score " << scorePhysicalDevice(infos[i]) << ")";
+  }
+
+  const char *environmentPreference = std::getenv("HELLO_VULKAN_DEVICE");
+  size_t selected = selectPhysicalDevice(
+      infos, environmentPreference != nullptr ? environmentPreference : devicePreference);
+  physicalDevice = devices[selected];
+  capabilities_ = DeviceCapabilities::from(infos[selected]);
+
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+}
+
+PhysicalDeviceInfo HelloVulkanDevice::queryPhysicalDeviceInfo(VkPhysicalDevice device) {
+  PhysicalDeviceInfo info{};
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  info.name = deviceProperties.deviceName;
+  info.type = deviceProperties.deviceType;
+  info.apiVersion = deviceProperties.apiVersion;
+  info.meetsRequirements = isDeviceSuitable(device);
+  vkGetPhysicalDeviceFeatures(device, &info.features);
+
+  if (physicalDeviceProperties2Enabled) {
+    auto getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &idProperties;
+    if (getPhysicalDeviceProperties2 != nullptr) {
+      getPhysicalDeviceProperties2(device, &properties2);
+      std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), info.uuid.begin());
     }
   }
 
-  if (physicalDevice == VK_NULL_HANDLE) {
-    throw std::runtime_error("failed to find a suitable GPU!");
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      info.deviceLocalBytes = std::max(info.deviceLocalBytes, memoryProperties.memoryHeaps[i].size);
+    }
   }
 
-  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-  std::cout << "physical device: " << properties.deviceName << std::endl;
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+  for (const auto &queueFamily : queueFamilies) {
+    if (queueFamily.queueCount == 0 || queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      continue;
+    }
+    if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+      info.dedicatedComputeQueue = true;
+    } else if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
+      info.dedicatedTransferQueue = true;
+    }
+  }
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+  for (const auto &extension : availableExtensions) {
+    info.extensions.push_back(extension.extensionName);
+  }
+  return info;
 }
 
 void HelloVulkanDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily, indices.presentFamily, indices.computeFamily};
 
-  float queuePriority = 1.0f;
+  float queuePriorities[] = {1.0f, 1.0f};
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo = {};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfo.queueCount = queueFamily == indices.computeFamily ? indices.computeQueueIndex + 1 : 1;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional, only used for the per frame pipeline statistics
+  deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  // optional, compressed textures are uploaded as they are so the formats have to be enabled
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+  deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+  // optional, VertexPulling puts a frame's draws in one indirect call, each with its index as its
+  // first instance
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+  // optional, lets cull mode, depth test/write and topology be set per command buffer instead of
+  // baking a pipeline for each combination. HELLO_VULKAN_DISABLE_EXTENDED_DYNAMIC_STATE=1 turns it
+  // off to compare against the baked path.
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  const char *disableDynamicState = std::getenv("HELLO_VULKAN_DISABLE_EXTENDED_DYNAMIC_STATE");
+  bool useExtendedDynamicState =
+      (disableDynamicState == nullptr || std::string{disableDynamicState} != "1") &&
+      isDeviceExtensionAvailable(physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  // the feature is required to be supported whenever the extension is advertised
+  extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+  if (useExtendedDynamicState) {
+    enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  }
+
+  // optional, pipelines are built against attachment formats instead of a render pass so the swap
+  // chain can be recreated without touching them. A 1.0 device needs the extensions it was promoted
+  // on top of. HELLO_VULKAN_DISABLE_DYNAMIC_RENDERING=1 keeps the render pass path to compare.
+  const std::vector<const char *> dynamicRenderingExtensions = {
+      VK_KHR_MULTIVIEW_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE_2_EXTENSION_NAME,
+      VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+      VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+      VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME};
+  const char *disableDynamicRendering = std::getenv("HELLO_VULKAN_DISABLE_DYNAMIC_RENDERING");
+  bool useDynamicRendering =
+      (disableDynamicRendering == nullptr || std::string{disableDynamicRendering} != "1") &&
+      physicalDeviceProperties2Enabled &&
+      std::all_of(
+          dynamicRenderingExtensions.begin(),
+          dynamicRenderingExtensions.end(),
+          [this](const char *extension) { return isDeviceExtensionAvailable(physicalDevice, extension); });
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  // also required whenever the extension is advertised
+  dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+  if (useDynamicRendering) {
+    enabledExtensions.insert(
+        enabledExtensions.end(), dynamicRenderingExtensions.begin(), dynamicRenderingExtensions.end());
+  }
+
+  // optional, lets texture streaming size its budget from what the driver reports as free
+  bool useMemoryBudget = physicalDeviceProperties2Enabled &&
+      isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (useMemoryBudget) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  void *featureChain = nullptr;
+  if (useExtendedDynamicState) {
+    extendedDynamicStateFeatures.pNext = featureChain;
+    featureChain = &extendedDynamicStateFeatures;
+  }
+  if (useDynamicRendering) {
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
+  createInfo.pNext = featureChain;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -174,9 +342,56 @@ void HelloVulkanDevice::createLogicalDevice() {
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device_) != VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
+  enabledFeatures_ = deviceFeatures;
+  if (useExtendedDynamicState) {
+    loadExtendedDynamicStateFunctions();
+  }
+  if (useDynamicRendering) {
+    loadDynamicRenderingFunctions();
+  }
+  if (useMemoryBudget) {
+    getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+  }
+  capabilities_.extendedDynamicState = extendedDynamicState_.enabled;
+  capabilities_.dynamicRendering = dynamicRendering_.enabled;
+  capabilities_.memoryBudget = useMemoryBudget;
+  LogLine{LogSeverity::info} << capabilities_.describe();
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.computeFamily, indices.computeQueueIndex, &computeQueue_);
+}
+
+void HelloVulkanDevice::loadExtendedDynamicStateFunctions() {
+  ExtendedDynamicStateFunctions functions{};
+  functions.cmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+      vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT"));
+  functions.cmdSetDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(
+      vkGetDeviceProcAddr(device_, "vkCmdSetDepthTestEnableEXT"));
+  functions.cmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+      vkGetDeviceProcAddr(device_, "vkCmdSetDepthWriteEnableEXT"));
+  functions.cmdSetPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+      vkGetDeviceProcAddr(device_, "vkCmdSetPrimitiveTopologyEXT"));
+  functions.enabled = functions.cmdSetCullMode != nullptr &&
+      functions.cmdSetDepthTestEnable != nullptr &&
+      functions.cmdSetDepthWriteEnable != nullptr &&
+      functions.cmdSetPrimitiveTopology != nullptr;
+  if (functions.enabled) {
+    extendedDynamicState_ = functions;
+  }
+}
+
+void HelloVulkanDevice::loadDynamicRenderingFunctions() {
+  DynamicRenderingFunctions functions{};
+  functions.cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+      vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+  functions.cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+      vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+  functions.enabled = functions.cmdBeginRendering != nullptr && functions.cmdEndRendering != nullptr;
+  if (functions.enabled) {
+    dynamicRendering_ = functions;
+  }
 }
 
 void HelloVulkanDevice::createCommandPool() {
@@ -191,6 +406,63 @@ void HelloVulkanDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute command pool!");
+  }
+}
+
+uint32_t HelloVulkanDevice::timestampValidBits(uint32_t queueFamily) {
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+  return queueFamily < queueFamilyCount ? queueFamilies[queueFamily].timestampValidBits : 0;
+}
+
+void HelloVulkanDevice::createPipelineCache() {
+  if (const char *path = std::getenv("HELLO_VULKAN_PIPELINE_CACHE")) {
+    pipelineCachePath = path;
+  }
+
+  std::ifstream file{pipelineCachePath, std::ios::binary};
+  std::vector<char> cacheData{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+  // VkPipelineCacheHeaderVersionOne: header size, header version, vendor id, device id, cache uuid.
+  // Drivers should reject a cache from another device themselves, but not all of them do.
+  bool cacheMatchesDevice = cacheData.size() >= 16 + VK_UUID_SIZE;
+  if (cacheMatchesDevice) {
+    uint32_t header[4];
+    memcpy(header, cacheData.data(), sizeof(header));
+    cacheMatchesDevice = header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                         header[2] == properties.vendorID && header[3] == properties.deviceID &&
+                         memcmp(cacheData.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = cacheMatchesDevice ? cacheData.size() : 0;
+  cacheInfo.pInitialData = cacheMatchesDevice ? cacheData.data() : nullptr;
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void HelloVulkanDevice::savePipelineCache() {
+  size_t cacheSize = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &cacheSize, nullptr) != VK_SUCCESS) {
+    return;
+  }
+  std::vector<char> cacheData(cacheSize);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &cacheSize, cacheData.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  std::ofstream file{pipelineCachePath, std::ios::binary | std::ios::trunc};
+  file.write(cacheData.data(), static_cast<std::streamsize>(cacheSize));
 }
 
 void HelloVulkanDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -219,6 +491,12 @@ void HelloVulkanDevice::populateDebugMessengerCreateInfo(
   createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
   createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
                                VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+  // the layers' info messages are mostly the loader narrating itself, only asked for along with
+  // everything else at HELLO_VULKAN_LOG_LEVEL=verbose
+  if (Logger::enabled(LogSeverity::verbose)) {
+    createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+                                  VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+  }
   createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
                            VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
                            VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
@@ -280,17 +558,17 @@ void HelloVulkanDevice::hasGflwRequiredInstanceExtensions() {
   std::vector<VkExtensionProperties> extensions(extensionCount);
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-  std::cout << "available extensions:" << std::endl;
+  LogLine{LogSeverity::verbose} << "available extensions:";
   std::unordered_set<std::string> available;
   for (const auto &extension : extensions) {
-    std::cout << "\t" << extension.extensionName << std::endl;
+    LogLine{LogSeverity::verbose} << "\t" << extension.extensionName;
     available.insert(extension.extensionName);
   }
 
-  std::cout << "required extensions:" << std::endl;
+  LogLine{LogSeverity::verbose} << "required extensions:";
   auto requiredExtensions = getRequiredExtensions();
   for (const auto &required : requiredExtensions) {
-    std::cout << "\t" << required << std::endl;
+    LogLine{LogSeverity::verbose} << "\t" << required;
     if (available.find(required) == available.end()) {
       throw std::runtime_error("Missing required glfw extension");
     }
@@ -317,6 +595,39 @@ bool HelloVulkanDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool HelloVulkanDevice::isInstanceExtensionAvailable(const char *extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HelloVulkanDevice::isDeviceExtensionAvailable(
+    VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (std::strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices HelloVulkanDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -345,6 +656,27 @@ QueueFamilyIndices HelloVulkanDevice::findQueueFamilies(VkPhysicalDevice device)
     i++;
   }
 
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const auto &queueFamily = queueFamilies[family];
+    if (queueFamily.queueCount == 0 || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+      continue;
+    }
+    bool dedicated = !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    if (dedicated || !indices.computeFamilyHasValue) {
+      indices.computeFamily = family;
+      indices.computeFamilyHasValue = true;
+    }
+    if (dedicated) {
+      break;
+    }
+  }
+  // without a dedicated family a second queue still lets the driver overlap the work
+  if (indices.computeFamilyHasValue && indices.graphicsFamilyHasValue &&
+      indices.computeFamily == indices.graphicsFamily &&
+      queueFamilies[indices.graphicsFamily].queueCount > 1) {
+    indices.computeQueueIndex = 1;
+  }
+
   return indices;
 }
 
@@ -390,6 +722,12 @@ VkFormat HelloVulkanDevice::findSupportedFormat(
   throw std::runtime_error("failed to find supported format!");
 }
 
+VkFormatProperties HelloVulkanDevice::getFormatProperties(VkFormat format) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  return props;
+}
+
 uint32_t HelloVulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
   VkPhysicalDeviceMemoryProperties memProperties;
   vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -403,6 +741,18 @@ uint32_t HelloVulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryProperty
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool HelloVulkanDevice::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void HelloVulkanDevice::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
@@ -422,14 +772,7 @@ void HelloVulkanDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
+  bufferMemory = allocateMemory(memRequirements, properties);
 
   vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
@@ -464,6 +807,8 @@ void HelloVulkanDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkQueueWaitIdle(graphicsQueue_);
 
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+  // every frame submitted so far has finished along with it
+  retireFrame(currentFrame_.load() - 1);
 }
 
 void HelloVulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -517,18 +862,128 @@ void HelloVulkanDevice::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
+  imageMemory = allocateMemory(memRequirements, properties);
+
+  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
+  }
+}
+
+VkDeviceMemory HelloVulkanDevice::allocateMemory(
+    const VkMemoryRequirements &memRequirements, VkMemoryPropertyFlags properties) {
   VkMemoryAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
   allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory!");
   }
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+  memoryAllocationSizes[memory] = memRequirements.size;
+  memoryAllocationCount_++;
+  liveMemoryBytes_ += memRequirements.size;
+  peakMemoryBytes_ = std::max(peakMemoryBytes_, liveMemoryBytes_);
+  return memory;
+}
+
+void HelloVulkanDevice::freeMemory(VkDeviceMemory memory) {
+  auto allocation = memoryAllocationSizes.find(memory);
+  if (allocation != memoryAllocationSizes.end()) {
+    liveMemoryBytes_ -= allocation->second;
+    memoryAllocationSizes.erase(allocation);
+  }
+  vkFreeMemory(device_, memory, nullptr);
+}
+
+VkDeviceSize HelloVulkanDevice::allocationSize(VkDeviceMemory memory) {
+  auto allocation = memoryAllocationSizes.find(memory);
+  return allocation == memoryAllocationSizes.end() ? 0 : allocation->second;
+}
+
+void HelloVulkanDevice::retireFrame(uint64_t frame) {
+  if (frame <= completedFrame_.load()) {
+    return;
+  }
+  completedFrame_.store(frame);
+  runDestructions(frame);
+}
+
+void HelloVulkanDevice::runDestructions(uint64_t upToFrame) {
+  std::vector<std::function<void()>> ready;
+  {
+    std::lock_guard<std::mutex> lock{destructionMutex};
+    // frames only go up, so everything that's ready is at the front
+    while (!pendingDestructions.empty() && pendingDestructions.front().first <= upToFrame) {
+      ready.push_back(std::move(pendingDestructions.front().second));
+      pendingDestructions.pop_front();
+    }
+  }
+  // outside the lock, a destruction may defer another one
+  for (std::function<void()> &destroy : ready) {
+    destroy();
+  }
+}
+
+void HelloVulkanDevice::deferDestruction(std::function<void()> destroy) {
+  std::lock_guard<std::mutex> lock{destructionMutex};
+  pendingDestructions.emplace_back(currentFrame_.load(), std::move(destroy));
+  deferredDestructionCount_++;
+}
+
+void HelloVulkanDevice::deferDestroyBuffer(VkBuffer buffer, VkDeviceMemory memory) {
+  deferDestruction([this, buffer, memory] {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    if (memory != VK_NULL_HANDLE) {
+      freeMemory(memory);
+    }
+  });
+}
+
+void HelloVulkanDevice::deferDestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory) {
+  deferDestruction([this, image, view, memory] {
+    if (view != VK_NULL_HANDLE) {
+      vkDestroyImageView(device_, view, nullptr);
+    }
+    vkDestroyImage(device_, image, nullptr);
+    if (memory != VK_NULL_HANDLE) {
+      freeMemory(memory);
+    }
+  });
+}
+
+size_t HelloVulkanDevice::pendingDestructionCount() {
+  std::lock_guard<std::mutex> lock{destructionMutex};
+  return pendingDestructions.size();
+}
+
+uint64_t HelloVulkanDevice::deferredDestructionCount() {
+  std::lock_guard<std::mutex> lock{destructionMutex};
+  return deferredDestructionCount_;
+}
+
+MemoryBudget HelloVulkanDevice::queryMemoryBudget() {
+  MemoryBudget budget{};
+  if (getPhysicalDeviceMemoryProperties2 == nullptr) {
+    return budget;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+  memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  memoryProperties.pNext = &budgetProperties;
+  getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+  for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      budget.deviceLocalBudget += budgetProperties.heapBudget[i];
+      budget.deviceLocalUsage += budgetProperties.heapUsage[i];
+    }
   }
+  budget.available = true;
+  return budget;
 }
 
 }  // namespace lve
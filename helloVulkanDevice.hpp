@@ -1,9 +1,17 @@
 #pragma once
 
 #include "helloVulkanWindow.hpp"
+#include "physicalDeviceSelection.hpp"
 
 // std lib headers
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace helloVulkan {
@@ -17,11 +25,41 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // a family without graphics when there is one so compute can overlap rendering, otherwise the
+  // first family that can do compute
+  uint32_t computeFamily;
+  // 1 when compute shares the graphics family and it has a second queue to spare, 0 otherwise
+  uint32_t computeQueueIndex = 0;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool computeFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// VK_EXT_extended_dynamic_state entry points, all null unless the extension was enabled
+struct ExtendedDynamicStateFunctions {
+  bool enabled = false;
+  PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+};
+
+// VK_KHR_dynamic_rendering entry points, all null unless the extension was enabled
+struct DynamicRenderingFunctions {
+  bool enabled = false;
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+};
+
+// Device local heaps summed together. VK_EXT_memory_budget numbers cover the whole process, not
+// just what went through allocateMemory.
+struct MemoryBudget {
+  bool available = false;
+  VkDeviceSize deviceLocalBudget = 0;
+  VkDeviceSize deviceLocalUsage = 0;
+};
+
 class HelloVulkanDevice {
  public:
 #ifdef NDEBUG
@@ -30,7 +68,9 @@ class HelloVulkanDevice {
   const bool enableValidationLayers = true;
 #endif
 
-  HelloVulkanDevice(HelloVulkanWindow &window);
+  // devicePreference picks the physical device by index, UUID or name, see selectPhysicalDevice.
+  // HELLO_VULKAN_DEVICE overrides it, empty picks the highest scoring device.
+  HelloVulkanDevice(HelloVulkanWindow &window, const std::string &devicePreference = "");
   ~HelloVulkanDevice();
 
   // Not copyable or movable
@@ -40,16 +80,30 @@ class HelloVulkanDevice {
   HelloVulkanDevice &operator=(HelloVulkanDevice &&) = delete;
 
   VkCommandPool getCommandPool() { return commandPool; }
+  // for command buffers submitted to computeQueue, they can be reset individually
+  VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // the graphics queue itself when the device has no other queue that can do compute
+  VkQueue computeQueue() { return computeQueue_; }
+  bool hasAsyncCompute() { return computeQueue_ != graphicsQueue_; }
+  // 0 when the family can't write timestamps
+  uint32_t timestampValidBits(uint32_t queueFamily);
+  const VkPhysicalDeviceFeatures &enabledFeatures() { return enabledFeatures_; }
+  const ExtendedDynamicStateFunctions &extendedDynamicState() { return extendedDynamicState_; }
+  const DynamicRenderingFunctions &dynamicRendering() { return dynamicRendering_; }
+  const DeviceCapabilities &capabilities() { return capabilities_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+  VkFormatProperties getFormatProperties(VkFormat format);
 
   // Buffer Helper Functions
   void createBuffer(
@@ -70,24 +124,63 @@ class HelloVulkanDevice {
       VkImage &image,
       VkDeviceMemory &imageMemory);
 
+  // Memory Helper Functions, all device memory should go through these so the totals are accurate
+  VkDeviceMemory allocateMemory(
+      const VkMemoryRequirements &memRequirements, VkMemoryPropertyFlags properties);
+  void freeMemory(VkDeviceMemory memory);
+  uint64_t memoryAllocationCount() { return memoryAllocationCount_; }
+  size_t liveMemoryAllocationCount() { return memoryAllocationSizes.size(); }
+  VkDeviceSize liveMemoryBytes() { return liveMemoryBytes_; }
+  VkDeviceSize peakMemoryBytes() { return peakMemoryBytes_; }
+  // 0 for memory that didn't come from allocateMemory
+  VkDeviceSize allocationSize(VkDeviceMemory memory);
+  // unavailable unless VK_EXT_memory_budget could be enabled
+  MemoryBudget queryMemoryBudget();
+
+  // Frame serials for deferred destruction, starting at 1. Whoever submits frames calls
+  // submitFrame() with each submission and retireFrame() once that submission's fence has
+  // signalled, e.g. HelloVulkanSwapChain.
+  uint64_t currentFrame() { return currentFrame_.load(); }
+  uint64_t completedFrame() { return completedFrame_.load(); }
+  // the serial of the frame being submitted, later work belongs to the next one
+  uint64_t submitFrame() { return currentFrame_.fetch_add(1); }
+  // everything up to and including frame has finished on the GPU, runs what was waiting on it
+  void retireFrame(uint64_t frame);
+
+  // Runs destroy once the GPU is done with the frame being recorded, so objects can be released
+  // while earlier frames may still use them without waiting for the device to go idle.
+  // Safe to call from any thread.
+  void deferDestruction(std::function<void()> destroy);
+  void deferDestroyBuffer(VkBuffer buffer, VkDeviceMemory memory);
+  void deferDestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory);
+  size_t pendingDestructionCount();
+  uint64_t deferredDestructionCount();
+
   VkPhysicalDeviceProperties properties;
 
  private:
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
-  void pickPhysicalDevice();
+  void pickPhysicalDevice(const std::string &devicePreference);
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
+  PhysicalDeviceInfo queryPhysicalDeviceInfo(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
+  bool isInstanceExtensionAvailable(const char *extensionName);
+  void loadExtendedDynamicStateFunctions();
+  void loadDynamicRenderingFunctions();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -95,11 +188,35 @@ class HelloVulkanDevice {
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   HelloVulkanWindow &window;
   VkCommandPool commandPool;
+  VkCommandPool computeCommandPool;
 
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue computeQueue_;
+  VkPhysicalDeviceFeatures enabledFeatures_{};
+  ExtendedDynamicStateFunctions extendedDynamicState_;
+  DynamicRenderingFunctions dynamicRendering_;
+  DeviceCapabilities capabilities_;
+  bool physicalDeviceProperties2Enabled = false;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+  VkPipelineCache pipelineCache_;
+  std::string pipelineCachePath = "pipelineCache.bin";
+
+  std::unordered_map<VkDeviceMemory, VkDeviceSize> memoryAllocationSizes;
+  uint64_t memoryAllocationCount_ = 0;
+  VkDeviceSize liveMemoryBytes_ = 0;
+  VkDeviceSize peakMemoryBytes_ = 0;
+
+  void runDestructions(uint64_t upToFrame);
+
+  std::atomic<uint64_t> currentFrame_{1};
+  std::atomic<uint64_t> completedFrame_{0};
+  // oldest first, with the frame that has to complete before each one runs
+  std::mutex destructionMutex;
+  std::deque<std::pair<uint64_t, std::function<void()>>> pendingDestructions;
+  uint64_t deferredDestructionCount_ = 0;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -1,9 +1,9 @@
 #include "helloVulkanPipeline.hpp"
 #include "model.hpp"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
 #include <stdexcept>
 #include <vector>
 #include <iostream>
@@ -11,38 +11,39 @@
 
 namespace helloVulkan {
 
+  uint64_t Pipeline::createdCount_ = 0;
+
   Pipeline::Pipeline(
         HelloVulkanDevice& device,
         const std::string& vertFilePath,
         const std::string& fragFilePath,
         const PipelineConfigInfo& config) :
         helloVulkanDevice{device} {
-    createGraphicsPipeline(vertFilePath, fragFilePath, config);
+    createGraphicsPipeline(ShaderLibrary::load(vertFilePath), ShaderLibrary::load(fragFilePath), config);
   }
 
-  Pipeline::~Pipeline() {
-    vkDestroyPipeline(helloVulkanDevice.device(), graphicsPipeline, NULL);
-    vkDestroyShaderModule(helloVulkanDevice.device(), vertShaderModule, NULL);
-    vkDestroyShaderModule(helloVulkanDevice.device(), fragShaderModule, NULL);
+  Pipeline::Pipeline(
+        HelloVulkanDevice& device,
+        ShaderCode vertCode,
+        ShaderCode fragCode,
+        const PipelineConfigInfo& config) :
+        helloVulkanDevice{device} {
+    createGraphicsPipeline(vertCode, fragCode, config);
   }
 
-  std::vector<char> Pipeline::readFile(
-        const std::string& path) {
-    std::ifstream file{path, std::ios::ate | std::ios::binary};
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
+  Pipeline::~Pipeline() {
+    // frames in flight may still be bound to it
+    VkDevice device = helloVulkanDevice.device();
+    VkPipeline pipeline = graphicsPipeline;
+    helloVulkanDevice.deferDestruction([device, pipeline] { vkDestroyPipeline(device, pipeline, NULL); });
   }
 
   void Pipeline::createGraphicsPipeline(
-        const std::string& vertFilePath,
-        const std::string& fragFilePath, 
+        ShaderCode vertCode,
+        ShaderCode fragCode,
         const PipelineConfigInfo& pipelineConfigInfo) {
-    auto vertCode = readFile(vertFilePath);
-    auto fragCode = readFile(fragFilePath);
+    VkShaderModule vertShaderModule;
+    VkShaderModule fragShaderModule;
     createShaderModule(vertCode, &vertShaderModule);
     createShaderModule(fragCode, &fragShaderModule);
 
@@ -55,6 +56,11 @@ namespace helloVulkan {
     shaderStages[0].pNext = nullptr;
     shaderStages[0].pSpecializationInfo = nullptr;
 
+    VkSpecializationInfo vertSpecializationInfo = pipelineConfigInfo.vertexSpecialization.info();
+    if (!pipelineConfigInfo.vertexSpecialization.empty()) {
+      shaderStages[0].pSpecializationInfo = &vertSpecializationInfo;
+    }
+
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     shaderStages[1].module = fragShaderModule;
@@ -62,9 +68,14 @@ namespace helloVulkan {
     shaderStages[1].flags = 0;
     shaderStages[1].pNext = nullptr;
     shaderStages[1].pSpecializationInfo = nullptr;
+
+    VkSpecializationInfo fragSpecializationInfo = pipelineConfigInfo.fragmentSpecialization.info();
+    if (!pipelineConfigInfo.fragmentSpecialization.empty()) {
+      shaderStages[1].pSpecializationInfo = &fragSpecializationInfo;
+    }
     
-    auto bindingDescriptions = Model::Vertex::getBindingDescriptions();
-    auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+    auto &bindingDescriptions = pipelineConfigInfo.bindingDescriptions;
+    auto &attributeDescriptions = pipelineConfigInfo.attributeDescriptions;
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -75,9 +86,23 @@ namespace helloVulkan {
     VkPipelineViewportStateCreateInfo viewportInfo{};
     viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportInfo.viewportCount = 1;
-    viewportInfo.pViewports = &pipelineConfigInfo.viewport;
+    viewportInfo.pViewports = nullptr;
     viewportInfo.scissorCount = 1;
-    viewportInfo.pScissors = &pipelineConfigInfo.scissor;
+    viewportInfo.pScissors = nullptr;
+
+    auto &dynamicStateEnables = pipelineConfigInfo.dynamicStateEnables;
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
+    dynamicStateInfo.pDynamicStates = dynamicStateEnables.data();
+    extendedDynamicState = std::find(
+        dynamicStateEnables.begin(),
+        dynamicStateEnables.end(),
+        VK_DYNAMIC_STATE_CULL_MODE_EXT) != dynamicStateEnables.end();
+
+    // the config is passed around by value, so point the blend state at this copy's attachment
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo = pipelineConfigInfo.colorBlendInfo;
+    colorBlendInfo.pAttachments = &pipelineConfigInfo.colorBlendAttachment;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -88,31 +113,46 @@ namespace helloVulkan {
     pipelineInfo.pViewportState = &viewportInfo;
     pipelineInfo.pRasterizationState = &pipelineConfigInfo.rasterizationInfo;
     pipelineInfo.pMultisampleState = &pipelineConfigInfo.multisampleInfo;
-    pipelineInfo.pColorBlendState = &pipelineConfigInfo.colorBlendInfo;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
     pipelineInfo.pDepthStencilState = &pipelineConfigInfo.depthStencilInfo;
-    pipelineInfo.pDynamicState = NULL;
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
 
     pipelineInfo.layout = pipelineConfigInfo.pipelineLayout;
     pipelineInfo.renderPass = pipelineConfigInfo.renderPass;
     pipelineInfo.subpass = pipelineConfigInfo.subpass;
 
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    if (pipelineConfigInfo.renderPass == VK_NULL_HANDLE) {
+      renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+      renderingInfo.colorAttachmentCount = 1;
+      renderingInfo.pColorAttachmentFormats = &pipelineConfigInfo.colorAttachmentFormat;
+      renderingInfo.depthAttachmentFormat = pipelineConfigInfo.depthAttachmentFormat;
+      renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+      pipelineInfo.pNext = &renderingInfo;
+    }
+
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(helloVulkanDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphicsPipeline)!= VK_SUCCESS) {
+    VkResult result = vkCreateGraphicsPipelines(
+        helloVulkanDevice.device(), helloVulkanDevice.pipelineCache(), 1, &pipelineInfo, NULL, &graphicsPipeline);
+    // the pipeline doesn't need the modules once it exists, no point keeping them around
+    vkDestroyShaderModule(helloVulkanDevice.device(), vertShaderModule, NULL);
+    vkDestroyShaderModule(helloVulkanDevice.device(), fragShaderModule, NULL);
+    if (result != VK_SUCCESS) {
       throw std::runtime_error("Failed to create graphics pipeline");
     };
+    createdCount_++;
  }
 
   void Pipeline::createShaderModule(
-        const std::vector<char>& code,
+        ShaderCode code,
         VkShaderModule* shaderModule) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = 
           VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = 
-          reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = code.sizeInBytes();
+    createInfo.pCode = code.words;
 
     vkCreateShaderModule(
         helloVulkanDevice.device(),
@@ -121,27 +161,81 @@ namespace helloVulkan {
         shaderModule);
   }
 
+  VkSpecializationInfo ShaderSpecialization::info() const {
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specializationInfo.pMapEntries = entries.data();
+    specializationInfo.dataSize = data.size();
+    specializationInfo.pData = data.data();
+    return specializationInfo;
+  }
+
+  void ShaderSpecialization::appendKey(std::vector<uint8_t> &key) const {
+    appendValue(key, entries.size());
+    for (const auto &entry : entries) {
+      appendValue(key, entry.constantID);
+      appendValue(key, entry.size);
+    }
+    appendValue(key, data.size());
+    appendBytes(key, data.data(), data.size());
+  }
+
   void Pipeline::bind(VkCommandBuffer commandBuffer) {
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
   }
 
-  PipelineConfigInfo Pipeline::defaultPipelineConfig(
-        uint32_t width,
-        uint32_t height) {
+  void Pipeline::setDynamicState(
+        VkCommandBuffer commandBuffer,
+        VkExtent2D extent,
+        const DynamicRenderState &renderState) {
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, extent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (!extendedDynamicState) {
+      return;
+    }
+    const ExtendedDynamicStateFunctions &functions = helloVulkanDevice.extendedDynamicState();
+    functions.cmdSetCullMode(commandBuffer, renderState.cullMode);
+    functions.cmdSetDepthTestEnable(commandBuffer, renderState.depthTestEnable);
+    functions.cmdSetDepthWriteEnable(commandBuffer, renderState.depthWriteEnable);
+    functions.cmdSetPrimitiveTopology(commandBuffer, renderState.topology);
+  }
+
+  void Pipeline::applyRenderState(
+        HelloVulkanDevice &device,
+        PipelineConfigInfo &config,
+        const DynamicRenderState &renderState) {
+    if (device.extendedDynamicState().enabled) {
+      config.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+      config.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+      config.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT);
+      config.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+      return;
+    }
+    config.rasterizationInfo.cullMode = renderState.cullMode;
+    config.depthStencilInfo.depthTestEnable = renderState.depthTestEnable;
+    config.depthStencilInfo.depthWriteEnable = renderState.depthWriteEnable;
+    config.inputAssemblyInfo.topology = renderState.topology;
+  }
+
+  PipelineConfigInfo Pipeline::defaultPipelineConfig() {
     PipelineConfigInfo config{};
+    config.bindingDescriptions = Model::Vertex::getBindingDescriptions();
+    config.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+    config.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
     config.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     config.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     config.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
-    config.viewport.x = 0.0f;
-    config.viewport.y = 0.0f;
-    config.viewport.width = static_cast<float>(width);
-    config.viewport.height = static_cast<float>(height);
-    config.viewport.minDepth = 0.0f;
-    config.viewport.maxDepth = 1.0f;
- 
-    config.scissor.offset = {0, 0};
-    config.scissor.extent = {width, height};
- 
+
     config.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     config.rasterizationInfo.depthClampEnable = VK_FALSE;
     config.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
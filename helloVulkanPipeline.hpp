@@ -1,17 +1,88 @@
 #pragma once
 
+#include "hashing.hpp"
 #include "helloVulkanDevice.hpp"
+#include "shaderLibrary.hpp"
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace helloVulkan {
-  
-    struct PipelineConfigInfo {
-    VkViewport viewport;
-    VkRect2D scissor;
-    VkPipelineViewportStateCreateInfo viewportInfo;
+
+  // Describes how the fields of a plain struct map onto a shader's specialization constants.
+  // Specialize it for the struct, listing the members in constant_id order:
+  //
+  //   struct ColourConstants { uint32_t colourMode; VkBool32 gammaCorrect; };
+  //   template <> struct SpecializationLayout<ColourConstants> {
+  //     static constexpr auto members =
+  //         std::make_tuple(&ColourConstants::colourMode, &ColourConstants::gammaCorrect);
+  //   };
+  template <typename Constants>
+  struct SpecializationLayout;
+
+  // The map entries and data for one shader stage, built from a struct with a SpecializationLayout.
+  class ShaderSpecialization {
+    public:
+      template <typename Constants>
+      static ShaderSpecialization from(const Constants &constants) {
+        ShaderSpecialization specialization{};
+        uint32_t constantId = 0;
+        std::apply(
+            [&](auto... members) { (specialization.addConstant(constantId++, constants, members), ...); },
+            SpecializationLayout<Constants>::members);
+        return specialization;
+      }
+
+      bool empty() const { return entries.empty(); }
+      // points into this object, keep it alive until the pipeline has been created
+      VkSpecializationInfo info() const;
+      // the map entries and data, for PipelineRegistry's key, which is what tells variants apart
+      void appendKey(std::vector<uint8_t> &key) const;
+
+    private:
+      template <typename Constants, typename Member>
+      void addConstant(uint32_t constantId, const Constants &constants, Member Constants::*member) {
+        static_assert(
+            std::is_arithmetic<Member>::value && !std::is_same<Member, bool>::value,
+            "specialization constants must be 32 or 64 bit scalars, use VkBool32 for booleans");
+        static_assert(sizeof(Member) == 4 || sizeof(Member) == 8, "unsupported specialization constant size");
+
+        // constants are packed in constant_id order, so padding in the struct never reaches the
+        // shader or the registry key
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(data.size());
+        entry.size = sizeof(Member);
+        entries.push_back(entry);
+
+        data.resize(data.size() + sizeof(Member));
+        std::memcpy(data.data() + entry.offset, &(constants.*member), sizeof(Member));
+      }
+
+      std::vector<VkSpecializationMapEntry> entries;
+      std::vector<uint8_t> data;
+  };
+
+  // State that the pipelines leave dynamic and that is set per command buffer. The values match
+  // what defaultPipelineConfig bakes in when the device doesn't support extended dynamic state.
+  struct DynamicRenderState {
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkBool32 depthTestEnable = VK_TRUE;
+    VkBool32 depthWriteEnable = VK_TRUE;
+    // must stay in the same topology class (points, lines or triangles) as the pipeline was built with
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  };
+
+  struct PipelineConfigInfo {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    // viewport and scissor are always dynamic so a resize doesn't need new pipelines
+    std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
     VkPipelineRasterizationStateCreateInfo rasterizationInfo;
     VkPipelineMultisampleStateCreateInfo multisampleInfo;
@@ -21,36 +92,57 @@ namespace helloVulkan {
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
+    // with no render pass the pipeline is built for dynamic rendering into attachments of these formats
+    VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    ShaderSpecialization vertexSpecialization;
+    ShaderSpecialization fragmentSpecialization;
   };
   
   class Pipeline {
     public:
+      // the paths are looked up in the ShaderLibrary
       Pipeline(
           HelloVulkanDevice& device,
           const std::string& vertFilePath,
           const std::string& fragFilePath,
           const PipelineConfigInfo& config);
+      Pipeline(
+          HelloVulkanDevice& device,
+          ShaderCode vertCode,
+          ShaderCode fragCode,
+          const PipelineConfigInfo& config);
       ~Pipeline();
       Pipeline(const Pipeline&) = delete;
       void operator=(const Pipeline&) = delete;
       void bind(VkCommandBuffer commandBuffer);
-      static PipelineConfigInfo defaultPipelineConfig(
-          uint32_t width,
-          uint32_t height);
+      // sets the viewport and scissor, plus the extended dynamic state if the pipeline was built with it
+      void setDynamicState(
+          VkCommandBuffer commandBuffer,
+          VkExtent2D extent,
+          const DynamicRenderState &renderState);
+      // number of VkPipelines created since startup, to keep an eye on rebuilds
+      static uint64_t createdCount() { return createdCount_; }
+      static PipelineConfigInfo defaultPipelineConfig();
+      // moves cull mode, depth test/write and topology into the dynamic state when the device
+      // supports VK_EXT_extended_dynamic_state, otherwise bakes renderState into the config
+      static void applyRenderState(
+          HelloVulkanDevice &device,
+          PipelineConfigInfo &config,
+          const DynamicRenderState &renderState);
     private:
-      static std::vector<char> readFile(
-          const std::string& path);
       void createGraphicsPipeline(
-          const std::string& vertFilePath, 
-          const std::string& fragFilePath,
+          ShaderCode vertCode,
+          ShaderCode fragCode,
           const PipelineConfigInfo& config);
       void createShaderModule(
-          const std::vector<char>& code,
+          ShaderCode code,
           VkShaderModule* shaderModule);
 
       HelloVulkanDevice& helloVulkanDevice;
       VkPipeline graphicsPipeline;
-      VkShaderModule vertShaderModule;
-      VkShaderModule fragShaderModule;
+      bool extendedDynamicState = false;
+
+      static uint64_t createdCount_;
   };
 }
@@ -1,11 +1,12 @@
 #include "helloVulkanSwapChain.hpp"
 #include "helloVulkanDevice.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
 
 // std
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
@@ -13,41 +14,71 @@
 
 namespace helloVulkan {
 
-HelloVulkanSwapChain::HelloVulkanSwapChain(helloVulkan::HelloVulkanDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+HelloVulkanSwapChain::HelloVulkanSwapChain(
+    helloVulkan::HelloVulkanDevice &deviceRef,
+    VkExtent2D extent,
+    VkPresentModeKHR presentMode,
+    HelloVulkanSwapChain *previous,
+    bool readableDepth)
+    : readableDepth{readableDepth},
+      device{deviceRef},
+      windowExtent{extent},
+      preferredPresentMode{presentMode},
+      oldSwapChain{previous} {
   createSwapChain();
+  // the previous swap chain is retired once the new one exists, the caller destroys it
+  oldSwapChain = nullptr;
   createImageViews();
-  createRenderPass();
+  swapChainDepthFormat = findDepthFormat();
+  // nothing to rebuild on recreation then, the images are used directly when recording
+  dynamicRendering = device.dynamicRendering().enabled;
+  if (!dynamicRendering) {
+    createRenderPass();
+  }
   createDepthResources();
-  createFramebuffers();
-  createSyncObjects();
+  if (!dynamicRendering) {
+    createFramebuffers();
+  }
+  if (previous != nullptr) {
+    takeSyncObjects(*previous);
+  } else {
+    createSyncObjects();
+  }
 }
 
 HelloVulkanSwapChain::~HelloVulkanSwapChain() {
+  // frames still in flight may be using any of it, so it goes once they have finished. The
+  // handles are copied, this object is gone by then.
+  VkDevice vkDevice = device.device();
   for (auto imageView : swapChainImageViews) {
-    vkDestroyImageView(device.device(), imageView, nullptr);
+    device.deferDestruction([vkDevice, imageView] { vkDestroyImageView(vkDevice, imageView, nullptr); });
   }
   swapChainImageViews.clear();
 
   if (swapChain != nullptr) {
-    vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
+    VkSwapchainKHR retired = swapChain;
+    device.deferDestruction([vkDevice, retired] { vkDestroySwapchainKHR(vkDevice, retired, nullptr); });
     swapChain = nullptr;
   }
 
   for (int i = 0; i < depthImages.size(); i++) {
-    vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.deferDestroyImage(depthImages[i], depthImageViews[i], depthImageMemorys[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
-    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+    device.deferDestruction([vkDevice, framebuffer] { vkDestroyFramebuffer(vkDevice, framebuffer, nullptr); });
   }
 
-  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  if (renderPass != VK_NULL_HANDLE) {
+    VkRenderPass retiredRenderPass = renderPass;
+    device.deferDestruction([vkDevice, retiredRenderPass] {
+      vkDestroyRenderPass(vkDevice, retiredRenderPass, nullptr);
+    });
+  }
 
-  // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // cleanup synchronization objects, unless a newer swap chain took them over. Nothing is waiting
+  // on them once the device is idle, which the last owner's destruction happens after.
+  for (size_t i = 0; i < inFlightFences.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(device.device(), inFlightFences[i], nullptr);
@@ -55,37 +86,168 @@ HelloVulkanSwapChain::~HelloVulkanSwapChain() {
 }
 
 VkResult HelloVulkanSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
-
-  VkResult result = vkAcquireNextImageKHR(
-      device.device(),
-      swapChain,
-      std::numeric_limits<uint64_t>::max(),
-      imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
-      VK_NULL_HANDLE,
-      imageIndex);
+  PROFILE_FUNCTION();
+  {
+    PROFILE_ZONE("waitForInFlightFence");
+    vkWaitForFences(
+        device.device(),
+        1,
+        &inFlightFences[currentFrame],
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max());
+  }
+  // frames finish in submission order, so everything up to this slot's last frame is done
+  device.retireFrame(frameSerials[currentFrame]);
+
+  VkResult result;
+  {
+    PROFILE_ZONE("vkAcquireNextImageKHR");
+    result = vkAcquireNextImageKHR(
+        device.device(),
+        swapChain,
+        std::numeric_limits<uint64_t>::max(),
+        imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
+        VK_NULL_HANDLE,
+        imageIndex);
+  }
 
+  // the image's command buffer is re-recorded next, so its last submission has to be done first
+  if ((result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) && imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    PROFILE_ZONE("waitForImageInFlightFence");
+    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+  }
   return result;
 }
 
-VkResult HelloVulkanSwapChain::submitCommandBuffers(
-    const VkCommandBuffer *buffers, uint32_t *imageIndex) {
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+void HelloVulkanSwapChain::beginRendering(
+    VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearColorValue &clearColour) {
+  if (!dynamicRendering) {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = getFrameBuffer(imageIndex, currentFrame);
+
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swapChainExtent;
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = clearColour;
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    return;
   }
+
+  // what the render pass's initial layouts and external dependency did. Both images are cleared so
+  // their old contents are discarded. The colour barrier waits on the stage the acquire semaphore
+  // blocks, the depth one on the previous frame's depth tests.
+  std::array<VkImageMemoryBarrier, 2> barriers{};
+  barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].srcAccessMask = 0;
+  barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = swapChainImages[imageIndex];
+  barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+  barriers[1] = barriers[0];
+  barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  barriers[1].dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  barriers[1].image = depthImages[currentFrame];
+  barriers[1].subresourceRange = {depthAspectMask(), 0, 1, 0, 1};
+
+  VkPipelineStageFlags depthStages =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | depthStages,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | depthStages,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barriers.size()),
+      barriers.data());
+
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = swapChainImageViews[imageIndex];
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.clearValue.color = clearColour;
+
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = depthImageViews[currentFrame];
+  depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = readableDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = swapChainExtent;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+  device.dynamicRendering().cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void HelloVulkanSwapChain::endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  if (!dynamicRendering) {
+    vkCmdEndRenderPass(commandBuffer);
+    return;
+  }
+  device.dynamicRendering().cmdEndRendering(commandBuffer);
+
+  // presentation waits on the render finished semaphore, so there is no destination access
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = swapChainImages[imageIndex];
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+}
+
+VkResult HelloVulkanSwapChain::submitCommandBuffers(
+    const VkCommandBuffer *buffers,
+    uint32_t *imageIndex,
+    VkSemaphore extraWait,
+    VkPipelineStageFlags extraWaitStage) {
+  PROFILE_FUNCTION();
   imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], extraWait};
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, extraWaitStage};
+  submitInfo.waitSemaphoreCount = extraWait == VK_NULL_HANDLE ? 1 : 2;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
@@ -97,10 +259,14 @@ VkResult HelloVulkanSwapChain::submitCommandBuffers(
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  {
+    PROFILE_ZONE("vkQueueSubmit");
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
   }
+  frameSerials[currentFrame] = device.submitFrame();
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -114,7 +280,11 @@ VkResult HelloVulkanSwapChain::submitCommandBuffers(
 
   presentInfo.pImageIndices = imageIndex;
 
-  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  VkResult result;
+  {
+    PROFILE_ZONE("vkQueuePresentKHR");
+    result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  }
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -144,6 +314,11 @@ void HelloVulkanSwapChain::createSwapChain() {
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // so finished frames can be read back, see FrameCapture
+  imagesCopyable = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+  if (imagesCopyable) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
 
   helloVulkan::QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -164,7 +339,7 @@ void HelloVulkanSwapChain::createSwapChain() {
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
 
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain = oldSwapChain == nullptr ? VK_NULL_HANDLE : oldSwapChain->swapChain;
 
   if (vkCreateSwapchainKHR(device.device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
@@ -205,10 +380,10 @@ void HelloVulkanSwapChain::createImageViews() {
 
 void HelloVulkanSwapChain::createRenderPass() {
   VkAttachmentDescription depthAttachment{};
-  depthAttachment.format = findDepthFormat();
+  depthAttachment.format = swapChainDepthFormat;
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.storeOp = readableDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -265,9 +440,11 @@ void HelloVulkanSwapChain::createRenderPass() {
 }
 
 void HelloVulkanSwapChain::createFramebuffers() {
-  swapChainFramebuffers.resize(imageCount());
-  for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+  swapChainFramebuffers.resize(imageCount() * MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+    size_t imageIndex = i / MAX_FRAMES_IN_FLIGHT;
+    size_t frameIndex = i % MAX_FRAMES_IN_FLIGHT;
+    std::array<VkImageView, 2> attachments = {swapChainImageViews[imageIndex], depthImageViews[frameIndex]};
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
@@ -289,36 +466,55 @@ void HelloVulkanSwapChain::createFramebuffers() {
   }
 }
 
+VkImageCreateInfo HelloVulkanSwapChain::depthImageInfo(VkExtent2D extent, VkFormat format, bool readable) {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = extent.width;
+  imageInfo.extent.height = extent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      (readable ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+  return imageInfo;
+}
+
 void HelloVulkanSwapChain::createDepthResources() {
-  VkFormat depthFormat = findDepthFormat();
-  VkExtent2D swapChainExtent = getSwapChainExtent();
+  VkFormat depthFormat = swapChainDepthFormat;
+  VkImageCreateInfo imageInfo = depthImageInfo(getSwapChainExtent(), depthFormat, readableDepth);
 
-  depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
-  depthImageViews.resize(imageCount());
+  // only frames in flight can overlap, so that's how many depth images are needed rather than one
+  // per swap chain image
+  depthImages.resize(MAX_FRAMES_IN_FLIGHT);
+  depthImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+  depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
 
   for (int i = 0; i < depthImages.size(); i++) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = swapChainExtent.width;
-    imageInfo.extent.height = swapChainExtent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = depthFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.flags = 0;
-
-    device.createImageWithInfo(
-        imageInfo,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        depthImages[i],
-        depthImageMemorys[i]);
+    if (vkCreateImage(device.device(), &imageInfo, nullptr, &depthImages[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create depth image!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device(), depthImages[i], &memRequirements);
+
+    // tilers can keep a transient attachment in tile memory and never back it, elsewhere there is
+    // no lazily allocated memory type and it's ordinary device local memory. Readable ones are
+    // written out so they always need it.
+    VkMemoryPropertyFlags lazyProperties =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    depthLazilyAllocated = !readableDepth && device.hasMemoryType(memRequirements.memoryTypeBits, lazyProperties);
+    depthImageMemorys[i] = device.allocateMemory(
+        memRequirements,
+        depthLazilyAllocated ? lazyProperties : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkBindImageMemory(device.device(), depthImages[i], depthImageMemorys[i], 0) != VK_SUCCESS) {
+      throw std::runtime_error("failed to bind depth image memory!");
+    }
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -337,6 +533,31 @@ void HelloVulkanSwapChain::createDepthResources() {
   }
 }
 
+VkDeviceSize HelloVulkanSwapChain::depthMemoryBytes() {
+  VkDeviceSize bytes = 0;
+  for (VkDeviceMemory memory : depthImageMemorys) {
+    bytes += device.allocationSize(memory);
+  }
+  return bytes;
+}
+
+void HelloVulkanSwapChain::takeSyncObjects(HelloVulkanSwapChain &previous) {
+  // Its frames may still be in flight. Carrying on with the same fences and frame index keeps
+  // waiting on them instead of the device going idle, and the fences of images it had in flight
+  // still guard the command buffers recorded for those indices.
+  imageAvailableSemaphores = std::move(previous.imageAvailableSemaphores);
+  renderFinishedSemaphores = std::move(previous.renderFinishedSemaphores);
+  inFlightFences = std::move(previous.inFlightFences);
+  previous.imageAvailableSemaphores.clear();
+  previous.renderFinishedSemaphores.clear();
+  previous.inFlightFences.clear();
+  frameSerials = previous.frameSerials;
+  currentFrame = previous.currentFrame;
+
+  imagesInFlight = previous.imagesInFlight;
+  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+}
+
 void HelloVulkanSwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -375,21 +596,20 @@ VkSurfaceFormatKHR HelloVulkanSwapChain::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR HelloVulkanSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-  //     std::cout << "Present mode: Mailbox" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
-  std::cout << "Present mode: V-Sync" << std::endl;
+  for (const auto &availablePresentMode : availablePresentModes) {
+    if (availablePresentMode == preferredPresentMode &&
+        availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+      LogLine{LogSeverity::info} << "Present mode: Mailbox";
+      return availablePresentMode;
+    }
+    if (availablePresentMode == preferredPresentMode &&
+        availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+      LogLine{LogSeverity::info} << "Present mode: Immediate";
+      return availablePresentMode;
+    }
+  }
+
+  LogLine{LogSeverity::info} << "Present mode: V-Sync";
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -409,11 +629,22 @@ VkExtent2D HelloVulkanSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR
   }
 }
 
+VkImageAspectFlags HelloVulkanSwapChain::depthAspectMask() const {
+  // layout transitions of a combined format have to cover the stencil aspect too
+  if (swapChainDepthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+      swapChainDepthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
 VkFormat HelloVulkanSwapChain::findDepthFormat() {
   return device.findSupportedFormat(
       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
       VK_IMAGE_TILING_OPTIMAL,
-      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+      readableDepth
+          ? VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+          : VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
 }  // namespace lve
@@ -6,6 +6,8 @@
 #include <vulkan/vulkan.h>
 
 // std lib headers
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -15,14 +17,33 @@ class HelloVulkanSwapChain {
  public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-  HelloVulkanSwapChain(helloVulkan::HelloVulkanDevice &deviceRef, VkExtent2D windowExtent);
+  // previous is retired and its frames in flight carry on under this one, its resources are freed
+  // through the device's deletion queue once those frames have finished. readableDepth keeps the
+  // depth attachments after the scene so they can be sampled, e.g. by a DepthPyramid.
+  HelloVulkanSwapChain(
+      helloVulkan::HelloVulkanDevice &deviceRef,
+      VkExtent2D windowExtent,
+      VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR,
+      HelloVulkanSwapChain *previous = nullptr,
+      bool readableDepth = false);
   ~HelloVulkanSwapChain();
 
   HelloVulkanSwapChain(const HelloVulkanSwapChain &) = delete;
   void operator=(const HelloVulkanSwapChain &) = delete;
 
-  VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+  // one framebuffer per swap chain image and frame in flight, the depth attachment is per frame.
+  // There are none under dynamic rendering.
+  VkFramebuffer getFrameBuffer(int imageIndex, size_t frameIndex) {
+    return swapChainFramebuffers[imageIndex * MAX_FRAMES_IN_FLIGHT + frameIndex];
+  }
+  // the frame in flight being recorded, valid between acquireNextImage and submitCommandBuffers
+  size_t currentFrameIndex() const { return currentFrame; }
+  // VK_NULL_HANDLE under dynamic rendering, pipelines are then built from the attachment formats
   VkRenderPass getRenderPass() { return renderPass; }
+  bool usesDynamicRendering() const { return dynamicRendering; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
+  // whether the images can be a transfer source, false when the surface doesn't allow it
+  bool canCopyImages() const { return imagesCopyable; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -33,10 +54,40 @@ class HelloVulkanSwapChain {
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
+  VkFormat getDepthFormat() { return swapChainDepthFormat; }
   VkFormat findDepthFormat();
+  VkDeviceSize depthMemoryBytes();
+  bool depthIsLazilyAllocated() const { return depthLazilyAllocated; }
+  // Depth attachments are transient unless readable, nothing reads them after the render pass.
+  // Readable ones are stored and left in DEPTH_STENCIL_ATTACHMENT_OPTIMAL for sampling through
+  // getDepthImageView, which only has the depth aspect.
+  static VkImageCreateInfo depthImageInfo(VkExtent2D extent, VkFormat format, bool readable = false);
+  bool hasReadableDepth() const { return readableDepth; }
+  VkImage getDepthImage(size_t frameIndex) { return depthImages[frameIndex]; }
+  VkImageView getDepthImageView(size_t frameIndex) { return depthImageViews[frameIndex]; }
+  const std::vector<VkImageView> &getDepthImageViews() { return depthImageViews; }
+  // what layout transitions of the depth images have to cover
+  VkImageAspectFlags depthAspectMask() const;
+
+  // pipelines built against the other swap chain's render pass or formats stay valid for this one if true
+  bool compareSwapFormats(const HelloVulkanSwapChain &other) const {
+    return other.swapChainImageFormat == swapChainImageFormat &&
+        other.swapChainDepthFormat == swapChainDepthFormat;
+  }
+
+  // starts drawing into the image for the current frame, clearing colour and depth. Either begins
+  // the render pass or transitions the images and begins dynamic rendering.
+  void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearColorValue &clearColour);
+  // leaves the image ready to present
+  void endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
   VkResult acquireNextImage(uint32_t *imageIndex);
-  VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+  // extraWait is waited on as well as the acquired image, e.g. compute work the frame consumes
+  VkResult submitCommandBuffers(
+      const VkCommandBuffer *buffers,
+      uint32_t *imageIndex,
+      VkSemaphore extraWait = VK_NULL_HANDLE,
+      VkPipelineStageFlags extraWaitStage = 0);
 
  private:
   void createSwapChain();
@@ -45,6 +96,7 @@ class HelloVulkanSwapChain {
   void createRenderPass();
   void createFramebuffers();
   void createSyncObjects();
+  void takeSyncObjects(HelloVulkanSwapChain &previous);
 
   // Helper functions
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -54,26 +106,35 @@ class HelloVulkanSwapChain {
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
   VkFormat swapChainImageFormat;
+  VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  bool dynamicRendering = false;
+  bool imagesCopyable = false;
 
   std::vector<VkImage> depthImages;
   std::vector<VkDeviceMemory> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
+  bool depthLazilyAllocated = false;
+  bool readableDepth = false;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   helloVulkan::HelloVulkanDevice &device;
   VkExtent2D windowExtent;
+  VkPresentModeKHR preferredPresentMode;
 
   VkSwapchainKHR swapChain;
+  HelloVulkanSwapChain *oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
   std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
+  // the device frame each slot last submitted, retired once its fence has been waited on
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameSerials{};
   size_t currentFrame = 0;
 };
 
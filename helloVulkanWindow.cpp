@@ -2,7 +2,7 @@
 
 namespace helloVulkan {
 
-  HelloVulkanWindow::HelloVulkanWindow(int w, int h, std::string name) : width{w}, height{h}, name{name} {
+  HelloVulkanWindow::HelloVulkanWindow(int w, int h, std::string name, bool visible) : width{w}, height{h}, name{name}, visible{visible} {
     init();
   }
 
@@ -14,10 +14,22 @@ namespace helloVulkan {
   void HelloVulkanWindow::init() {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
   }
+
+  void HelloVulkanWindow::framebufferResizeCallback(GLFWwindow *window, int width, int height) {
+    auto helloVulkanWindow = reinterpret_cast<HelloVulkanWindow *>(glfwGetWindowUserPointer(window));
+    helloVulkanWindow->width = width;
+    helloVulkanWindow->height = height;
+    // after the size, so whoever sees the flag also sees the new size
+    helloVulkanWindow->framebufferResized = true;
+  }
+
   void HelloVulkanWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface) {
     glfwCreateWindowSurface(instance, window, nullptr, surface);
   }
@@ -2,23 +2,32 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <atomic>
 #include <string>
 
 namespace helloVulkan {
 
   class HelloVulkanWindow {
     public:
-      HelloVulkanWindow(int h, int w, std::string name);
+      HelloVulkanWindow(int h, int w, std::string name, bool visible = true);
       ~HelloVulkanWindow();
       HelloVulkanWindow(const HelloVulkanWindow &) = delete;
       HelloVulkanWindow &operator=(const HelloVulkanWindow &) = delete;
+      // these four can be called from any thread, the size is kept up to date by the resize
+      // callback run by glfwPollEvents on the main thread
       bool shouldClose() { return glfwWindowShouldClose(window); }
-      VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(width) }; }
+      VkExtent2D getExtent() { return { static_cast<uint32_t>(width.load()), static_cast<uint32_t>(height.load()) }; }
+      bool wasWindowResized() { return framebufferResized.load(); }
+      void resetWindowResizedFlag() { framebufferResized.store(false); }
       void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
     private:
-      const int width;
-      const int height;
+      static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+
+      std::atomic<int> width;
+      std::atomic<int> height;
+      std::atomic<bool> framebufferResized{false};
       const std::string name;
+      const bool visible;
       GLFWwindow *window;
       void init();
   };
@@ -0,0 +1,267 @@
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    // set on worker threads, the submitting thread is found by its id instead so one thread can
+    // submit to more than one system
+    thread_local const JobSystem *workerSystem = nullptr;
+    thread_local uint32_t workerIndex = 0;
+
+    uint32_t nextRandom(uint32_t &state) {
+      // xorshift32
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state;
+    }
+  }
+
+  JobSystem::JobSystem(uint32_t threadCount)
+      : mainThreadId{std::this_thread::get_id()}, submitThreadId{std::this_thread::get_id()} {
+    if (threadCount == 0) {
+      threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+      threads.push_back(std::make_unique<ThreadState>(DEQUE_CAPACITY));
+      threads.back()->randomState = 0x9e3779b9u * (i + 1);
+    }
+    for (uint32_t i = 1; i < threadCount; i++) {
+      workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+  }
+
+  JobSystem::~JobSystem() {
+    stopping.store(true);
+    wakeWorkers(true);
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  JobSystem::ThreadState &JobSystem::currentThread() {
+    if (workerSystem == this) {
+      return *threads[workerIndex];
+    }
+    if (std::this_thread::get_id() == submitThreadId.load()) {
+      return *threads[0];
+    }
+    throw std::runtime_error("Jobs can only be queued from the submitting thread or from other jobs");
+  }
+
+  Job *JobSystem::allocateJob() {
+    ThreadState &self = currentThread();
+    Job *job = &self.pool[self.nextPoolSlot++ & (POOL_SIZE - 1)];
+    if (job->inFlight.load(std::memory_order_acquire)) {
+      // more than POOL_SIZE of this thread's jobs are still around
+      job = new Job{};
+      job->heapAllocated = true;
+      self.heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    job->inFlight.store(true, std::memory_order_relaxed);
+    job->dependency = nullptr;
+    return job;
+  }
+
+  void JobSystem::submit(Job *job, JobCounter *dependency) {
+    if (dependency != nullptr && !dependency->done()) {
+      job->dependency = dependency;
+      {
+        std::lock_guard<std::mutex> lock{waitingMutex};
+        waitingJobs.push_back(job);
+        waitingCount.fetch_add(1);
+      }
+      // the dependency may have finished while the job was being put aside, with nobody left to
+      // look at the waiting jobs
+      if (dependency->done()) {
+        wakeWorkers(true);
+      }
+      return;
+    }
+    enqueue(currentThread(), job);
+  }
+
+  void JobSystem::enqueue(ThreadState &self, Job *job) {
+    if (!self.deque.push(job)) {
+      self.inlineRuns.fetch_add(1, std::memory_order_relaxed);
+      execute(self, job);
+      return;
+    }
+    queuedJobs.fetch_add(1);
+    if (sleepingWorkers.load() > 0) {
+      wakeWorkers(false);
+    }
+  }
+
+  void JobSystem::execute(ThreadState &self, Job *job) {
+    job->invoke(job->storage);
+    job->destroy(job->storage);
+    JobCounter *counter = job->counter;
+    if (job->heapAllocated) {
+      delete job;
+    } else {
+      job->inFlight.store(false, std::memory_order_release);
+    }
+    self.jobsRun.fetch_add(1, std::memory_order_relaxed);
+    // nothing may touch the counter after this, a waiter is free to destroy it
+    if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && waitingCount.load() > 0) {
+      wakeWorkers(true);
+    }
+  }
+
+  bool JobSystem::findJob(ThreadState &self, Job *&job) {
+    if (self.deque.pop(job)) {
+      queuedJobs.fetch_sub(1);
+      return true;
+    }
+    uint32_t threadCount = static_cast<uint32_t>(threads.size());
+    uint32_t start = nextRandom(self.randomState) % threadCount;
+    for (uint32_t i = 0; i < threadCount; i++) {
+      ThreadState &victim = *threads[(start + i) % threadCount];
+      if (&victim != &self && victim.deque.steal(job)) {
+        queuedJobs.fetch_sub(1);
+        self.steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return waitingCount.load() > 0 && takeReadyWaitingJob(job);
+  }
+
+  bool JobSystem::takeReadyWaitingJob(Job *&job) {
+    std::unique_lock<std::mutex> lock{waitingMutex, std::try_to_lock};
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    auto ready = std::find_if(waitingJobs.begin(), waitingJobs.end(), [](Job *waiting) {
+      return waiting->dependency->done();
+    });
+    if (ready == waitingJobs.end()) {
+      return false;
+    }
+    job = *ready;
+    *ready = waitingJobs.back();
+    waitingJobs.pop_back();
+    waitingCount.fetch_sub(1);
+    return true;
+  }
+
+  void JobSystem::wakeWorkers(bool all) {
+    std::lock_guard<std::mutex> lock{sleepMutex};
+    wakeEpoch++;
+    if (all) {
+      wakeCondition.notify_all();
+    } else {
+      wakeCondition.notify_one();
+    }
+  }
+
+  void JobSystem::workerLoop(uint32_t index) {
+    workerSystem = this;
+    workerIndex = index;
+    ThreadState &self = *threads[index];
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+      Job *job;
+      bool found = false;
+      // a short spin first, sleeping and waking costs more than most jobs
+      for (uint32_t attempt = 0; attempt < 64 && !found; attempt++) {
+        found = findJob(self, job);
+        if (!found) {
+          std::this_thread::yield();
+        }
+      }
+      if (found) {
+        execute(self, job);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock{sleepMutex};
+      uint64_t epoch = wakeEpoch;
+      sleepingWorkers.fetch_add(1);
+      wakeCondition.wait(lock, [&] {
+        return stopping.load() || wakeEpoch != epoch || queuedJobs.load() > 0;
+      });
+      sleepingWorkers.fetch_sub(1);
+    }
+  }
+
+  void JobSystem::wait(JobCounter &counter) {
+    ThreadState &self = currentThread();
+    bool mainThread = isMainThread();
+    while (!counter.done()) {
+      if (mainThread) {
+        pumpMainThread();
+      }
+      Job *job;
+      if (findJob(self, job)) {
+        execute(self, job);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void JobSystem::parallelForRange(
+        JobCounter &counter,
+        const std::function<void(uint32_t, uint32_t)> &body,
+        uint32_t begin,
+        uint32_t end,
+        uint32_t grainSize) {
+    // hand the upper half to whoever steals it and carry on with the lower one
+    while (end - begin > grainSize) {
+      uint32_t middle = begin + (end - begin) / 2;
+      run(counter, [this, &counter, &body, middle, end, grainSize] {
+        parallelForRange(counter, body, middle, end, grainSize);
+      });
+      end = middle;
+    }
+    body(begin, end);
+  }
+
+  void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &body) {
+    if (count == 0) {
+      return;
+    }
+    grainSize = std::max(grainSize, 1u);
+    if (count <= grainSize || threads.size() == 1) {
+      body(0, count);
+      return;
+    }
+    JobCounter counter;
+    parallelForRange(counter, body, 0, count, grainSize);
+    wait(counter);
+  }
+
+  void JobSystem::runOnMainThread(std::function<void()> function) {
+    std::lock_guard<std::mutex> lock{mainThreadMutex};
+    mainThreadQueue.push_back(std::move(function));
+  }
+
+  void JobSystem::pumpMainThread() {
+    if (!isMainThread()) {
+      throw std::runtime_error("pumpMainThread has to be called on the main thread");
+    }
+    std::deque<std::function<void()>> pending;
+    {
+      std::lock_guard<std::mutex> lock{mainThreadMutex};
+      pending.swap(mainThreadQueue);
+    }
+    for (std::function<void()> &function : pending) {
+      function();
+    }
+  }
+
+  JobSystemStats JobSystem::stats() const {
+    JobSystemStats stats{};
+    for (const auto &thread : threads) {
+      stats.jobsRun += thread->jobsRun.load(std::memory_order_relaxed);
+      stats.steals += thread->steals.load(std::memory_order_relaxed);
+      stats.heapAllocations += thread->heapAllocations.load(std::memory_order_relaxed);
+      stats.inlineRuns += thread->inlineRuns.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+}
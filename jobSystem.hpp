@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace helloVulkan {
+
+  class JobCounter;
+
+  // A unit of work small enough to live in a fixed pool slot, the callable is stored inline
+  class Job {
+    public:
+      static constexpr size_t STORAGE_SIZE = 64;
+
+    private:
+      friend class JobSystem;
+
+      void (*invoke)(void *storage) = nullptr;
+      void (*destroy)(void *storage) = nullptr;
+      alignas(std::max_align_t) unsigned char storage[STORAGE_SIZE];
+      JobCounter *counter = nullptr;
+      // the job is held back until this reaches zero
+      JobCounter *dependency = nullptr;
+      // set from allocation until the job has run, a pool slot is only reused once it's clear
+      std::atomic<bool> inFlight{false};
+      // allocated because its pool slot was still in flight
+      bool heapAllocated = false;
+  };
+
+  // Counts a group of jobs still to finish, and is what other jobs depend on. Has to outlive the
+  // jobs counted on it and the jobs depending on it.
+  class JobCounter {
+    public:
+      JobCounter() = default;
+      JobCounter(const JobCounter &) = delete;
+      JobCounter &operator=(const JobCounter &) = delete;
+
+      bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+      friend class JobSystem;
+
+      std::atomic<uint32_t> pending{0};
+  };
+
+  // The single-producer, multi-consumer deque of Chase and Lev, with the memory orderings of Lê et
+  // al., "Correct and Efficient Work-Stealing for Weak Memory Models". The owner pushes and pops at
+  // the bottom, any thread steals from the top. Fixed capacity, push fails when it's full.
+  template <typename T>
+  class WorkStealingDeque {
+    public:
+      explicit WorkStealingDeque(size_t capacity) : mask{capacity - 1}, buffer(capacity) {}
+
+      // owner only
+      bool push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask)) {
+          return false;
+        }
+        buffer[b & mask].store(item, std::memory_order_relaxed);
+        // a release store rather than the paper's fence, the same on every target we care about and
+        // visible to the thread sanitizer
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+      }
+
+      // owner only, newest first
+      bool pop(T &item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+          bottom.store(b + 1, std::memory_order_relaxed);
+          return false;
+        }
+        item = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+          // the last item, race the thieves for it
+          bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+          bottom.store(b + 1, std::memory_order_relaxed);
+          return won;
+        }
+        return true;
+      }
+
+      // any thread, oldest first
+      bool steal(T &item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+          return false;
+        }
+        item = buffer[t & mask].load(std::memory_order_relaxed);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      }
+
+      size_t sizeEstimate() const {
+        int64_t size = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+        return size > 0 ? static_cast<size_t>(size) : 0;
+      }
+
+    private:
+      size_t mask;
+      // apart so the owner and the thieves don't fight over one cache line
+      alignas(64) std::atomic<int64_t> top{0};
+      alignas(64) std::atomic<int64_t> bottom{0};
+      std::vector<std::atomic<T>> buffer;
+  };
+
+  struct JobSystemStats {
+    uint64_t jobsRun = 0;
+    uint64_t steals = 0;
+    // jobs whose pool slot was busy, or whose deque was full and so ran straight away
+    uint64_t heapAllocations = 0;
+    uint64_t inlineRuns = 0;
+  };
+
+  // Work-stealing scheduler. The thread that creates it is the main thread and takes part whenever
+  // it waits, the others are workers. Each thread queues jobs on its own deque and idle threads
+  // steal from the others. GLFW and anything else that has to stay on the main thread goes through
+  // runOnMainThread, which the main loop drains with pumpMainThread.
+  //
+  // Jobs may only be queued from the submitting thread or from inside other jobs. That is the main
+  // thread unless setSubmitThread handed it to another, e.g. a render thread.
+  class JobSystem {
+    public:
+      static constexpr size_t DEQUE_CAPACITY = 4096;
+      static constexpr size_t POOL_SIZE = 4096;
+
+      // threadCount includes the main thread, 0 for one per hardware thread. 1 runs every job on
+      // the submitting thread while it waits.
+      explicit JobSystem(uint32_t threadCount = 0);
+      ~JobSystem();
+
+      JobSystem(const JobSystem &) = delete;
+      JobSystem &operator=(const JobSystem &) = delete;
+
+      uint32_t threadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+      template <typename Function>
+      void run(JobCounter &counter, Function &&function) {
+        submit(makeJob(counter, std::forward<Function>(function)), nullptr);
+      }
+
+      // starts once dependency reaches zero, jobs held back like this are checked whenever a
+      // thread runs out of work
+      template <typename Function>
+      void runAfter(JobCounter &dependency, JobCounter &counter, Function &&function) {
+        submit(makeJob(counter, std::forward<Function>(function)), &dependency);
+      }
+
+      // runs other jobs until the counter reaches zero. On the main thread it also drains the
+      // main thread queue.
+      void wait(JobCounter &counter);
+
+      // body(begin, end) over [0, count) in ranges of at most grainSize, returning once all of them
+      // have run. The range is split in halves as it is stolen, so idle threads take big pieces.
+      void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &body);
+
+      void runOnMainThread(std::function<void()> function);
+      // main thread only, runs what runOnMainThread queued
+      void pumpMainThread();
+      bool isMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+      // Makes the calling thread the one queueing jobs from outside them, the main thread keeps
+      // its queue. Only while no jobs are running, the previous submitting thread must be done.
+      void setSubmitThread() { submitThreadId.store(std::this_thread::get_id()); }
+
+      JobSystemStats stats() const;
+
+    private:
+      struct alignas(64) ThreadState {
+        explicit ThreadState(size_t capacity) : deque{capacity}, pool(POOL_SIZE) {}
+
+        WorkStealingDeque<Job *> deque;
+        std::vector<Job> pool;
+        size_t nextPoolSlot = 0;
+        uint32_t randomState = 0;
+        std::atomic<uint64_t> jobsRun{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> heapAllocations{0};
+        std::atomic<uint64_t> inlineRuns{0};
+      };
+
+      template <typename Function>
+      Job *makeJob(JobCounter &counter, Function &&function) {
+        using Callable = std::decay_t<Function>;
+        static_assert(sizeof(Callable) <= Job::STORAGE_SIZE, "capture less, or capture a pointer to the state");
+        static_assert(alignof(Callable) <= alignof(std::max_align_t), "over-aligned job callable");
+        Job *job = allocateJob();
+        new (job->storage) Callable(std::forward<Function>(function));
+        job->invoke = [](void *storage) { (*static_cast<Callable *>(storage))(); };
+        job->destroy = [](void *storage) { static_cast<Callable *>(storage)->~Callable(); };
+        job->counter = &counter;
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        return job;
+      }
+
+      ThreadState &currentThread();
+      Job *allocateJob();
+      void submit(Job *job, JobCounter *dependency);
+      void enqueue(ThreadState &self, Job *job);
+      void execute(ThreadState &self, Job *job);
+      bool findJob(ThreadState &self, Job *&job);
+      bool takeReadyWaitingJob(Job *&job);
+      void parallelForRange(
+          JobCounter &counter,
+          const std::function<void(uint32_t, uint32_t)> &body,
+          uint32_t begin,
+          uint32_t end,
+          uint32_t grainSize);
+      void wakeWorkers(bool all);
+      void workerLoop(uint32_t index);
+
+      std::thread::id mainThreadId;
+      std::atomic<std::thread::id> submitThreadId;
+      // index 0 is the submitting thread's
+      std::vector<std::unique_ptr<ThreadState>> threads;
+      std::vector<std::thread> workers;
+      std::atomic<bool> stopping{false};
+
+      // jobs sitting in deques, workers only sleep while it is zero
+      std::atomic<int64_t> queuedJobs{0};
+      std::mutex sleepMutex;
+      std::condition_variable wakeCondition;
+      std::atomic<uint32_t> sleepingWorkers{0};
+      // bumped under sleepMutex to wake sleepers for something other than a queued job
+      uint64_t wakeEpoch = 0;
+
+      // jobs whose dependency hadn't reached zero when they were submitted
+      std::mutex waitingMutex;
+      std::vector<Job *> waitingJobs;
+      std::atomic<uint32_t> waitingCount{0};
+
+      std::mutex mainThreadMutex;
+      std::deque<std::function<void()>> mainThreadQueue;
+  };
+}
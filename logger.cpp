@@ -0,0 +1,312 @@
+#include "logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace helloVulkan {
+
+  namespace {
+    // a power of two, about a megabyte of messages
+    constexpr uint64_t RING_CAPACITY = 1 << 10;
+    constexpr uint32_t RATE_TABLE_SIZE = 256;
+    constexpr uint64_t RATE_WINDOW_NS = 1000000000;
+    // how long the writer sleeps before looking at the ring again if nobody wakes it
+    constexpr auto WRITER_IDLE_WAIT = std::chrono::milliseconds{10};
+
+    // One cell of Vyukov's bounded MPMC queue, used with a single consumer. sequence is the
+    // position the cell is next free to be written at, and that position + 1 once it's filled.
+    struct Slot {
+      std::atomic<uint64_t> sequence;
+      LogSeverity severity;
+      const char *tag;
+      uint32_t length;
+      char text[Logger::MAX_MESSAGE_BYTES];
+    };
+
+    // Counts one message id's messages in the current window. Ids sharing an entry take it over
+    // from each other, and the fields are updated separately, so under contention the limit lets
+    // a few more or fewer through. It only has to keep a flood down.
+    struct RateEntry {
+      std::atomic<uint32_t> id{0};
+      std::atomic<uint64_t> windowStartNs{0};
+      std::atomic<uint32_t> count{0};
+      std::atomic<uint32_t> suppressed{0};
+    };
+
+    uint64_t nowNs() {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool parseSeverity(const char *name, LogSeverity &severity) {
+      static const std::pair<const char *, LogSeverity> NAMES[] = {
+        {"verbose", LogSeverity::verbose},
+        {"info", LogSeverity::info},
+        {"warning", LogSeverity::warning},
+        {"error", LogSeverity::error},
+      };
+      for (const auto &entry : NAMES) {
+        if (std::strcmp(name, entry.first) == 0) {
+          severity = entry.second;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    struct LoggerState {
+      std::unique_ptr<Slot[]> slots{new Slot[RING_CAPACITY]};
+      std::atomic<uint64_t> enqueuePosition{0};
+      // only the writer moves it on, flush() waits for it
+      std::atomic<uint64_t> dequeuePosition{0};
+      std::array<RateEntry, RATE_TABLE_SIZE> rates;
+
+      std::atomic<LogSeverity> minimum{LogSeverity::info};
+      std::atomic<uint32_t> rateLimit{4};
+      std::atomic<std::FILE *> redirected{nullptr};
+
+      std::atomic<uint64_t> written{0};
+      std::atomic<uint64_t> dropped{0};
+      std::atomic<uint64_t> suppressed{0};
+      std::atomic<uint64_t> filtered{0};
+
+      std::mutex wakeMutex;
+      std::condition_variable wake;
+      std::atomic<bool> writerIdle{false};
+      std::atomic<bool> stopping{false};
+      std::thread writer;
+
+      LoggerState() {
+        for (uint64_t i = 0; i < RING_CAPACITY; i++) {
+          slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        LogSeverity severity;
+        if (const char *level = std::getenv("HELLO_VULKAN_LOG_LEVEL")) {
+          if (parseSeverity(level, severity)) {
+            minimum.store(severity);
+          }
+        }
+        if (const char *limit = std::getenv("HELLO_VULKAN_LOG_RATE_LIMIT")) {
+          rateLimit.store(static_cast<uint32_t>(std::strtoul(limit, nullptr, 10)));
+        }
+        writer = std::thread{[this] { writerLoop(); }};
+      }
+
+      ~LoggerState() {
+        for (RateEntry &entry : rates) {
+          reportSuppressed(entry.id.load(), entry.suppressed.exchange(0));
+        }
+        stopping.store(true);
+        wake.notify_one();
+        writer.join();
+      }
+
+      bool enqueue(LogSeverity severity, const char *tag, const char *message) {
+        uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+          slot = &slots[position & (RING_CAPACITY - 1)];
+          uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+          int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+          if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+              break;
+            }
+          } else if (difference < 0) {
+            // the writer hasn't got round to this cell since the last lap
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+          } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+          }
+        }
+        size_t length = std::min<size_t>(std::strlen(message), Logger::MAX_MESSAGE_BYTES);
+        std::memcpy(slot->text, message, length);
+        slot->length = static_cast<uint32_t>(length);
+        slot->severity = severity;
+        slot->tag = tag;
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        if (writerIdle.load()) {
+          wake.notify_one();
+        }
+        return true;
+      }
+
+      void reportSuppressed(uint32_t id, uint32_t count) {
+        if (count == 0) {
+          return;
+        }
+        char summary[96];
+        std::snprintf(summary, sizeof(summary), "%u more messages with id 0x%08x suppressed", count, id);
+        enqueue(LogSeverity::warning, nullptr, summary);
+      }
+
+      // false when the message is over its id's limit for this window
+      bool admit(uint32_t id) {
+        uint32_t limit = rateLimit.load(std::memory_order_relaxed);
+        if (limit == 0) {
+          return true;
+        }
+        RateEntry &entry = rates[(id * 2654435761u) >> 24];
+        uint64_t now = nowNs();
+        uint32_t owner = entry.id.load();
+        if (owner != id) {
+          if (entry.id.compare_exchange_strong(owner, id)) {
+            reportSuppressed(owner, entry.suppressed.exchange(0));
+            entry.windowStartNs.store(now);
+            entry.count.store(0);
+          } else if (owner != id) {
+            // another id took the entry first, let this one through rather than contend
+            return true;
+          }
+        }
+        uint64_t start = entry.windowStartNs.load();
+        if (now > start && now - start >= RATE_WINDOW_NS && entry.windowStartNs.compare_exchange_strong(start, now)) {
+          entry.count.store(0);
+          reportSuppressed(id, entry.suppressed.exchange(0));
+        }
+        if (entry.count.fetch_add(1, std::memory_order_relaxed) < limit) {
+          return true;
+        }
+        entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      bool ready() {
+        uint64_t position = dequeuePosition.load(std::memory_order_relaxed);
+        return slots[position & (RING_CAPACITY - 1)].sequence.load(std::memory_order_acquire) == position + 1;
+      }
+
+      // Writes out whatever is in the ring with one write and flush per stream, false if it was empty
+      bool drain(std::string &buffer) {
+        std::FILE *file = redirected.load(std::memory_order_acquire);
+        std::FILE *current = nullptr;
+        auto writeBuffer = [&] {
+          if (!buffer.empty()) {
+            std::fwrite(buffer.data(), 1, buffer.size(), current);
+            std::fflush(current);
+            buffer.clear();
+          }
+        };
+
+        uint64_t position = dequeuePosition.load(std::memory_order_relaxed);
+        uint64_t end = position + RING_CAPACITY;
+        uint64_t start = position;
+        for (; position < end; position++) {
+          Slot &slot = slots[position & (RING_CAPACITY - 1)];
+          if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+          }
+          std::FILE *target = file != nullptr ? file : slot.severity >= LogSeverity::warning ? stderr : stdout;
+          // lines keep their order across stdout and stderr
+          if (target != current) {
+            writeBuffer();
+            current = target;
+          }
+          if (slot.tag != nullptr) {
+            buffer += slot.tag;
+            buffer += ": ";
+          }
+          buffer.append(slot.text, slot.length);
+          buffer += '\n';
+          slot.sequence.store(position + RING_CAPACITY, std::memory_order_release);
+        }
+        writeBuffer();
+        if (position == start) {
+          return false;
+        }
+        written.fetch_add(position - start, std::memory_order_relaxed);
+        dequeuePosition.store(position, std::memory_order_release);
+        return true;
+      }
+
+      void writerLoop() {
+        std::string buffer;
+        while (true) {
+          if (drain(buffer)) {
+            continue;
+          }
+          if (stopping.load()) {
+            break;
+          }
+          // a producer that misses the flag is picked up when the wait times out
+          std::unique_lock<std::mutex> lock{wakeMutex};
+          writerIdle.store(true);
+          if (!ready() && !stopping.load()) {
+            wake.wait_for(lock, WRITER_IDLE_WAIT);
+          }
+          writerIdle.store(false);
+        }
+      }
+    };
+
+    LoggerState &state() {
+      static LoggerState loggerState;
+      return loggerState;
+    }
+  }
+
+  void Logger::write(LogSeverity severity, const char *tag, uint32_t messageId, const char *message) {
+    LoggerState &loggerState = state();
+    if (severity < loggerState.minimum.load(std::memory_order_relaxed)) {
+      loggerState.filtered.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if (messageId != 0 && !loggerState.admit(messageId)) {
+      return;
+    }
+    loggerState.enqueue(severity, tag, message);
+  }
+
+  bool Logger::enabled(LogSeverity severity) {
+    return severity >= state().minimum.load(std::memory_order_relaxed);
+  }
+
+  LogSeverity Logger::minimumSeverity() {
+    return state().minimum.load(std::memory_order_relaxed);
+  }
+
+  void Logger::setMinimumSeverity(LogSeverity severity) {
+    state().minimum.store(severity);
+  }
+
+  void Logger::setRateLimit(uint32_t messagesPerSecond) {
+    state().rateLimit.store(messagesPerSecond);
+  }
+
+  void Logger::redirect(std::FILE *file) {
+    // what's already queued goes where it was headed
+    flush();
+    state().redirected.store(file, std::memory_order_release);
+  }
+
+  void Logger::flush() {
+    LoggerState &loggerState = state();
+    uint64_t target = loggerState.enqueuePosition.load(std::memory_order_acquire);
+    while (loggerState.dequeuePosition.load(std::memory_order_acquire) < target) {
+      loggerState.wake.notify_one();
+      std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+  }
+
+  LogStats Logger::stats() {
+    LoggerState &loggerState = state();
+    LogStats stats{};
+    stats.written = loggerState.written.load();
+    stats.dropped = loggerState.dropped.load();
+    stats.suppressed = loggerState.suppressed.load();
+    stats.filtered = loggerState.filtered.load();
+    return stats;
+  }
+}
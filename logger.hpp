@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+
+// Asynchronous logging. Writing a message copies it into a fixed-size lock-free ring and returns;
+// a background thread formats the ring out to stdout/stderr in batches, so a thread that logs
+// never waits on console I/O. When the ring is full the message is dropped and counted rather
+// than blocking the caller.
+//
+// Messages with a non-zero id (validation messages pass their messageIdNumber) are rate limited
+// per id: after HELLO_VULKAN_LOG_RATE_LIMIT messages (default 4) in a second the rest of that
+// second's are suppressed, with a count written once the id comes round again or at exit. 0 turns
+// the limit off. Messages below HELLO_VULKAN_LOG_LEVEL (verbose, info, warning or error, default
+// info) are filtered out before they reach the ring.
+
+namespace helloVulkan {
+
+  enum class LogSeverity : uint8_t {
+    verbose,
+    info,
+    warning,
+    error,
+  };
+
+  struct LogStats {
+    uint64_t written = 0;
+    // ring full
+    uint64_t dropped = 0;
+    // over the rate limit for their id
+    uint64_t suppressed = 0;
+    // below the minimum severity
+    uint64_t filtered = 0;
+  };
+
+  class Logger {
+    public:
+      // longer messages are cut short
+      static constexpr uint32_t MAX_MESSAGE_BYTES = 1024;
+
+      // tag, when set, has to outlive the process (a string literal) and is printed before the
+      // message. Safe from any thread, including driver callbacks.
+      static void write(LogSeverity severity, const char *tag, uint32_t messageId, const char *message);
+      static void write(LogSeverity severity, const char *message) { write(severity, nullptr, 0, message); }
+
+      static bool enabled(LogSeverity severity);
+      static LogSeverity minimumSeverity();
+      static void setMinimumSeverity(LogSeverity severity);
+      // messages per id per second, 0 for no limit
+      static void setRateLimit(uint32_t messagesPerSecond);
+      // everything from here on to file instead of stdout/stderr, nullptr to go back. The file has
+      // to stay open until the next redirect.
+      static void redirect(std::FILE *file);
+
+      // Blocks until everything written before the call is out
+      static void flush();
+      static LogStats stats();
+  };
+
+  // Collects one line with operator<< and hands it to the logger when it goes out of scope, for the
+  // places that used to stream to std::cout:
+  //   LogLine{LogSeverity::info} << "Device count: " << deviceCount;
+  class LogLine {
+    public:
+      explicit LogLine(LogSeverity severity) : severity{severity}, enabled{Logger::enabled(severity)} {}
+      ~LogLine() {
+        if (enabled) {
+          Logger::write(severity, stream.str().c_str());
+        }
+      }
+
+      LogLine(const LogLine &) = delete;
+      LogLine &operator=(const LogLine &) = delete;
+
+      template <typename T>
+      LogLine &operator<<(const T &value) {
+        if (enabled) {
+          stream << value;
+        }
+        return *this;
+      }
+
+    private:
+      LogSeverity severity;
+      bool enabled;
+      std::ostringstream stream;
+  };
+}
@@ -2,44 +2,32 @@
 #include "helloVulkanDevice.hpp"
 #include <cstddef>
 #include <cstdint>
-#include <cstring>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace helloVulkan {
-  Model::Model(HelloVulkanDevice &device, std::vector<Vertex> &vertices) : helloVulkanDevice{device} {
-    createVertexBuffers(vertices);
+  Model::Model(GeometryPool &pool, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) :
+        pool{pool} {
+    range = pool.allocate(
+        vertices.data(),
+        static_cast<uint32_t>(vertices.size()),
+        indices.data(),
+        static_cast<uint32_t>(indices.size()));
   }
 
-  Model::~Model() {
-    vkDestroyBuffer(helloVulkanDevice.device(), vertexBuffer, NULL);
-    vkFreeMemory(helloVulkanDevice.device(), vertexBufferMemory, NULL);
-  }
+  Model::Model(GeometryPool &pool, const GeometryRange &range) : pool{pool}, range{range} {}
 
-  void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
-    vertexCount = static_cast<uint32_t>(vertices.size());
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-    helloVulkanDevice.createBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        vertexBuffer,
-        vertexBufferMemory);
-
-    void *data;
-    vkMapMemory(helloVulkanDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), static_cast<uint32_t>(bufferSize));
-    vkUnmapMemory(helloVulkanDevice.device(), vertexBufferMemory);
+  Model::~Model() {
+    // frames in flight may still draw it
+    pool.releaseDeferred(range);
   }
 
   void Model::bind(VkCommandBuffer buffer) {
-    VkBuffer buffers[] = {vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(buffer, 0, 1, buffers, offsets);
+    pool.bind(buffer);
   }
 
-  void Model::draw(VkCommandBuffer buffer) {
-    vkCmdDraw(buffer, vertexCount, 1, 0, 0);
+  void Model::draw(VkCommandBuffer buffer, uint32_t instanceCount) {
+    pool.draw(buffer, range, instanceCount);
   }
 
   std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
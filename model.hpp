@@ -1,5 +1,6 @@
 #pragma once
 
+#include "geometryPool.hpp"
 #include "helloVulkanDevice.hpp"
 #include <cstdint>
 #include <glm/fwd.hpp>
@@ -20,21 +21,25 @@ namespace helloVulkan {
         static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
       };
 
-      Model(HelloVulkanDevice &device, std::vector<Vertex> &vertices);
+      // A handle to the mesh's range in the pool, which must outlive it. Without indices the mesh
+      // is drawn as a plain triangle list.
+      Model(GeometryPool &pool, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices = {});
+      // takes over a range from GeometryPool::reserve that has been filled in place
+      Model(GeometryPool &pool, const GeometryRange &range);
       ~Model();
 
       Model(const Model &) = delete;
       Model &operator=(const Model &) = delete;
 
+      // binds the pool's buffers, every model from the same pool can be drawn after one bind
       void bind(VkCommandBuffer buffer);
-      void draw(VkCommandBuffer buffer);
+      void draw(VkCommandBuffer buffer, uint32_t instanceCount = 1);
 
-    private:
-      void createVertexBuffers(const std::vector<Vertex> &vertices);
-      HelloVulkanDevice& helloVulkanDevice;
-      VkBuffer vertexBuffer;
-      VkDeviceMemory vertexBufferMemory;
-      uint32_t vertexCount;
+      GeometryPool &geometryPool() { return pool; }
+      const GeometryRange &geometryRange() const { return range; }
 
+    private:
+      GeometryPool &pool;
+      GeometryRange range;
   };
 }
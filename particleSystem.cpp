@@ -0,0 +1,389 @@
+#include "particleSystem.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    // matches ParticleState in the particle shaders
+    struct ParticleState {
+      VkDispatchIndirectCommand emitArgs;
+      VkDispatchIndirectCommand simulateArgs;
+      uint32_t emitCount;
+      uint32_t deadCount;
+      // the instance counts are the alive lists' lengths
+      VkDrawIndirectCommand lists[2];
+    };
+    static_assert(sizeof(ParticleState) == 64, "ParticleState has to match the shaders' std430 layout");
+
+    struct ParticlePushConstantData {
+      // xyz position, w speed
+      glm::vec4 emitter;
+      // xyz acceleration, w time step
+      glm::vec4 gravity;
+      float lifetime;
+      uint32_t seed;
+      uint32_t current;
+      uint32_t maxParticles;
+      uint32_t emitRequest;
+    };
+
+    struct ParticleDrawPushConstantData {
+      glm::mat4 transform;
+      float particleSize;
+      float lifetime;
+      uint32_t current;
+      uint32_t maxParticles;
+    };
+
+    // matches local_size_x in particleEmit.comp and particleSimulate.comp
+    constexpr uint32_t PARTICLE_GROUP_SIZE = 64;
+    constexpr uint32_t BINDING_COUNT = 4;
+
+    // additive, unsorted particles mustn't hide each other
+    const DynamicRenderState PARTICLE_RENDER_STATE{VK_CULL_MODE_NONE, VK_TRUE, VK_FALSE, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+  }
+
+  ParticleSystem::ParticleSystem(HelloVulkanDevice &device, const ParticleSystemConfig &config) :
+        device{device},
+        config_{config} {
+    if (config_.maxParticles == 0) {
+      throw std::runtime_error("A particle system needs room for at least one particle");
+    }
+    createBuffers();
+    createDescriptors();
+  }
+
+  ParticleSystem::~ParticleSystem() {
+    beginPipeline.reset();
+    emitPipeline.reset();
+    simulatePipeline.reset();
+    renderPipeline.reset();
+    vkDestroyPipelineLayout(device.device(), computeLayout, nullptr);
+    vkDestroyPipelineLayout(device.device(), renderLayout, nullptr);
+    vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device.device(), setLayout, nullptr);
+    for (auto buffer : {
+          std::make_pair(particleBuffer, particleMemory),
+          std::make_pair(aliveListBuffer, aliveListMemory),
+          std::make_pair(deadListBuffer, deadListMemory),
+          std::make_pair(stateBuffer, stateMemory)}) {
+      vkDestroyBuffer(device.device(), buffer.first, nullptr);
+      device.freeMemory(buffer.second);
+    }
+  }
+
+  void ParticleSystem::createBuffers() {
+    VkDeviceSize indexListSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(config_.maxParticles);
+    device.createBuffer(
+        sizeof(Particle) * static_cast<VkDeviceSize>(config_.maxParticles),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        particleBuffer,
+        particleMemory);
+    device.createBuffer(
+        2 * indexListSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        aliveListBuffer,
+        aliveListMemory);
+    device.createBuffer(
+        indexListSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        deadListBuffer,
+        deadListMemory);
+    device.createBuffer(
+        sizeof(ParticleState),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        stateBuffer,
+        stateMemory);
+
+    // everything starts out dead, the particles themselves are written on emission
+    std::vector<uint32_t> deadList(config_.maxParticles);
+    std::iota(deadList.begin(), deadList.end(), 0u);
+    writeBuffer(deadListBuffer, deadList.data(), indexListSize);
+    ParticleState state{};
+    state.deadCount = config_.maxParticles;
+    for (VkDrawIndirectCommand &list : state.lists) {
+      list.vertexCount = 6;
+    }
+    writeBuffer(stateBuffer, &state, sizeof(state));
+  }
+
+  void ParticleSystem::createDescriptors() {
+    VkDevice vkDevice = device.device();
+    // particles, alive lists, dead list, state. The vertex shader only reads the first two.
+    std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+      bindings[binding].binding = binding;
+      bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[binding].descriptorCount = 1;
+      bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(vkDevice, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create particle descriptor set layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ParticlePushConstantData);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vkDevice, &pipelineLayoutInfo, nullptr, &computeLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create particle compute pipeline layout");
+    }
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.size = sizeof(ParticleDrawPushConstantData);
+    if (vkCreatePipelineLayout(vkDevice, &pipelineLayoutInfo, nullptr, &renderLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create particle render pipeline layout");
+    }
+    beginPipeline = std::make_unique<ComputePipeline>(device, "shaders/particleBegin.comp.spv", computeLayout);
+    emitPipeline = std::make_unique<ComputePipeline>(device, "shaders/particleEmit.comp.spv", computeLayout);
+    simulatePipeline = std::make_unique<ComputePipeline>(device, "shaders/particleSimulate.comp.spv", computeLayout);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = BINDING_COUNT;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(vkDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create particle descriptor pool");
+    }
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &setLayout;
+    if (vkAllocateDescriptorSets(vkDevice, &setInfo, &descriptorSet) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate particle descriptor set");
+    }
+
+    std::array<VkDescriptorBufferInfo, BINDING_COUNT> bufferInfos{};
+    bufferInfos[0] = {particleBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[1] = {aliveListBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[2] = {deadListBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[3] = {stateBuffer, 0, VK_WHOLE_SIZE};
+    std::array<VkWriteDescriptorSet, BINDING_COUNT> writes{};
+    for (uint32_t binding = 0; binding < writes.size(); binding++) {
+      writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[binding].dstSet = descriptorSet;
+      writes[binding].dstBinding = binding;
+      writes[binding].descriptorCount = 1;
+      writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  }
+
+  void ParticleSystem::createRenderPipeline(PipelineRegistry &registry, const PipelineConfigInfo &base) {
+    PipelineConfigInfo config = base;
+    // the quads are built from gl_VertexIndex, the particles come out of the storage buffers
+    config.bindingDescriptions.clear();
+    config.attributeDescriptions.clear();
+    config.pipelineLayout = renderLayout;
+    config.colorBlendAttachment.blendEnable = VK_TRUE;
+    config.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    config.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    config.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    config.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    Pipeline::applyRenderState(device, config, PARTICLE_RENDER_STATE);
+    renderPipeline = registry.acquire("shaders/particle.vert.spv", "shaders/particle.frag.spv", config);
+  }
+
+  void ParticleSystem::barrier(
+        VkCommandBuffer commandBuffer,
+        VkPipelineStageFlags srcStages,
+        VkPipelineStageFlags dstStages,
+        VkAccessFlags dstAccess) {
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+  }
+
+  void ParticleSystem::update(VkCommandBuffer commandBuffer, bool drawBarrier) {
+    PROFILE_FUNCTION();
+    emitAccumulator += static_cast<double>(config_.emitRate) * config_.timeStep;
+    double emitRequest = std::floor(emitAccumulator);
+    emitAccumulator -= emitRequest;
+
+    ParticlePushConstantData push{};
+    push.emitter = glm::vec4{config_.emitterPosition, config_.emitSpeed};
+    push.gravity = glm::vec4{config_.gravity, config_.timeStep};
+    push.lifetime = config_.lifetime;
+    push.seed = updateCount++;
+    push.current = current;
+    push.maxParticles = config_.maxParticles;
+    push.emitRequest = static_cast<uint32_t>(std::min(emitRequest, static_cast<double>(config_.maxParticles)));
+
+    // the previous update's passes and draw, possibly from an earlier command buffer, are done with
+    // the buffers before this one rewrites them
+    barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(
+        commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstantData), &push);
+
+    beginPipeline->bind(commandBuffer);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+    emitPipeline->bind(commandBuffer);
+    vkCmdDispatchIndirect(commandBuffer, stateBuffer, offsetof(ParticleState, emitArgs));
+    barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    simulatePipeline->bind(commandBuffer);
+    vkCmdDispatchIndirect(commandBuffer, stateBuffer, offsetof(ParticleState, simulateArgs));
+    if (drawBarrier) {
+      barrier(
+          commandBuffer,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+    current = 1 - current;
+  }
+
+  void ParticleSystem::draw(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+    PROFILE_FUNCTION();
+    if (!renderPipeline) {
+      throw std::runtime_error("Particle system drawn before createRenderPipeline");
+    }
+    renderPipeline->bind(commandBuffer);
+    renderPipeline->setDynamicState(commandBuffer, extent, PARTICLE_RENDER_STATE);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    ParticleDrawPushConstantData push{};
+    push.transform = config_.transform;
+    push.particleSize = config_.particleSize;
+    push.lifetime = config_.lifetime;
+    push.current = current;
+    push.maxParticles = config_.maxParticles;
+    vkCmdPushConstants(
+        commandBuffer, renderLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawPushConstantData), &push);
+    vkCmdDrawIndirect(
+        commandBuffer,
+        stateBuffer,
+        offsetof(ParticleState, lists) + current * sizeof(VkDrawIndirectCommand),
+        1,
+        sizeof(VkDrawIndirectCommand));
+  }
+
+  void ParticleSystem::writeBuffer(VkBuffer buffer, const void *data, VkDeviceSize size) {
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    device.createBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingMemory);
+    void *mapped;
+    vkMapMemory(device.device(), stagingMemory, 0, size, 0, &mapped);
+    std::memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(device.device(), stagingMemory);
+    device.copyBuffer(stagingBuffer, buffer, size);
+    vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
+    device.freeMemory(stagingMemory);
+  }
+
+  void ParticleSystem::readBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, void *data) {
+    if (size == 0) {
+      return;
+    }
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    device.createBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingMemory);
+
+    VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+    barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy region{};
+    region.srcOffset = offset;
+    region.size = size;
+    vkCmdCopyBuffer(commandBuffer, buffer, stagingBuffer, 1, &region);
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+    device.endSingleTimeCommands(commandBuffer);
+
+    void *mapped;
+    vkMapMemory(device.device(), stagingMemory, 0, size, 0, &mapped);
+    std::memcpy(data, mapped, static_cast<size_t>(size));
+    vkUnmapMemory(device.device(), stagingMemory);
+    vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
+    device.freeMemory(stagingMemory);
+  }
+
+  ParticleCounters ParticleSystem::readCounters() {
+    vkDeviceWaitIdle(device.device());
+    ParticleState state{};
+    readBuffer(stateBuffer, 0, sizeof(state), &state);
+    ParticleCounters counters{};
+    counters.alive = state.lists[current].instanceCount;
+    counters.dead = state.deadCount;
+    counters.emittedLastUpdate = state.emitCount;
+    return counters;
+  }
+
+  std::vector<Particle> ParticleSystem::readAliveParticles() {
+    ParticleCounters counters = readCounters();
+    std::vector<uint32_t> alive(counters.alive);
+    readBuffer(
+        aliveListBuffer,
+        sizeof(uint32_t) * static_cast<VkDeviceSize>(current) * config_.maxParticles,
+        sizeof(uint32_t) * alive.size(),
+        alive.data());
+    std::vector<Particle> particles(config_.maxParticles);
+    readBuffer(particleBuffer, 0, sizeof(Particle) * particles.size(), particles.data());
+
+    std::vector<Particle> aliveParticles;
+    aliveParticles.reserve(alive.size());
+    for (uint32_t index : alive) {
+      aliveParticles.push_back(particles[index]);
+    }
+    return aliveParticles;
+  }
+}
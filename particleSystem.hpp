@@ -0,0 +1,140 @@
+#pragma once
+
+#include "computePipeline.hpp"
+#include "helloVulkanDevice.hpp"
+#include "helloVulkanPipeline.hpp"
+#include "pipelineRegistry.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace helloVulkan {
+
+  struct ParticleSystemConfig {
+    // the default keeps about a million alive, lifetime * emitRate
+    uint32_t maxParticles = 1 << 20;
+    // particles per second, emission stops while every particle is alive
+    float emitRate = 250000.0f;
+    // seconds
+    float lifetime = 4.0f;
+    // a fixed step per update so runs are repeatable
+    float timeStep = 1.0f / 60.0f;
+    glm::vec3 emitterPosition{0.0f, 0.5f, 0.0f};
+    float emitSpeed = 0.8f;
+    // y points down the screen
+    glm::vec3 gravity{0.0f, 0.4f, 0.0f};
+    // half the side of a particle's quad
+    float particleSize = 0.004f;
+    // from particle space to clip space
+    glm::mat4 transform{
+      1.0f, 0.0f, 0.0f, 0.0f,
+      0.0f, 1.0f, 0.0f, 0.0f,
+      0.0f, 0.0f, 0.5f, 0.0f,
+      0.0f, 0.0f, 0.5f, 1.0f
+    };
+  };
+
+  // matches Particle in the particle shaders
+  struct Particle {
+    // w is the age in seconds
+    glm::vec4 position;
+    glm::vec4 velocity;
+  };
+
+  // read back by readCounters(), the renderer itself never reads anything back
+  struct ParticleCounters {
+    uint32_t alive = 0;
+    uint32_t dead = 0;
+    uint32_t emittedLastUpdate = 0;
+  };
+
+  // Particles live in storage buffers and never leave the GPU. Every update is three compute passes
+  // recorded into the frame's command buffer, outside the render pass:
+  //   particleBegin.comp     one invocation, clamps the emission to the dead list and writes the
+  //                          indirect dispatch sizes for the other two passes
+  //   particleEmit.comp      pops indices off the dead list and appends them to this update's
+  //                          alive list
+  //   particleSimulate.comp  integrates the alive list, pushing expired particles back onto the
+  //                          dead list and compacting the survivors into the other alive list
+  // The survivors' count is the instance count of an indirect draw of one quad per particle, the
+  // vertex shader reads the particle through the alive list.
+  class ParticleSystem {
+    public:
+      ParticleSystem(HelloVulkanDevice &device, const ParticleSystemConfig &config);
+      ~ParticleSystem();
+
+      ParticleSystem(const ParticleSystem &) = delete;
+      ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+      // base carries the render pass or attachment formats, the particles bring their own layout,
+      // vertex input and blending. Call again whenever those change.
+      void createRenderPipeline(PipelineRegistry &registry, const PipelineConfigInfo &base);
+
+      // records one time step, outside a render pass. drawBarrier false leaves out the barrier in
+      // front of the draw, for when a RenderGraph orders the two.
+      void update(VkCommandBuffer commandBuffer, bool drawBarrier = true);
+      // inside the render pass, after update
+      void draw(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+      // For tests and benchmarks: waits for the device, then copies the counters, or the alive
+      // particles in no particular order, back to the host
+      ParticleCounters readCounters();
+      std::vector<Particle> readAliveParticles();
+
+      const ParticleSystemConfig &config() const { return config_; }
+      // what update writes, the draw reads the particles and alive lists in the vertex shader and
+      // the state as its indirect arguments
+      VkBuffer getParticleBuffer() const { return particleBuffer; }
+      VkBuffer getAliveListBuffer() const { return aliveListBuffer; }
+      VkBuffer getDeadListBuffer() const { return deadListBuffer; }
+      VkBuffer getStateBuffer() const { return stateBuffer; }
+
+    private:
+      void createBuffers();
+      void createDescriptors();
+      // through a staging buffer, on the graphics queue and waiting for it
+      void writeBuffer(VkBuffer buffer, const void *data, VkDeviceSize size);
+      void readBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, void *data);
+      // makes compute shader writes visible to the dst stages
+      void barrier(
+          VkCommandBuffer commandBuffer,
+          VkPipelineStageFlags srcStages,
+          VkPipelineStageFlags dstStages,
+          VkAccessFlags dstAccess);
+
+      HelloVulkanDevice &device;
+      ParticleSystemConfig config_;
+
+      VkBuffer particleBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory particleMemory = VK_NULL_HANDLE;
+      // two lists of maxParticles indices, updates alternate between them
+      VkBuffer aliveListBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory aliveListMemory = VK_NULL_HANDLE;
+      VkBuffer deadListBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory deadListMemory = VK_NULL_HANDLE;
+      // counters and indirect arguments, ParticleState in the shaders
+      VkBuffer stateBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory stateMemory = VK_NULL_HANDLE;
+
+      VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+      VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+      VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+      VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+      VkPipelineLayout renderLayout = VK_NULL_HANDLE;
+      std::unique_ptr<ComputePipeline> beginPipeline;
+      std::unique_ptr<ComputePipeline> emitPipeline;
+      std::unique_ptr<ComputePipeline> simulatePipeline;
+      std::shared_ptr<Pipeline> renderPipeline;
+
+      // the alive list the last update wrote, drawn now and read by the next update
+      uint32_t current = 0;
+      uint32_t updateCount = 0;
+      // fractional particles carried over to the next update
+      double emitAccumulator = 0.0;
+  };
+}
@@ -0,0 +1,185 @@
+#include "physicalDeviceSelection.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    int64_t typeScore(VkPhysicalDeviceType type) {
+      switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 100000;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 50000;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 40000;
+        case VK_PHYSICAL_DEVICE_TYPE_OTHER: return 10000;
+        // software rasterisers like llvmpipe, only when there is nothing else
+        default: return 0;
+      }
+    }
+
+    std::string lowercase(std::string text) {
+      std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+      return text;
+    }
+
+    std::string hexDigits(const std::string &text) {
+      std::string digits;
+      for (char c : lowercase(text)) {
+        if (c != '-') {
+          digits.push_back(c);
+        }
+      }
+      return digits;
+    }
+
+    bool isUuid(const std::string &digits) {
+      return digits.size() == 2 * VK_UUID_SIZE &&
+          std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isxdigit(c); });
+    }
+
+    bool isIndex(const std::string &text) {
+      return !text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); });
+    }
+  }
+
+  bool PhysicalDeviceInfo::hasExtension(const char *extensionName) const {
+    return std::find(extensions.begin(), extensions.end(), extensionName) != extensions.end();
+  }
+
+  int64_t scorePhysicalDevice(const PhysicalDeviceInfo &info) {
+    if (!info.meetsRequirements) {
+      return -1;
+    }
+    int64_t score = typeScore(info.type);
+    // a point per 64MiB up to 64GiB, never enough to outweigh the device type
+    score += static_cast<int64_t>(std::min<VkDeviceSize>(info.deviceLocalBytes >> 26, 1024));
+    score += info.dedicatedComputeQueue ? 500 : 0;
+    score += info.dedicatedTransferQueue ? 500 : 0;
+    score += 100 * VK_VERSION_MINOR(info.apiVersion);
+
+    bool compressedTextures = info.features.textureCompressionBC || info.features.textureCompressionETC2 ||
+        info.features.textureCompressionASTC_LDR;
+    score += compressedTextures ? 100 : 0;
+    score += info.features.pipelineStatisticsQuery ? 50 : 0;
+    score += info.hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ? 200 : 0;
+    score += info.hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) ? 200 : 0;
+    score += info.hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) ? 100 : 0;
+    return score;
+  }
+
+  size_t selectPhysicalDevice(const std::vector<PhysicalDeviceInfo> &devices, const std::string &preference) {
+    std::vector<size_t> candidates;
+    if (preference.empty()) {
+      for (size_t i = 0; i < devices.size(); i++) {
+        candidates.push_back(i);
+      }
+    } else if (isUuid(hexDigits(preference))) {
+      // before the index, a UUID without dashes can be all decimal digits
+      std::string digits = hexDigits(preference);
+      for (size_t i = 0; i < devices.size(); i++) {
+        if (hexDigits(formatUuid(devices[i].uuid)) == digits) {
+          candidates.push_back(i);
+        }
+      }
+      if (candidates.empty()) {
+        throw std::runtime_error("no physical device with UUID " + preference);
+      }
+    } else if (isIndex(preference)) {
+      size_t index = devices.size();
+      try {
+        index = std::stoul(preference);
+      } catch (const std::out_of_range &) {
+      }
+      if (index >= devices.size()) {
+        throw std::runtime_error("no physical device with index " + preference);
+      }
+      candidates.push_back(index);
+    } else {
+      for (size_t i = 0; i < devices.size(); i++) {
+        if (lowercase(devices[i].name).find(lowercase(preference)) != std::string::npos) {
+          candidates.push_back(i);
+        }
+      }
+      if (candidates.empty()) {
+        throw std::runtime_error("no physical device matches " + preference);
+      }
+    }
+
+    size_t best = devices.size();
+    int64_t bestScore = -1;
+    for (size_t candidate : candidates) {
+      int64_t score = scorePhysicalDevice(devices[candidate]);
+      if (score > bestScore) {
+        best = candidate;
+        bestScore = score;
+      }
+    }
+    if (best == devices.size()) {
+      throw std::runtime_error(preference.empty()
+          ? "failed to find a suitable GPU!"
+          : "the physical device matching " + preference + " isn't suitable");
+    }
+    return best;
+  }
+
+  std::string formatUuid(const std::array<uint8_t, VK_UUID_SIZE> &uuid) {
+    std::string text;
+    for (size_t i = 0; i < uuid.size(); i++) {
+      if (i == 4 || i == 6 || i == 8 || i == 10) {
+        text.push_back('-');
+      }
+      char byte[3];
+      std::snprintf(byte, sizeof(byte), "%02x", uuid[i]);
+      text += byte;
+    }
+    return text;
+  }
+
+  const char *physicalDeviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+      case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+      case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+      case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+      case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+      default: return "other";
+    }
+  }
+
+  DeviceCapabilities DeviceCapabilities::from(const PhysicalDeviceInfo &info) {
+    DeviceCapabilities capabilities{};
+    capabilities.name = info.name;
+    capabilities.type = info.type;
+    capabilities.apiVersion = info.apiVersion;
+    capabilities.uuid = formatUuid(info.uuid);
+    capabilities.deviceLocalBytes = info.deviceLocalBytes;
+    capabilities.dedicatedTransferQueue = info.dedicatedTransferQueue;
+    capabilities.dedicatedComputeQueue = info.dedicatedComputeQueue;
+    capabilities.textureCompressionBC = info.features.textureCompressionBC;
+    capabilities.textureCompressionETC2 = info.features.textureCompressionETC2;
+    capabilities.textureCompressionASTC = info.features.textureCompressionASTC_LDR;
+    capabilities.pipelineStatisticsQuery = info.features.pipelineStatisticsQuery;
+    capabilities.score = scorePhysicalDevice(info);
+    return capabilities;
+  }
+
+  std::string DeviceCapabilities::describe() const {
+    auto yesNo = [](bool value) { return value ? "yes" : "no"; };
+    std::ostringstream text;
+    text << "physical device: " << name << " (" << physicalDeviceTypeName(type) << ", score " << score << ")\n"
+         << "  api " << VK_VERSION_MAJOR(apiVersion) << "." << VK_VERSION_MINOR(apiVersion)
+         << ", uuid " << uuid << "\n"
+         << "  device local memory " << (deviceLocalBytes >> 20) << "MiB\n"
+         << "  dedicated transfer queue " << yesNo(dedicatedTransferQueue)
+         << ", dedicated compute queue " << yesNo(dedicatedComputeQueue) << "\n"
+         << "  texture compression bc " << yesNo(textureCompressionBC) << ", etc2 " << yesNo(textureCompressionETC2)
+         << ", astc " << yesNo(textureCompressionASTC) << "\n"
+         << "  pipeline statistics " << yesNo(pipelineStatisticsQuery)
+         << ", extended dynamic state " << yesNo(extendedDynamicState)
+         << ", dynamic rendering " << yesNo(dynamicRendering)
+         << ", memory budget " << yesNo(memoryBudget);
+    return text.str();
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // What device selection looks at. HelloVulkanDevice gathers it from the driver, it can also be
+  // built by hand to check the selection against device lists this machine doesn't have.
+  struct PhysicalDeviceInfo {
+    std::string name;
+    VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t apiVersion = 0;
+    // all zero when VK_KHR_get_physical_device_properties2 isn't available
+    std::array<uint8_t, VK_UUID_SIZE> uuid{};
+    // largest device local heap
+    VkDeviceSize deviceLocalBytes = 0;
+    // graphics and present queues, the swap chain and everything else the renderer can't do without
+    bool meetsRequirements = false;
+    // families with transfer or compute but no graphics, work on them can overlap the graphics queue
+    bool dedicatedTransferQueue = false;
+    bool dedicatedComputeQueue = false;
+    VkPhysicalDeviceFeatures features{};
+    std::vector<std::string> extensions;
+
+    bool hasExtension(const char *extensionName) const;
+  };
+
+  // The selected device and what it can do, logged at startup so other subsystems can pick their
+  // paths from it
+  struct DeviceCapabilities {
+    std::string name;
+    VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t apiVersion = 0;
+    std::string uuid;
+    VkDeviceSize deviceLocalBytes = 0;
+    bool dedicatedTransferQueue = false;
+    bool dedicatedComputeQueue = false;
+    bool textureCompressionBC = false;
+    bool textureCompressionETC2 = false;
+    bool textureCompressionASTC = false;
+    bool pipelineStatisticsQuery = false;
+    // true once enabled on the logical device, not just supported
+    bool extendedDynamicState = false;
+    bool dynamicRendering = false;
+    bool memoryBudget = false;
+    int64_t score = 0;
+
+    static DeviceCapabilities from(const PhysicalDeviceInfo &info);
+    std::string describe() const;
+  };
+
+  // higher is better, negative when the device doesn't meet the requirements. Device type dominates,
+  // then memory, dedicated queues and optional features break ties between devices of a type.
+  int64_t scorePhysicalDevice(const PhysicalDeviceInfo &info);
+
+  // preference is a device index, a UUID (32 hex digits, dashes ignored) or a case insensitive part
+  // of the name. Empty picks the highest score, the first device on a tie. Throws when nothing meets
+  // the requirements or the preference doesn't match a device that does.
+  size_t selectPhysicalDevice(const std::vector<PhysicalDeviceInfo> &devices, const std::string &preference);
+
+  std::string formatUuid(const std::array<uint8_t, VK_UUID_SIZE> &uuid);
+  const char *physicalDeviceTypeName(VkPhysicalDeviceType type);
+}
@@ -0,0 +1,149 @@
+#include "pipelineRegistry.hpp"
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+namespace helloVulkan {
+
+  PipelineRegistry::PipelineRegistry(HelloVulkanDevice &device) : device{device} {
+    const char *disable = std::getenv("HELLO_VULKAN_DISABLE_PIPELINE_REGISTRY");
+    enabled = disable == nullptr || std::string{disable} != "1";
+  }
+
+  std::shared_ptr<Pipeline> PipelineRegistry::acquire(
+        const std::string &vertFilePath,
+        const std::string &fragFilePath,
+        const PipelineConfigInfo &config) {
+    PROFILE_FUNCTION();
+    stats_.requests++;
+    auto creationStart = std::chrono::steady_clock::now();
+
+    std::shared_ptr<Pipeline> pipeline;
+    if (enabled) {
+      // embedded shaders make this a lookup, with HELLO_VULKAN_SHADER_DIR set it rereads the files
+      // so edited shaders get new pipelines
+      ShaderCode vert = ShaderLibrary::load(vertFilePath);
+      ShaderCode frag = ShaderLibrary::load(fragFilePath);
+      std::vector<uint8_t> key;
+      appendValue(key, vert.sizeInBytes());
+      appendBytes(key, vert.words, vert.sizeInBytes());
+      appendValue(key, frag.sizeInBytes());
+      appendBytes(key, frag.words, frag.sizeInBytes());
+      appendConfigKey(config, key);
+      uint64_t hash = hashBytes(key.data(), key.size());
+
+      auto range = pipelines.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.key == key && (pipeline = it->second.pipeline.lock())) {
+          stats_.hits++;
+          return pipeline;
+        }
+      }
+      eraseExpired();
+      pipeline = std::make_shared<Pipeline>(device, vert, frag, config);
+      pipelines.emplace(hash, Entry{std::move(key), config.renderPass, pipeline});
+    } else {
+      pipeline = std::make_shared<Pipeline>(device, vertFilePath, fragFilePath, config);
+    }
+
+    stats_.pipelinesCreated++;
+    stats_.creationMs += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - creationStart).count();
+    return pipeline;
+  }
+
+  void PipelineRegistry::eraseExpired() {
+    for (auto it = pipelines.begin(); it != pipelines.end();) {
+      it = it->second.pipeline.expired() ? pipelines.erase(it) : std::next(it);
+    }
+  }
+
+  void PipelineRegistry::forgetRenderPass(VkRenderPass renderPass) {
+    // dynamic rendering pipelines have no render pass to be confused by
+    if (renderPass == VK_NULL_HANDLE) {
+      return;
+    }
+    for (auto it = pipelines.begin(); it != pipelines.end();) {
+      it = it->second.renderPass == renderPass ? pipelines.erase(it) : std::next(it);
+    }
+  }
+
+  PipelineRegistryStats PipelineRegistry::stats() const {
+    PipelineRegistryStats stats = stats_;
+    stats.livePipelines = 0;
+    for (const auto &entry : pipelines) {
+      if (!entry.second.pipeline.expired()) {
+        stats.livePipelines++;
+      }
+    }
+    if (stats.pipelinesCreated > 0) {
+      stats.estimatedMsSaved = stats.hits * (stats.creationMs / stats.pipelinesCreated);
+    }
+    return stats;
+  }
+
+  void PipelineRegistry::appendConfigKey(const PipelineConfigInfo &config, std::vector<uint8_t> &key) {
+    // these are plain 32 bit fields with no padding, so copying the whole struct is safe
+    appendValue(key, config.bindingDescriptions.size());
+    for (const auto &binding : config.bindingDescriptions) {
+      appendValue(key, binding);
+    }
+    appendValue(key, config.attributeDescriptions.size());
+    for (const auto &attribute : config.attributeDescriptions) {
+      appendValue(key, attribute);
+    }
+    appendValue(key, config.dynamicStateEnables.size());
+    for (VkDynamicState state : config.dynamicStateEnables) {
+      appendValue(key, state);
+    }
+
+    appendValue(key, config.inputAssemblyInfo.topology);
+    appendValue(key, config.inputAssemblyInfo.primitiveRestartEnable);
+
+    const auto &rasterization = config.rasterizationInfo;
+    appendValue(key, rasterization.depthClampEnable);
+    appendValue(key, rasterization.rasterizerDiscardEnable);
+    appendValue(key, rasterization.polygonMode);
+    appendValue(key, rasterization.cullMode);
+    appendValue(key, rasterization.frontFace);
+    appendValue(key, rasterization.depthBiasEnable);
+    appendValue(key, rasterization.depthBiasConstantFactor);
+    appendValue(key, rasterization.depthBiasClamp);
+    appendValue(key, rasterization.depthBiasSlopeFactor);
+    appendValue(key, rasterization.lineWidth);
+
+    const auto &multisample = config.multisampleInfo;
+    appendValue(key, multisample.rasterizationSamples);
+    appendValue(key, multisample.sampleShadingEnable);
+    appendValue(key, multisample.minSampleShading);
+    appendValue(key, multisample.alphaToCoverageEnable);
+    appendValue(key, multisample.alphaToOneEnable);
+
+    appendValue(key, config.colorBlendAttachment);
+    appendValue(key, config.colorBlendInfo.logicOpEnable);
+    appendValue(key, config.colorBlendInfo.logicOp);
+    appendValue(key, config.colorBlendInfo.blendConstants);
+
+    const auto &depthStencil = config.depthStencilInfo;
+    appendValue(key, depthStencil.depthTestEnable);
+    appendValue(key, depthStencil.depthWriteEnable);
+    appendValue(key, depthStencil.depthCompareOp);
+    appendValue(key, depthStencil.depthBoundsTestEnable);
+    appendValue(key, depthStencil.stencilTestEnable);
+    appendValue(key, depthStencil.front);
+    appendValue(key, depthStencil.back);
+    appendValue(key, depthStencil.minDepthBounds);
+    appendValue(key, depthStencil.maxDepthBounds);
+
+    appendValue(key, config.pipelineLayout);
+    appendValue(key, config.renderPass);
+    appendValue(key, config.subpass);
+    appendValue(key, config.colorAttachmentFormat);
+    appendValue(key, config.depthAttachmentFormat);
+    config.vertexSpecialization.appendKey(key);
+    config.fragmentSpecialization.appendKey(key);
+  }
+}
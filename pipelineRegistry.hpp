@@ -0,0 +1,69 @@
+#pragma once
+
+#include "hashing.hpp"
+#include "helloVulkanDevice.hpp"
+#include "helloVulkanPipeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace helloVulkan {
+
+  struct PipelineRegistryStats {
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t pipelinesCreated = 0;
+    size_t livePipelines = 0;
+    double creationMs = 0.0;
+    // hits times the mean creation time, roughly what building a pipeline per request would have cost
+    double estimatedMsSaved = 0.0;
+  };
+
+  // Hands out shared pipelines keyed by the SPIR-V and the pipeline state, so materials with the
+  // same shaders and state end up on the same VkPipeline. The key is kept in full and compared on
+  // every hit, its hash only picks the bucket. Only weak references are kept, a pipeline is
+  // destroyed when the last material using it lets go of it and its entry goes with the next miss.
+  //
+  // The key holds the render pass and pipeline layout handles, which Vulkan may hand out again
+  // once they are destroyed. Whoever destroys a render pass calls forgetRenderPass() so a new one
+  // that gets the same handle can't be matched with pipelines built for the old one.
+  //
+  // HELLO_VULKAN_DISABLE_PIPELINE_REGISTRY=1 builds a new pipeline for every request instead, to
+  // compare against.
+  class PipelineRegistry {
+    public:
+      explicit PipelineRegistry(HelloVulkanDevice &device);
+
+      PipelineRegistry(const PipelineRegistry &) = delete;
+      PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+      std::shared_ptr<Pipeline> acquire(
+          const std::string &vertFilePath,
+          const std::string &fragFilePath,
+          const PipelineConfigInfo &config);
+      // drops the entries built for renderPass, pipelines already handed out stay valid
+      void forgetRenderPass(VkRenderPass renderPass);
+      PipelineRegistryStats stats() const;
+
+      // appends the state that ends up in the VkPipeline, skipping sTypes and pointers
+      static void appendConfigKey(const PipelineConfigInfo &config, std::vector<uint8_t> &key);
+
+    private:
+      struct Entry {
+        std::vector<uint8_t> key;
+        VkRenderPass renderPass;
+        std::weak_ptr<Pipeline> pipeline;
+      };
+
+      void eraseExpired();
+
+      HelloVulkanDevice &device;
+      bool enabled = true;
+      std::unordered_multimap<uint64_t, Entry> pipelines;
+      PipelineRegistryStats stats_;
+  };
+}
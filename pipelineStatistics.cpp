@@ -0,0 +1,96 @@
+#include "pipelineStatistics.hpp"
+
+#include <array>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    // keep in the same order as the fields of PipelineStatisticsResult, results come back sorted
+    // by bit position
+    constexpr VkQueryPipelineStatisticFlags STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    constexpr size_t STATISTIC_COUNT = 6;
+  }
+
+  PipelineStatistics::PipelineStatistics(HelloVulkanDevice &device, uint32_t slotCount)
+      : helloVulkanDevice{device}, slotRecorded(slotCount, false) {
+    if (!device.enabledFeatures().pipelineStatisticsQuery) {
+      return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = slotCount;
+    queryPoolInfo.pipelineStatistics = STATISTICS;
+    if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create pipeline statistics query pool");
+    }
+  }
+
+  PipelineStatistics::~PipelineStatistics() {
+    if (queryPool != VK_NULL_HANDLE) {
+      // replaced on swap chain recreation while command buffers still in flight use the pool
+      VkDevice device = helloVulkanDevice.device();
+      VkQueryPool retiredPool = queryPool;
+      helloVulkanDevice.deferDestruction([device, retiredPool] { vkDestroyQueryPool(device, retiredPool, nullptr); });
+    }
+  }
+
+  void PipelineStatistics::reset(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (!enabled()) return;
+    collect(slot);
+    vkCmdResetQueryPool(commandBuffer, queryPool, slot, 1);
+    slotRecorded[slot] = true;
+  }
+
+  void PipelineStatistics::begin(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (!enabled()) return;
+    vkCmdBeginQuery(commandBuffer, queryPool, slot, 0);
+  }
+
+  void PipelineStatistics::end(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (!enabled()) return;
+    vkCmdEndQuery(commandBuffer, queryPool, slot);
+  }
+
+  bool PipelineStatistics::latest(PipelineStatisticsResult &result) const {
+    if (hasResult) {
+      result = latestResult;
+    }
+    return hasResult;
+  }
+
+  void PipelineStatistics::collect(uint32_t slot) {
+    if (!slotRecorded[slot]) return;
+
+    // the statistics followed by the availability word
+    std::array<uint64_t, STATISTIC_COUNT + 1> values{};
+    VkResult result = vkGetQueryPoolResults(
+        helloVulkanDevice.device(),
+        queryPool,
+        slot,
+        1,
+        sizeof(values),
+        values.data(),
+        sizeof(values),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((result != VK_SUCCESS && result != VK_NOT_READY) || values[STATISTIC_COUNT] == 0) {
+      return;
+    }
+
+    latestResult.inputAssemblyVertices = values[0];
+    latestResult.inputAssemblyPrimitives = values[1];
+    latestResult.vertexShaderInvocations = values[2];
+    latestResult.clippingInvocations = values[3];
+    latestResult.clippingPrimitives = values[4];
+    latestResult.fragmentShaderInvocations = values[5];
+    hasResult = true;
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  struct PipelineStatisticsResult {
+    uint64_t inputAssemblyVertices = 0;
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+  };
+
+  // Wraps VK_QUERY_TYPE_PIPELINE_STATISTICS queries, one query slot per command buffer. Results
+  // are read back without waiting when a slot is about to be reused, so the numbers lag a few
+  // frames behind. Does nothing when the device has no pipelineStatisticsQuery feature.
+  class PipelineStatistics {
+    public:
+      PipelineStatistics(HelloVulkanDevice &device, uint32_t slotCount);
+      ~PipelineStatistics();
+
+      PipelineStatistics(const PipelineStatistics &) = delete;
+      PipelineStatistics &operator=(const PipelineStatistics &) = delete;
+
+      bool enabled() { return queryPool != VK_NULL_HANDLE; }
+
+      // Outside a render pass: collect the slot's previous result, then reset it for this frame.
+      void reset(VkCommandBuffer commandBuffer, uint32_t slot);
+      void begin(VkCommandBuffer commandBuffer, uint32_t slot);
+      void end(VkCommandBuffer commandBuffer, uint32_t slot);
+
+      // most recent frame that has finished on the GPU, false until the first one is available
+      bool latest(PipelineStatisticsResult &result) const;
+
+    private:
+      void collect(uint32_t slot);
+
+      HelloVulkanDevice &helloVulkanDevice;
+      VkQueryPool queryPool = VK_NULL_HANDLE;
+      std::vector<bool> slotRecorded;
+      PipelineStatisticsResult latestResult;
+      bool hasResult = false;
+  };
+}
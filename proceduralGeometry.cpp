@@ -0,0 +1,316 @@
+#include "proceduralGeometry.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace helloVulkan {
+
+  namespace {
+    const std::array<glm::vec3, 3> TRIANGLE_CORNERS = {
+      glm::vec3{-0.5f, 0.5f, 0.0f},
+      glm::vec3{0.5f, 0.5f, 0.0f},
+      glm::vec3{0.0f, -0.5f, 0.0f},
+    };
+    // alternate corners of the [-0.5, 0.5] cube
+    const std::array<glm::vec3, 4> TETRAHEDRON_CORNERS = {
+      glm::vec3{0.5f, 0.5f, 0.5f},
+      glm::vec3{0.5f, -0.5f, -0.5f},
+      glm::vec3{-0.5f, 0.5f, -0.5f},
+      glm::vec3{-0.5f, -0.5f, 0.5f},
+    };
+    const std::array<std::array<uint32_t, 3>, 4> TETRAHEDRON_FACES = {{
+      {0, 1, 2},
+      {0, 3, 1},
+      {0, 2, 3},
+      {1, 3, 2},
+    }};
+    // one per top level part, mixed with the desc's colour
+    const std::array<glm::vec3, 4> PALETTE = {
+      glm::vec3{1.0f, 0.2f, 0.2f},
+      glm::vec3{0.2f, 1.0f, 0.2f},
+      glm::vec3{0.2f, 0.4f, 1.0f},
+      glm::vec3{1.0f, 1.0f, 0.2f},
+    };
+    constexpr float PI = 3.14159265358979f;
+
+    // The leaf's path from the root is its index's base-n digits, most significant first. Each
+    // level halves towards the corner its digit picks, so working from the least significant digit
+    // up the leaf is corner * scale + offset.
+    void sierpinskiLeaf(
+          uint64_t index,
+          uint32_t depth,
+          const glm::vec3 *corners,
+          uint32_t cornerCount,
+          const glm::vec3 &baseColour,
+          float &scale,
+          glm::vec3 &offset,
+          glm::vec3 &colour) {
+      scale = 1.0f;
+      offset = glm::vec3{0.0f};
+      uint32_t digit = 0;
+      for (uint32_t level = 0; level < depth; level++) {
+        digit = static_cast<uint32_t>(index % cornerCount);
+        index /= cornerCount;
+        scale *= 0.5f;
+        offset = 0.5f * (offset + corners[digit]);
+      }
+      colour = depth == 0 ? baseColour : 0.5f * (baseColour + PALETTE[digit]);
+    }
+
+    glm::vec3 spherePoint(uint32_t band, uint32_t segment, uint32_t resolution) {
+      float theta = PI * band / resolution;
+      float phi = PI * segment / resolution;
+      return 0.5f * glm::vec3{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+    }
+
+    Model::Vertex vertex(const glm::vec3 &position, const glm::vec3 &colour) {
+      return {{position, 1.0f}, colour};
+    }
+  }
+
+  uint64_t proceduralPrimitiveCount(const ProceduralDesc &desc) {
+    uint64_t count = 1;
+    switch (desc.shape) {
+      case ProceduralShape::sierpinskiTriangle:
+      case ProceduralShape::sierpinskiTetrahedron: {
+        uint64_t base = desc.shape == ProceduralShape::sierpinskiTriangle ? 3 : 4;
+        for (uint32_t level = 0; level < desc.depth; level++) {
+          if (count > UINT32_MAX) {
+            break;
+          }
+          count *= base;
+        }
+        return count;
+      }
+      case ProceduralShape::grid:
+        return static_cast<uint64_t>(desc.resolution) * desc.resolution;
+      case ProceduralShape::sphere:
+        return 2 * static_cast<uint64_t>(desc.resolution) * desc.resolution;
+    }
+    return 0;
+  }
+
+  uint32_t proceduralVerticesPerPrimitive(ProceduralShape shape) {
+    switch (shape) {
+      case ProceduralShape::sierpinskiTriangle: return 3;
+      case ProceduralShape::sierpinskiTetrahedron: return 12;
+      default: return 6;
+    }
+  }
+
+  uint32_t proceduralVertexCount(const ProceduralDesc &desc) {
+    uint64_t count = proceduralPrimitiveCount(desc) * proceduralVerticesPerPrimitive(desc.shape);
+    if (count >= UINT32_MAX) {
+      throw std::runtime_error("Procedural mesh of depth " + std::to_string(desc.depth) + " and resolution " +
+          std::to_string(desc.resolution) + " has too many vertices");
+    }
+    return static_cast<uint32_t>(count);
+  }
+
+  void generateProceduralPrimitives(const ProceduralDesc &desc, Model::Vertex *out, uint64_t first, uint64_t count) {
+    uint32_t resolution = std::max(desc.resolution, 1u);
+    for (uint64_t primitive = first; primitive < first + count; primitive++) {
+      switch (desc.shape) {
+        case ProceduralShape::sierpinskiTriangle: {
+          float scale;
+          glm::vec3 offset;
+          glm::vec3 colour;
+          sierpinskiLeaf(primitive, desc.depth, TRIANGLE_CORNERS.data(), 3, desc.colour, scale, offset, colour);
+          for (const glm::vec3 &corner : TRIANGLE_CORNERS) {
+            *out++ = vertex(corner * scale + offset, colour);
+          }
+          break;
+        }
+        case ProceduralShape::sierpinskiTetrahedron: {
+          float scale;
+          glm::vec3 offset;
+          glm::vec3 colour;
+          sierpinskiLeaf(primitive, desc.depth, TETRAHEDRON_CORNERS.data(), 4, desc.colour, scale, offset, colour);
+          for (const auto &face : TETRAHEDRON_FACES) {
+            for (uint32_t corner : face) {
+              *out++ = vertex(TETRAHEDRON_CORNERS[corner] * scale + offset, colour);
+            }
+          }
+          break;
+        }
+        case ProceduralShape::grid: {
+          float size = 1.0f / resolution;
+          float x = -0.5f + (primitive % resolution) * size;
+          float y = -0.5f + (primitive / resolution) * size;
+          glm::vec3 a{x, y, 0.0f};
+          glm::vec3 b{x + size, y, 0.0f};
+          glm::vec3 c{x + size, y + size, 0.0f};
+          glm::vec3 d{x, y + size, 0.0f};
+          for (const glm::vec3 &position : {a, b, c, a, c, d}) {
+            *out++ = vertex(position, desc.colour);
+          }
+          break;
+        }
+        case ProceduralShape::sphere: {
+          uint32_t band = static_cast<uint32_t>(primitive / (2 * resolution));
+          uint32_t segment = static_cast<uint32_t>(primitive % (2 * resolution));
+          glm::vec3 a = spherePoint(band, segment, resolution);
+          glm::vec3 b = spherePoint(band, segment + 1, resolution);
+          glm::vec3 c = spherePoint(band + 1, segment + 1, resolution);
+          glm::vec3 d = spherePoint(band + 1, segment, resolution);
+          // the normal of a point on a sphere about the origin is its direction
+          for (const glm::vec3 &position : {a, b, c, a, c, d}) {
+            *out++ = vertex(position, position + 0.5f);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  void generateProceduralCpu(const ProceduralDesc &desc, Model::Vertex *out, JobSystem &jobs) {
+    PROFILE_FUNCTION();
+    uint32_t verticesPerPrimitive = proceduralVerticesPerPrimitive(desc.shape);
+    // proceduralVertexCount throws unless this fits 32 bits
+    uint32_t primitiveCount = proceduralVertexCount(desc) / verticesPerPrimitive;
+    // not worth a job below a few thousand primitives
+    jobs.parallelFor(primitiveCount, 4096, [&](uint32_t begin, uint32_t end) {
+      generateProceduralPrimitives(desc, out + static_cast<uint64_t>(begin) * verticesPerPrimitive, begin, end - begin);
+    });
+  }
+
+  struct ProceduralPushConstantData {
+    glm::vec4 colour;
+    uint32_t shape;
+    uint32_t depth;
+    uint32_t resolution;
+    uint32_t firstFloat;
+    uint32_t firstPrimitive;
+    uint32_t primitiveCount;
+  };
+
+  // matches local_size_x in proceduralGeometry.comp
+  constexpr uint32_t PROCEDURAL_GROUP_SIZE = 64;
+
+  ProceduralGpuGenerator::ProceduralGpuGenerator(HelloVulkanDevice &device) : device{device} {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(device.device(), &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create procedural geometry descriptor set layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ProceduralPushConstantData);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create procedural geometry pipeline layout");
+    }
+    pipeline = std::make_unique<ComputePipeline>(device, "shaders/proceduralGeometry.comp.spv", pipelineLayout);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 1;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create procedural geometry descriptor pool");
+    }
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &setLayout;
+    if (vkAllocateDescriptorSets(device.device(), &setInfo, &descriptorSet) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate procedural geometry descriptor set");
+    }
+  }
+
+  ProceduralGpuGenerator::~ProceduralGpuGenerator() {
+    pipeline.reset();
+    vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device.device(), setLayout, nullptr);
+  }
+
+  void ProceduralGpuGenerator::generate(const ProceduralDesc &desc, GeometryPool &pool, const GeometryRange &range) {
+    PROFILE_FUNCTION();
+    if (pool.getVertexStride() != sizeof(Model::Vertex) || range.vertexCount < proceduralVertexCount(desc)) {
+      throw std::runtime_error("Procedural geometry needs a range of Model::Vertex big enough for the mesh");
+    }
+    // binding only the range keeps under maxStorageBufferRange however big the pool is. Strides and
+    // offset alignments are whole floats, so the range starts a whole number of floats in.
+    VkDeviceSize rangeStart = static_cast<VkDeviceSize>(range.firstVertex) * sizeof(Model::Vertex);
+    VkDeviceSize bindingStart = rangeStart - rangeStart % device.properties.limits.minStorageBufferOffsetAlignment;
+    VkDeviceSize bindingSize = rangeStart - bindingStart + static_cast<VkDeviceSize>(range.vertexCount) * sizeof(Model::Vertex);
+    if (bindingSize > device.properties.limits.maxStorageBufferRange) {
+      throw std::runtime_error("Procedural mesh is bigger than the device's largest storage buffer range");
+    }
+    // the previous generate waited for the queue, so the set is free to point elsewhere
+    VkDescriptorBufferInfo bufferInfo{pool.getVertexBuffer(), bindingStart, bindingSize};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+
+    VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+    pipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    ProceduralPushConstantData push{};
+    push.colour = glm::vec4{desc.colour, 1.0f};
+    push.shape = static_cast<uint32_t>(desc.shape);
+    push.depth = desc.depth;
+    push.resolution = std::max(desc.resolution, 1u);
+    push.firstFloat = static_cast<uint32_t>((rangeStart - bindingStart) / sizeof(float));
+    // one invocation per primitive, in as many dispatches as the workgroup count limit needs
+    uint64_t primitiveCount = proceduralPrimitiveCount(desc);
+    uint64_t maxPerDispatch =
+        static_cast<uint64_t>(device.properties.limits.maxComputeWorkGroupCount[0]) * PROCEDURAL_GROUP_SIZE;
+    for (uint64_t first = 0; first < primitiveCount; first += maxPerDispatch) {
+      push.firstPrimitive = static_cast<uint32_t>(first);
+      push.primitiveCount = static_cast<uint32_t>(std::min(maxPerDispatch, primitiveCount - first));
+      vkCmdPushConstants(
+          commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ProceduralPushConstantData), &push);
+      vkCmdDispatch(commandBuffer, ComputePipeline::groupCount(push.primitiveCount, PROCEDURAL_GROUP_SIZE), 1, 1);
+    }
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+    device.endSingleTimeCommands(commandBuffer);
+  }
+}
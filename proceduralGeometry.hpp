@@ -0,0 +1,72 @@
+#pragma once
+
+#include "computePipeline.hpp"
+#include "geometryPool.hpp"
+#include "helloVulkanDevice.hpp"
+#include "jobSystem.hpp"
+#include "model.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  enum class ProceduralShape : uint32_t {
+    // 3^depth triangles
+    sierpinskiTriangle = 0,
+    // 4^depth tetrahedra of 4 triangles each
+    sierpinskiTetrahedron = 1,
+    // resolution x resolution quads in the z = 0 plane
+    grid = 2,
+    // resolution latitude bands of 2 * resolution quads
+    sphere = 3
+  };
+
+  // Every shape fits in [-0.5, 0.5] on each axis and is written as a plain triangle list, no indices
+  struct ProceduralDesc {
+    ProceduralShape shape = ProceduralShape::sierpinskiTriangle;
+    // Sierpinski shapes
+    uint32_t depth = 6;
+    // grids and spheres
+    uint32_t resolution = 64;
+    // the grid's colour, the Sierpinski shapes tint each top level part with it
+    glm::vec3 colour{0.3f, 0.0f, 0.5f};
+  };
+
+  // triangles for the fractals and the tetrahedron's faces, quads for grids and spheres
+  uint64_t proceduralPrimitiveCount(const ProceduralDesc &desc);
+  uint32_t proceduralVerticesPerPrimitive(ProceduralShape shape);
+  // throws when the mesh wouldn't fit 32 bit vertex offsets
+  uint32_t proceduralVertexCount(const ProceduralDesc &desc);
+
+  // Each primitive is worked out from its index alone, so any range can be generated on its own and
+  // ranges can go to different threads. Writes count primitives starting at out.
+  void generateProceduralPrimitives(const ProceduralDesc &desc, Model::Vertex *out, uint64_t first, uint64_t count);
+  // splits the whole mesh over the job system with parallelFor. out is usually mapped upload memory,
+  // e.g. GeometryPool::vertexData, so nothing is staged.
+  void generateProceduralCpu(const ProceduralDesc &desc, Model::Vertex *out, JobSystem &jobs);
+
+  // Generates the same meshes with shaders/proceduralGeometry.comp, straight into a GeometryPool's
+  // vertex buffer, so the vertices never exist on the host
+  class ProceduralGpuGenerator {
+    public:
+      explicit ProceduralGpuGenerator(HelloVulkanDevice &device);
+      ~ProceduralGpuGenerator();
+
+      ProceduralGpuGenerator(const ProceduralGpuGenerator &) = delete;
+      ProceduralGpuGenerator &operator=(const ProceduralGpuGenerator &) = delete;
+
+      // range is a reservation of proceduralVertexCount(desc) vertices. Runs on the graphics queue
+      // and waits for it, the vertices are ready to draw when this returns.
+      void generate(const ProceduralDesc &desc, GeometryPool &pool, const GeometryRange &range);
+
+    private:
+      HelloVulkanDevice &device;
+      VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+      VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+      VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+      VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+      std::unique_ptr<ComputePipeline> pipeline;
+  };
+}
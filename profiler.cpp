@@ -0,0 +1,195 @@
+#include "profiler.hpp"
+#include "logger.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace helloVulkan {
+
+  namespace {
+    // 64k events per thread is a few seconds of history at the current zone density
+    constexpr uint64_t EVENTS_PER_THREAD = 1 << 16;
+    // a slow frame writes one trace, the next waits until frames have been fast again and this
+    // long has passed, so a run of hitches doesn't turn into a trace per frame
+    constexpr uint64_t TRACE_COOLDOWN_NS = 5000000000ull;
+
+    // One ring entry, written only by its thread and read by whoever dumps. sequence is the event's
+    // index + 1 once it's complete and 0 while it's being overwritten, a reader that sees the same
+    // value before and after copying the fields has a consistent event. The fields are relaxed
+    // atomics so the copy is a race the reader detects rather than undefined behaviour.
+    struct EventSlot {
+      std::atomic<uint64_t> sequence{0};
+      std::atomic<const char *> name{nullptr};
+      std::atomic<uint64_t> startNs{0};
+      std::atomic<uint64_t> endNs{0};
+    };
+
+    struct ThreadEvents {
+      uint32_t threadId;
+      std::atomic<uint64_t> writeIndex{0};
+      std::unique_ptr<EventSlot[]> events{new EventSlot[EVENTS_PER_THREAD]};
+    };
+
+    struct ProfilerState {
+      std::mutex registryMutex;
+      std::vector<std::shared_ptr<ThreadEvents>> threads;
+      std::atomic<bool> dumpRequested{false};
+      double frameTimeThresholdMs = 0.0;
+      uint64_t lastFrameNs = 0;
+      uint64_t frameIndex = 0;
+      // the last frame was over the threshold
+      bool overThreshold = false;
+      uint64_t lastThresholdTraceNs = 0;
+      std::string tracePath = "helloVulkanTrace.json";
+
+      ProfilerState() {
+        if (const char *path = std::getenv("HELLO_VULKAN_TRACE_FILE")) {
+          tracePath = path;
+        }
+        if (const char *threshold = std::getenv("HELLO_VULKAN_TRACE_THRESHOLD_MS")) {
+          frameTimeThresholdMs = std::atof(threshold);
+        }
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, [](int) { Profiler::requestDump(); });
+#endif
+      }
+    };
+
+    ProfilerState &state() {
+      static ProfilerState profilerState;
+      return profilerState;
+    }
+
+    ThreadEvents &threadEvents() {
+      // the registry keeps the buffer alive after the thread exits so it still shows up in dumps
+      thread_local std::shared_ptr<ThreadEvents> events = [] {
+        auto created = std::make_shared<ThreadEvents>();
+        ProfilerState &profilerState = state();
+        std::lock_guard<std::mutex> lock{profilerState.registryMutex};
+        created->threadId = static_cast<uint32_t>(profilerState.threads.size());
+        profilerState.threads.push_back(created);
+        return created;
+      }();
+      return *events;
+    }
+  }
+
+  uint64_t Profiler::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  void Profiler::record(const char *name, uint64_t startNs, uint64_t endNs) {
+    ThreadEvents &events = threadEvents();
+    uint64_t index = events.writeIndex.load(std::memory_order_relaxed);
+    EventSlot &slot = events.events[index & (EVENTS_PER_THREAD - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+    events.writeIndex.store(index + 1, std::memory_order_release);
+  }
+
+  void Profiler::requestDump() {
+    state().dumpRequested.store(true, std::memory_order_relaxed);
+  }
+
+  void Profiler::setFrameTimeThreshold(double milliseconds) {
+    state().frameTimeThresholdMs = milliseconds;
+  }
+
+  void Profiler::endFrame() {
+    ProfilerState &profilerState = state();
+    uint64_t frameEndNs = now();
+    if (profilerState.lastFrameNs != 0) {
+      record("frame", profilerState.lastFrameNs, frameEndNs);
+
+      double frameTimeMs = (frameEndNs - profilerState.lastFrameNs) / 1.0e6;
+      bool overThreshold = profilerState.frameTimeThresholdMs > 0.0 && frameTimeMs > profilerState.frameTimeThresholdMs;
+      bool enteredBreach = overThreshold && !profilerState.overThreshold;
+      profilerState.overThreshold = overThreshold;
+      bool cooledDown = profilerState.lastThresholdTraceNs == 0 ||
+          frameEndNs - profilerState.lastThresholdTraceNs >= TRACE_COOLDOWN_NS;
+      if (enteredBreach && cooledDown) {
+        profilerState.lastThresholdTraceNs = frameEndNs;
+        std::string path = profilerState.tracePath;
+        auto extension = path.rfind(".json");
+        path.insert(extension == std::string::npos ? path.size() : extension,
+            "-frame" + std::to_string(profilerState.frameIndex));
+        LogLine{LogSeverity::warning} << "frame " << profilerState.frameIndex << " took " << frameTimeMs
+                                      << "ms, writing trace to " << path;
+        writeChromeTrace(path);
+      }
+    }
+    if (profilerState.dumpRequested.exchange(false, std::memory_order_relaxed)) {
+      writeChromeTrace(profilerState.tracePath);
+    }
+
+    // writing a trace is slow, don't let it count against the next frame
+    profilerState.lastFrameNs = now();
+    profilerState.frameIndex++;
+  }
+
+  bool Profiler::writeChromeTrace(const std::string &path) {
+    ProfilerState &profilerState = state();
+    std::vector<std::shared_ptr<ThreadEvents>> threads;
+    {
+      std::lock_guard<std::mutex> lock{profilerState.registryMutex};
+      threads = profilerState.threads;
+    }
+
+    std::ofstream file{path};
+    if (!file) {
+      LogLine{LogSeverity::error} << "failed to open trace file " << path;
+      return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char line[512];
+    for (const auto &thread : threads) {
+      uint64_t end = thread->writeIndex.load(std::memory_order_acquire);
+      uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+      std::vector<Profiler::Event> copy;
+      copy.reserve(end - begin);
+      for (uint64_t i = begin; i < end; i++) {
+        // the owning thread keeps recording while we copy, skip anything it has moved on to
+        const EventSlot &slot = thread->events[i & (EVENTS_PER_THREAD - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != i + 1) {
+          continue;
+        }
+        Profiler::Event event{
+            slot.name.load(std::memory_order_relaxed),
+            slot.startNs.load(std::memory_order_relaxed),
+            slot.endNs.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == i + 1) {
+          copy.push_back(event);
+        }
+      }
+
+      for (const Profiler::Event &event : copy) {
+        std::snprintf(line, sizeof(line),
+            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",",
+            event.name,
+            thread->threadId,
+            event.startNs / 1000.0,
+            (event.endNs - event.startNs) / 1000.0);
+        file << line;
+        first = false;
+      }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped-zone CPU profiler. Zones are only recorded when the build defines
+// HELLO_VULKAN_PROFILING (make PROFILE=1); otherwise the macros compile to nothing.
+//
+// Each thread appends to its own fixed-size ring of events, so recording a zone is two
+// clock reads and a few stores with no locking. A Chrome trace_event JSON file (loadable in
+// chrome://tracing or ui.perfetto.dev) is written:
+//   - on demand, when the process receives SIGUSR1 or Profiler::requestDump() is called
+//   - when a frame takes longer than HELLO_VULKAN_TRACE_THRESHOLD_MS, once per run of slow
+//     frames and at most every few seconds
+// to the path in HELLO_VULKAN_TRACE_FILE (default helloVulkanTrace.json).
+
+namespace helloVulkan {
+
+  class Profiler {
+    public:
+      struct Event {
+        const char *name;
+        uint64_t startNs;
+        uint64_t endNs;
+      };
+
+      static uint64_t now();
+      static void record(const char *name, uint64_t startNs, uint64_t endNs);
+
+      // Call once per frame from the main loop, checks the frame time threshold and any
+      // pending dump request.
+      static void endFrame();
+      static void requestDump();
+      static void setFrameTimeThreshold(double milliseconds);
+      static bool writeChromeTrace(const std::string &path);
+  };
+
+  class ProfileZone {
+    public:
+      explicit ProfileZone(const char *name) : name{name}, startNs{Profiler::now()} {}
+      ~ProfileZone() { Profiler::record(name, startNs, Profiler::now()); }
+
+      ProfileZone(const ProfileZone &) = delete;
+      ProfileZone &operator=(const ProfileZone &) = delete;
+
+    private:
+      const char *name;
+      uint64_t startNs;
+  };
+}
+
+#ifdef HELLO_VULKAN_PROFILING
+#define HELLO_VULKAN_PROFILE_CONCAT_INNER(a, b) a##b
+#define HELLO_VULKAN_PROFILE_CONCAT(a, b) HELLO_VULKAN_PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) \
+  ::helloVulkan::ProfileZone HELLO_VULKAN_PROFILE_CONCAT(profileZone, __LINE__) { name }
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_FRAME_END() ::helloVulkan::Profiler::endFrame()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#endif
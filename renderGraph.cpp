@@ -0,0 +1,670 @@
+#include "renderGraph.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    struct UsageInfo {
+      VkPipelineStageFlags stages;
+      VkAccessFlags access;
+      VkImageLayout layout;
+      VkImageUsageFlags imageUsage;
+    };
+
+    constexpr VkAccessFlags WRITE_ACCESS =
+        VK_ACCESS_SHADER_WRITE_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT |
+        VK_ACCESS_HOST_WRITE_BIT |
+        VK_ACCESS_MEMORY_WRITE_BIT;
+
+    bool canWrite(RenderGraphUsage usage) {
+      switch (usage) {
+        case RenderGraphUsage::colorAttachment:
+        case RenderGraphUsage::depthAttachment:
+        case RenderGraphUsage::computeStorage:
+        case RenderGraphUsage::vertexStorage:
+        case RenderGraphUsage::transfer:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    UsageInfo usageInfo(RenderGraphUsage usage, bool write) {
+      switch (usage) {
+        case RenderGraphUsage::colorAttachment:
+          return {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            static_cast<VkAccessFlags>(write
+                ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT),
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+        case RenderGraphUsage::depthAttachment:
+          return {
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            static_cast<VkAccessFlags>(write
+                ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT),
+            write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+        case RenderGraphUsage::fragmentSampled:
+          return {
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT };
+        case RenderGraphUsage::computeSampled:
+          return {
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT };
+        case RenderGraphUsage::computeStorage:
+          return {
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            static_cast<VkAccessFlags>(write ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT),
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT };
+        case RenderGraphUsage::vertexStorage:
+          return {
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            static_cast<VkAccessFlags>(write ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT),
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT };
+        case RenderGraphUsage::vertexAttribute:
+          return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+        case RenderGraphUsage::indirect:
+          return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0};
+        case RenderGraphUsage::transfer:
+          return {
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            write ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT,
+            write ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            write ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+        case RenderGraphUsage::present:
+          return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0};
+      }
+      throw std::runtime_error("Unknown render graph usage");
+    }
+
+    VkImageAspectFlags aspectForFormat(VkFormat format) {
+      switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+          return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+          return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+          return VK_IMAGE_ASPECT_COLOR_BIT;
+      }
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+  }
+
+  RenderGraphPass &RenderGraphPass::read(RenderGraphResource resource, RenderGraphUsage usage) {
+    accesses.push_back({resource.index, usage, false, false, VK_IMAGE_LAYOUT_UNDEFINED});
+    return *this;
+  }
+
+  RenderGraphPass &RenderGraphPass::write(RenderGraphResource resource, RenderGraphUsage usage) {
+    if (!canWrite(usage)) {
+      throw std::runtime_error("Render graph pass " + name + " writes through a read only usage");
+    }
+    accesses.push_back({resource.index, usage, true, false, VK_IMAGE_LAYOUT_UNDEFINED});
+    return *this;
+  }
+
+  RenderGraphPass &RenderGraphPass::attachment(
+        RenderGraphResource resource,
+        RenderGraphUsage usage,
+        VkImageLayout finalLayout) {
+    if (usage != RenderGraphUsage::colorAttachment && usage != RenderGraphUsage::depthAttachment) {
+      throw std::runtime_error("Render graph pass " + name + " declares an attachment with a non attachment usage");
+    }
+    accesses.push_back({resource.index, usage, true, true, finalLayout});
+    return *this;
+  }
+
+  RenderGraphPass &RenderGraphPass::sideEffects() {
+    hasSideEffects = true;
+    return *this;
+  }
+
+  RenderGraph::RenderGraph(HelloVulkanDevice &device) : device{device} {
+    const char *disable = std::getenv("HELLO_VULKAN_DISABLE_TRANSIENT_ALIASING");
+    aliasing = disable == nullptr || std::string{disable} != "1";
+  }
+
+  RenderGraph::~RenderGraph() {
+    destroyTransients();
+  }
+
+  void RenderGraph::reset() {
+    resources.clear();
+    passes.clear();
+    batches.clear();
+  }
+
+  RenderGraphResource RenderGraph::importImage(
+        const std::string &name,
+        VkImage image,
+        VkImageAspectFlags aspect,
+        VkImageLayout layout,
+        std::optional<RenderGraphUsage> previousUsage) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.image = image;
+    resource.aspect = aspect;
+    resource.initialLayout = layout;
+    resource.previousUsage = previousUsage;
+    resources.push_back(resource);
+    return {static_cast<uint32_t>(resources.size() - 1)};
+  }
+
+  RenderGraphResource RenderGraph::importBuffer(
+        const std::string &name,
+        VkBuffer buffer,
+        std::optional<RenderGraphUsage> previousUsage) {
+    Resource resource{};
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.previousUsage = previousUsage;
+    resources.push_back(resource);
+    return {static_cast<uint32_t>(resources.size() - 1)};
+  }
+
+  RenderGraphResource RenderGraph::createImage(const std::string &name, const RenderGraphImageDesc &desc) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.transient = true;
+    resource.aspect = aspectForFormat(desc.format);
+    resource.desc = desc;
+    resources.push_back(resource);
+    return {static_cast<uint32_t>(resources.size() - 1)};
+  }
+
+  RenderGraphPass &RenderGraph::addPass(const std::string &name, std::function<void(VkCommandBuffer)> execute) {
+    passes.push_back(RenderGraphPass{name, std::move(execute)});
+    return passes.back();
+  }
+
+  VkImage RenderGraph::image(RenderGraphResource resource) const {
+    const Resource &r = resources.at(resource.index);
+    return r.transient && r.transientIndex != UINT32_MAX ? transients[r.transientIndex].image : r.image;
+  }
+
+  VkImageView RenderGraph::imageView(RenderGraphResource resource) const {
+    const Resource &r = resources.at(resource.index);
+    return r.transient && r.transientIndex != UINT32_MAX ? transients[r.transientIndex].view : VK_NULL_HANDLE;
+  }
+
+  VkBuffer RenderGraph::buffer(RenderGraphResource resource) const {
+    return resources.at(resource.index).buffer;
+  }
+
+  bool RenderGraph::isCulled(const std::string &passName) const {
+    for (const RenderGraphPass &pass : passes) {
+      if (pass.name == passName) {
+        return pass.culled;
+      }
+    }
+    throw std::runtime_error("No render graph pass named " + passName);
+  }
+
+  void RenderGraph::compile() {
+    PROFILE_FUNCTION();
+    for (const RenderGraphPass &pass : passes) {
+      for (const RenderGraphPass::Access &access : pass.accesses) {
+        if (access.resource >= resources.size()) {
+          throw std::runtime_error("Render graph pass " + pass.name + " uses a resource from another graph or frame");
+        }
+      }
+    }
+    RenderGraphStats previous = stats_;
+    stats_ = {};
+    stats_.passes = static_cast<uint32_t>(passes.size());
+    stats_.aliasing = aliasing;
+    // kept from the compile that placed them if createTransients reuses the images
+    stats_.transientBytes = previous.transientBytes;
+    stats_.transientBytesWithoutAliasing = previous.transientBytesWithoutAliasing;
+
+    cullPasses();
+    for (uint32_t p = 0; p < passes.size(); p++) {
+      if (passes[p].culled) {
+        continue;
+      }
+      for (const RenderGraphPass::Access &access : passes[p].accesses) {
+        Resource &resource = resources[access.resource];
+        resource.firstPass = std::min(resource.firstPass, p);
+        resource.lastPass = std::max(resource.lastPass, p);
+        resource.imageUsage |= usageInfo(access.usage, access.write).imageUsage;
+      }
+    }
+    createTransients();
+    buildBarriers();
+  }
+
+  void RenderGraph::cullPasses() {
+    // backwards, a pass lives if it has side effects or writes something imported or something a
+    // live pass after it reads
+    std::vector<bool> needed(resources.size(), false);
+    for (uint32_t p = static_cast<uint32_t>(passes.size()); p-- > 0;) {
+      RenderGraphPass &pass = passes[p];
+      bool live = pass.hasSideEffects;
+      for (const RenderGraphPass::Access &access : pass.accesses) {
+        if (access.write && (!resources[access.resource].transient || needed[access.resource])) {
+          live = true;
+        }
+      }
+      pass.culled = !live;
+      if (!live) {
+        stats_.culledPasses++;
+        continue;
+      }
+      for (const RenderGraphPass::Access &access : pass.accesses) {
+        if (!access.write) {
+          needed[access.resource] = true;
+        }
+      }
+    }
+  }
+
+  void RenderGraph::createTransients() {
+    std::vector<uint32_t> used;
+    for (uint32_t r = 0; r < resources.size(); r++) {
+      if (resources[r].transient && resources[r].firstPass != UINT32_MAX) {
+        used.push_back(r);
+      }
+    }
+    stats_.transientImages = static_cast<uint32_t>(used.size());
+
+    bool unchanged = used.size() == transients.size() && transientsAliased == aliasing;
+    for (uint32_t i = 0; unchanged && i < used.size(); i++) {
+      const Resource &resource = resources[used[i]];
+      const Transient &transient = transients[i];
+      unchanged = transient.desc.format == resource.desc.format &&
+          transient.desc.extent.width == resource.desc.extent.width &&
+          transient.desc.extent.height == resource.desc.extent.height &&
+          transient.usage == resource.imageUsage &&
+          transient.firstPass == resource.firstPass &&
+          transient.lastPass == resource.lastPass;
+    }
+    for (uint32_t i = 0; i < used.size(); i++) {
+      resources[used[i]].transientIndex = i;
+    }
+    if (unchanged) {
+      return;
+    }
+
+    destroyTransients();
+    VkDevice vkDevice = device.device();
+    for (uint32_t r : used) {
+      const Resource &resource = resources[r];
+      Transient transient{};
+      transient.desc = resource.desc;
+      transient.usage = resource.imageUsage;
+      transient.firstPass = resource.firstPass;
+      transient.lastPass = resource.lastPass;
+
+      VkImageCreateInfo imageInfo{};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.format = resource.desc.format;
+      imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.usage = resource.imageUsage;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      if (vkCreateImage(vkDevice, &imageInfo, nullptr, &transient.image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create render graph image " + resource.name);
+      }
+      vkGetImageMemoryRequirements(vkDevice, transient.image, &transient.requirements);
+      transients.push_back(transient);
+    }
+
+    // Biggest first, each at the lowest offset clear of everything already placed that it would
+    // overlap in time. Only images that take the same memory types share a block.
+    std::vector<uint32_t> order(transients.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return transients[a].requirements.size > transients[b].requirements.size;
+    });
+    auto place = [&](bool alias, std::vector<uint32_t> &blocks, std::vector<VkDeviceSize> &offsets,
+        std::vector<VkMemoryRequirements> &blockRequirements) {
+      blocks.assign(transients.size(), 0);
+      offsets.assign(transients.size(), 0);
+      blockRequirements.clear();
+      std::vector<uint32_t> placed;
+      for (uint32_t t : order) {
+        const Transient &transient = transients[t];
+        uint32_t block = 0;
+        while (block < blockRequirements.size() &&
+            blockRequirements[block].memoryTypeBits != transient.requirements.memoryTypeBits) {
+          block++;
+        }
+        if (block == blockRequirements.size()) {
+          blockRequirements.push_back({0, 1, transient.requirements.memoryTypeBits});
+        }
+
+        std::vector<uint32_t> conflicts;
+        for (uint32_t other : placed) {
+          bool sameTime = !alias ||
+              (transients[other].firstPass <= transient.lastPass && transient.firstPass <= transients[other].lastPass);
+          if (blocks[other] == block && sameTime) {
+            conflicts.push_back(other);
+          }
+        }
+        std::vector<VkDeviceSize> candidates{0};
+        for (uint32_t other : conflicts) {
+          candidates.push_back(alignUp(offsets[other] + transients[other].requirements.size, transient.requirements.alignment));
+        }
+        std::sort(candidates.begin(), candidates.end());
+        VkDeviceSize offset = 0;
+        for (VkDeviceSize candidate : candidates) {
+          bool clear = std::none_of(conflicts.begin(), conflicts.end(), [&](uint32_t other) {
+            return candidate < offsets[other] + transients[other].requirements.size &&
+                offsets[other] < candidate + transient.requirements.size;
+          });
+          if (clear) {
+            offset = candidate;
+            break;
+          }
+        }
+        blocks[t] = block;
+        offsets[t] = offset;
+        blockRequirements[block].size = std::max(blockRequirements[block].size, offset + transient.requirements.size);
+        blockRequirements[block].alignment = std::max(blockRequirements[block].alignment, transient.requirements.alignment);
+        placed.push_back(t);
+      }
+    };
+
+    std::vector<uint32_t> blocks;
+    std::vector<VkDeviceSize> offsets;
+    std::vector<VkMemoryRequirements> blockRequirements;
+    place(false, blocks, offsets, blockRequirements);
+    stats_.transientBytesWithoutAliasing = 0;
+    for (const VkMemoryRequirements &requirements : blockRequirements) {
+      stats_.transientBytesWithoutAliasing += requirements.size;
+    }
+    if (aliasing) {
+      place(true, blocks, offsets, blockRequirements);
+    }
+    stats_.transientBytes = 0;
+    for (const VkMemoryRequirements &requirements : blockRequirements) {
+      stats_.transientBytes += requirements.size;
+      transientMemory.push_back(device.allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    }
+    transientsAliased = aliasing;
+
+    for (uint32_t t = 0; t < transients.size(); t++) {
+      Transient &transient = transients[t];
+      transient.block = blocks[t];
+      transient.offset = offsets[t];
+      if (vkBindImageMemory(vkDevice, transient.image, transientMemory[transient.block], transient.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind render graph image memory");
+      }
+      if ((transient.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT)) == 0) {
+        continue;
+      }
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = transient.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = transient.desc.format;
+      viewInfo.subresourceRange = {aspectForFormat(transient.desc.format), 0, 1, 0, 1};
+      if (vkCreateImageView(vkDevice, &viewInfo, nullptr, &transient.view) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create render graph image view");
+      }
+    }
+  }
+
+  void RenderGraph::destroyTransients() {
+    // the last frame this graph recorded may still be running, the images go in front of the
+    // memory they are bound to
+    for (Transient &transient : transients) {
+      device.deferDestroyImage(transient.image, transient.view, VK_NULL_HANDLE);
+    }
+    transients.clear();
+    HelloVulkanDevice &owner = device;
+    for (VkDeviceMemory memory : transientMemory) {
+      device.deferDestruction([&owner, memory] { owner.freeMemory(memory); });
+    }
+    transientMemory.clear();
+  }
+
+  void RenderGraph::buildBarriers() {
+    // what the last accesses left behind, per resource
+    struct State {
+      VkPipelineStageFlags writeStages = 0;
+      VkAccessFlags writeAccess = 0;
+      // reads since the last write, a write after them only needs an execution dependency
+      VkPipelineStageFlags readStages = 0;
+      // stages and accesses the last write has already been made visible to
+      VkPipelineStageFlags visibleStages = 0;
+      VkAccessFlags visibleAccess = 0;
+      VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+    std::vector<State> states(resources.size());
+    for (uint32_t r = 0; r < resources.size(); r++) {
+      const Resource &resource = resources[r];
+      states[r].layout = resource.initialLayout;
+      if (resource.previousUsage) {
+        bool write = canWrite(*resource.previousUsage);
+        UsageInfo previous = usageInfo(*resource.previousUsage, write);
+        if (write) {
+          states[r].writeStages = previous.stages;
+          states[r].writeAccess = previous.access & WRITE_ACCESS;
+        } else {
+          states[r].readStages = previous.stages;
+        }
+      }
+    }
+
+    // one access per resource and pass, so a pass never waits on itself
+    struct Merged {
+      uint32_t resource;
+      VkPipelineStageFlags stages;
+      VkAccessFlags access;
+      VkImageLayout layout;
+      bool write;
+      bool passTransitions;
+      VkImageLayout finalLayout;
+    };
+
+    batches.assign(passes.size(), Batch{});
+    for (uint32_t p = 0; p < passes.size(); p++) {
+      const RenderGraphPass &pass = passes[p];
+      if (pass.culled) {
+        continue;
+      }
+      std::vector<Merged> merged;
+      for (const RenderGraphPass::Access &access : pass.accesses) {
+        UsageInfo info = usageInfo(access.usage, access.write);
+        auto existing = std::find_if(merged.begin(), merged.end(), [&](const Merged &m) { return m.resource == access.resource; });
+        if (existing == merged.end()) {
+          merged.push_back({access.resource, info.stages, info.access, info.layout, access.write, access.passTransitions, access.finalLayout});
+          continue;
+        }
+        if (resources[access.resource].isImage && existing->layout != info.layout) {
+          throw std::runtime_error("Render graph pass " + pass.name + " uses " + resources[access.resource].name + " in two layouts");
+        }
+        existing->stages |= info.stages;
+        existing->access |= info.access;
+        existing->write = existing->write || access.write;
+        existing->passTransitions = existing->passTransitions || access.passTransitions;
+        if (access.passTransitions) {
+          existing->finalLayout = access.finalLayout;
+        }
+      }
+
+      Batch &batch = batches[p];
+      for (const Merged &m : merged) {
+        const Resource &resource = resources[m.resource];
+        State &state = states[m.resource];
+        // a transient's contents don't carry over from whatever used its memory before
+        bool discard = resource.transient && resource.firstPass == p;
+
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkImageLayout oldLayout = state.layout;
+        if (discard) {
+          oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+          // wait for the earlier transients sharing its memory to be done with it
+          const Transient &transient = transients[resource.transientIndex];
+          for (uint32_t r = 0; r < resources.size(); r++) {
+            const Resource &other = resources[r];
+            if (!other.transient || other.transientIndex == UINT32_MAX || r == m.resource) {
+              continue;
+            }
+            const Transient &earlier = transients[other.transientIndex];
+            bool sharesMemory = earlier.block == transient.block &&
+                earlier.offset < transient.offset + transient.requirements.size &&
+                transient.offset < earlier.offset + earlier.requirements.size;
+            if (sharesMemory && earlier.lastPass < p) {
+              srcStages |= states[r].writeStages | states[r].readStages;
+              srcAccess |= states[r].writeAccess;
+            }
+          }
+        }
+        bool transition = resource.isImage && !m.passTransitions && oldLayout != m.layout;
+
+        bool needed = transition || discard;
+        if (!discard) {
+          if (m.write || transition) {
+            // write after write or after read, or a layout change which counts as a write
+            srcStages = state.writeStages | state.readStages;
+            srcAccess = state.writeAccess;
+          } else if (state.writeStages != 0 &&
+              ((state.visibleStages & m.stages) != m.stages || (state.visibleAccess & m.access) != m.access)) {
+            // read after write that isn't visible here yet
+            srcStages = state.writeStages;
+            srcAccess = state.writeAccess;
+          }
+          needed = needed || srcStages != 0;
+        }
+
+        if (needed && !(discard && m.passTransitions && srcStages == 0)) {
+          batch.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+          batch.dstStages |= m.stages;
+          if (resource.isImage && transition) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = m.access;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = m.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image({m.resource});
+            barrier.subresourceRange = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+            batch.imageBarriers.push_back(barrier);
+          } else if (srcAccess != 0 && resource.isImage && !m.passTransitions) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = m.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = state.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image({m.resource});
+            barrier.subresourceRange = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+            batch.imageBarriers.push_back(barrier);
+          } else if (srcAccess != 0 && !resource.isImage) {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = m.access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = resource.buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            batch.bufferBarriers.push_back(barrier);
+          } else if (srcAccess != 0) {
+            // the pass changes the layout itself, so only the memory needs ordering here
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = m.access;
+            batch.memoryBarriers.push_back(barrier);
+          }
+          // with no access to make available it's an execution dependency, the stage masks are enough
+        }
+
+        if (m.write || transition || discard) {
+          state.writeStages = m.stages;
+          state.writeAccess = m.access & WRITE_ACCESS;
+          state.readStages = 0;
+          state.visibleStages = m.stages;
+          state.visibleAccess = m.access;
+        } else {
+          state.readStages |= m.stages;
+          if (needed) {
+            state.visibleStages |= m.stages;
+            state.visibleAccess |= m.access;
+          }
+        }
+        if (resource.isImage) {
+          state.layout = m.passTransitions ? m.finalLayout : m.layout;
+        }
+      }
+
+      if (batch.srcStages != 0) {
+        stats_.barrierCalls++;
+        stats_.imageBarriers += static_cast<uint32_t>(batch.imageBarriers.size());
+        stats_.bufferBarriers += static_cast<uint32_t>(batch.bufferBarriers.size());
+        stats_.memoryBarriers += static_cast<uint32_t>(batch.memoryBarriers.size());
+      }
+    }
+  }
+
+  void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    PROFILE_FUNCTION();
+    if (batches.size() != passes.size()) {
+      throw std::runtime_error("Render graph executed without being compiled");
+    }
+    for (uint32_t p = 0; p < passes.size(); p++) {
+      if (passes[p].culled) {
+        continue;
+      }
+      const Batch &batch = batches[p];
+      if (batch.srcStages != 0) {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            batch.srcStages,
+            batch.dstStages,
+            0,
+            static_cast<uint32_t>(batch.memoryBarriers.size()),
+            batch.memoryBarriers.data(),
+            static_cast<uint32_t>(batch.bufferBarriers.size()),
+            batch.bufferBarriers.data(),
+            static_cast<uint32_t>(batch.imageBarriers.size()),
+            batch.imageBarriers.data());
+      }
+      if (passes[p].execute) {
+        passes[p].execute(commandBuffer);
+      }
+    }
+  }
+}
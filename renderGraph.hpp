@@ -0,0 +1,201 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // how a pass touches a resource, each maps to the stages, access mask and image layout used for
+  // barriers. Whether it's a read or a write comes from RenderGraphPass::read or write.
+  enum class RenderGraphUsage {
+    colorAttachment,
+    depthAttachment,
+    fragmentSampled,
+    computeSampled,
+    computeStorage,
+    vertexStorage,
+    // read only
+    vertexAttribute,
+    indirect,
+    // transfer source when read, destination when written
+    transfer,
+    // read only, the last use of a swap chain image
+    present
+  };
+
+  struct RenderGraphResource {
+    uint32_t index = UINT32_MAX;
+  };
+
+  // an image the graph creates and owns, it only lives from its first to its last pass
+  struct RenderGraphImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+  };
+
+  struct RenderGraphStats {
+    uint32_t passes = 0;
+    uint32_t culledPasses = 0;
+    // one vkCmdPipelineBarrier per pass that has any hazard, carrying all of them
+    uint32_t barrierCalls = 0;
+    uint32_t imageBarriers = 0;
+    uint32_t bufferBarriers = 0;
+    uint32_t memoryBarriers = 0;
+    uint32_t transientImages = 0;
+    // what the transient images are bound to, and what they'd take with a block each
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize transientBytesWithoutAliasing = 0;
+    bool aliasing = false;
+  };
+
+  class RenderGraph;
+
+  class RenderGraphPass {
+    public:
+      RenderGraphPass &read(RenderGraphResource resource, RenderGraphUsage usage);
+      RenderGraphPass &write(RenderGraphResource resource, RenderGraphUsage usage);
+      // Attachments whose layouts the pass changes itself, by a VkRenderPass's initial and final
+      // layouts or HelloVulkanSwapChain::beginRendering. The graph only orders them and takes
+      // finalLayout as their layout afterwards.
+      RenderGraphPass &attachment(
+          RenderGraphResource resource,
+          RenderGraphUsage usage,
+          VkImageLayout finalLayout);
+      // never culled, e.g. it presents or writes something read back on the host
+      RenderGraphPass &sideEffects();
+
+    private:
+      friend class RenderGraph;
+
+      struct Access {
+        uint32_t resource;
+        RenderGraphUsage usage;
+        bool write;
+        bool passTransitions;
+        VkImageLayout finalLayout;
+      };
+
+      RenderGraphPass(std::string name, std::function<void(VkCommandBuffer)> execute)
+          : name{std::move(name)}, execute{std::move(execute)} {}
+
+      std::string name;
+      std::function<void(VkCommandBuffer)> execute;
+      std::vector<Access> accesses;
+      bool hasSideEffects = false;
+      bool culled = false;
+  };
+
+  // A frame's passes in submission order, each declaring what it reads and writes. compile()
+  // culls passes nothing depends on, works out one batched barrier in front of each pass with
+  // only the hazards that need it, and places the transient images in shared memory blocks so
+  // ones whose lifetimes don't overlap use the same memory. execute() then records it all.
+  //
+  // Declarations are cleared by reset() every frame, the transient images stay and are only rebuilt
+  // when the transients or their lifetimes change, the old ones going through the device's deletion
+  // queue. Every compile in between reuses the same images, so a graph with transients is still
+  // needed per frame in flight. HELLO_VULKAN_DISABLE_TRANSIENT_ALIASING=1 gives
+  // every transient its own memory, to compare.
+  class RenderGraph {
+    public:
+      explicit RenderGraph(HelloVulkanDevice &device);
+      ~RenderGraph();
+
+      RenderGraph(const RenderGraph &) = delete;
+      RenderGraph &operator=(const RenderGraph &) = delete;
+
+      // forgets the passes and resources, keeps the transient images for the next compile
+      void reset();
+
+      // previousUsage is the last thing that touched it before this graph, nothing for resources
+      // that are already synchronised, e.g. a swap chain image behind the acquire semaphore
+      RenderGraphResource importImage(
+          const std::string &name,
+          VkImage image,
+          VkImageAspectFlags aspect,
+          VkImageLayout layout,
+          std::optional<RenderGraphUsage> previousUsage = std::nullopt);
+      RenderGraphResource importBuffer(
+          const std::string &name,
+          VkBuffer buffer,
+          std::optional<RenderGraphUsage> previousUsage = std::nullopt);
+      RenderGraphResource createImage(const std::string &name, const RenderGraphImageDesc &desc);
+
+      // the reference stays valid until reset()
+      RenderGraphPass &addPass(const std::string &name, std::function<void(VkCommandBuffer)> execute);
+
+      void compile();
+      void execute(VkCommandBuffer commandBuffer);
+
+      // transient ones only exist after compile(), and only they have a view made by the graph
+      VkImage image(RenderGraphResource resource) const;
+      VkImageView imageView(RenderGraphResource resource) const;
+      VkBuffer buffer(RenderGraphResource resource) const;
+      bool isCulled(const std::string &passName) const;
+
+      void setAliasing(bool enabled) { aliasing = enabled; }
+      const RenderGraphStats &stats() const { return stats_; }
+
+    private:
+      struct Resource {
+        std::string name;
+        bool isImage = false;
+        bool transient = false;
+        VkImage image = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        std::optional<RenderGraphUsage> previousUsage;
+        RenderGraphImageDesc desc;
+        VkImageUsageFlags imageUsage = 0;
+        // live passes, UINT32_MAX while unused
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        // transient only, index into transients
+        uint32_t transientIndex = UINT32_MAX;
+      };
+
+      // a transient image with its memory placement, kept between compiles
+      struct Transient {
+        RenderGraphImageDesc desc;
+        VkImageUsageFlags usage = 0;
+        uint32_t firstPass = 0;
+        uint32_t lastPass = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements{};
+        uint32_t block = 0;
+        VkDeviceSize offset = 0;
+      };
+
+      struct Batch {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkMemoryBarrier> memoryBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+      };
+
+      void cullPasses();
+      void createTransients();
+      void destroyTransients();
+      void buildBarriers();
+
+      HelloVulkanDevice &device;
+      bool aliasing = true;
+      std::vector<Resource> resources;
+      std::deque<RenderGraphPass> passes;
+      // one per pass, recorded in front of it
+      std::vector<Batch> batches;
+      std::vector<Transient> transients;
+      std::vector<VkDeviceMemory> transientMemory;
+      bool transientsAliased = false;
+      RenderGraphStats stats_;
+  };
+}
@@ -0,0 +1,46 @@
+#include "samplerCache.hpp"
+
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  SamplerCache::SamplerCache(HelloVulkanDevice &device) : device{device} {}
+
+  SamplerCache::~SamplerCache() {
+    for (auto &sampler : samplers) {
+      vkDestroySampler(device.device(), sampler.second, nullptr);
+    }
+  }
+
+  VkSampler SamplerCache::get(const SamplerDesc &desc) {
+    bool anisotropy = desc.anisotropy && device.enabledFeatures().samplerAnisotropy;
+    Key key{desc.filter, desc.mipmapMode, desc.addressMode, anisotropy};
+
+    auto cached = samplers.find(key);
+    if (cached != samplers.end()) {
+      return cached->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = desc.filter;
+    samplerInfo.minFilter = desc.filter;
+    samplerInfo.mipmapMode = desc.mipmapMode;
+    samplerInfo.addressModeU = desc.addressMode;
+    samplerInfo.addressModeV = desc.addressMode;
+    samplerInfo.addressModeW = desc.addressMode;
+    samplerInfo.anisotropyEnable = anisotropy ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = anisotropy ? device.properties.limits.maxSamplerAnisotropy : 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    VkSampler sampler;
+    if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create sampler!");
+    }
+    samplers[key] = sampler;
+    return sampler;
+  }
+}
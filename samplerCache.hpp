@@ -0,0 +1,40 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  struct SamplerDesc {
+    VkFilter filter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    // uses the device's maximum when samplerAnisotropy is enabled
+    bool anisotropy = true;
+  };
+
+  // One VkSampler per distinct description, textures share them instead of each owning one.
+  // Samplers live as long as the cache.
+  class SamplerCache {
+    public:
+      explicit SamplerCache(HelloVulkanDevice &device);
+      ~SamplerCache();
+
+      SamplerCache(const SamplerCache &) = delete;
+      SamplerCache &operator=(const SamplerCache &) = delete;
+
+      VkSampler get(const SamplerDesc &desc);
+      size_t size() const { return samplers.size(); }
+
+    private:
+      // filter, mipmap mode, address mode and whether anisotropy ended up enabled
+      using Key = std::tuple<VkFilter, VkSamplerMipmapMode, VkSamplerAddressMode, bool>;
+
+      HelloVulkanDevice &device;
+      std::map<Key, VkSampler> samplers;
+  };
+}
@@ -0,0 +1,122 @@
+#include "shaderLibrary.hpp"
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace helloVulkan {
+
+  namespace {
+    struct EmbeddedShader {
+      const char *path;
+      const uint32_t *words;
+      size_t wordCount;
+    };
+
+#if __has_include("embeddedShaders.inc")
+    // each entry is HELLO_VULKAN_EMBEDDED_SHADER(identifier, "shaders/name.spv", {words...})
+#define HELLO_VULKAN_EMBEDDED_SHADER(identifier, path, ...) constexpr uint32_t identifier[] = __VA_ARGS__;
+#include "embeddedShaders.inc"
+#undef HELLO_VULKAN_EMBEDDED_SHADER
+
+#define HELLO_VULKAN_EMBEDDED_SHADER(identifier, path, ...) \
+    {path, identifier, sizeof(identifier) / sizeof(uint32_t)},
+    const EmbeddedShader EMBEDDED_SHADERS[] = {
+#include "embeddedShaders.inc"
+    };
+#undef HELLO_VULKAN_EMBEDDED_SHADER
+    constexpr size_t EMBEDDED_SHADER_COUNT = sizeof(EMBEDDED_SHADERS) / sizeof(EmbeddedShader);
+#else
+    const EmbeddedShader *EMBEDDED_SHADERS = nullptr;
+    constexpr size_t EMBEDDED_SHADER_COUNT = 0;
+#endif
+
+    struct LibraryState {
+      std::mutex mutex;
+      std::string overrideDirectory;
+      std::unordered_map<std::string, std::vector<uint32_t>> loadedFiles;
+      double loadTimeMs = 0.0;
+
+      LibraryState() {
+        if (const char *directory = std::getenv("HELLO_VULKAN_SHADER_DIR")) {
+          overrideDirectory = directory;
+        }
+      }
+    };
+
+    LibraryState &state() {
+      static LibraryState libraryState;
+      return libraryState;
+    }
+
+    const EmbeddedShader *findEmbedded(const std::string &path) {
+      for (size_t i = 0; i < EMBEDDED_SHADER_COUNT; i++) {
+        if (std::strcmp(EMBEDDED_SHADERS[i].path, path.c_str()) == 0) {
+          return &EMBEDDED_SHADERS[i];
+        }
+      }
+      return nullptr;
+    }
+
+    std::vector<uint32_t> readWords(const std::string &path) {
+      std::ifstream file{path, std::ios::ate | std::ios::binary};
+      if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+      }
+      size_t fileSize = static_cast<size_t>(file.tellg());
+      if (fileSize % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("SPIR-V file is not a whole number of words: " + path);
+      }
+      std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+      file.seekg(0);
+      file.read(reinterpret_cast<char *>(words.data()), fileSize);
+      return words;
+    }
+  }
+
+  ShaderCode ShaderLibrary::load(const std::string &path) {
+    PROFILE_FUNCTION();
+    LibraryState &libraryState = state();
+    auto loadStart = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock{libraryState.mutex};
+
+    ShaderCode code{};
+    const EmbeddedShader *embedded = findEmbedded(path);
+    if (embedded != nullptr && libraryState.overrideDirectory.empty()) {
+      code.words = embedded->words;
+      code.wordCount = embedded->wordCount;
+    } else {
+      std::string filePath = path;
+      if (!libraryState.overrideDirectory.empty()) {
+        // the override directory is flat, shaders/simpleShader.vert.spv is looked up as <dir>/simpleShader.vert.spv
+        auto nameStart = path.find_last_of('/');
+        filePath = libraryState.overrideDirectory + "/" +
+            (nameStart == std::string::npos ? path : path.substr(nameStart + 1));
+      }
+      std::vector<uint32_t> &words = libraryState.loadedFiles[path];
+      words = readWords(filePath);
+      code.words = words.data();
+      code.wordCount = words.size();
+    }
+
+    libraryState.loadTimeMs += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - loadStart).count();
+    return code;
+  }
+
+  bool ShaderLibrary::isEmbedded(const std::string &path) {
+    return findEmbedded(path) != nullptr;
+  }
+
+  double ShaderLibrary::loadTimeMs() {
+    LibraryState &libraryState = state();
+    std::lock_guard<std::mutex> lock{libraryState.mutex};
+    return libraryState.loadTimeMs;
+  }
+}
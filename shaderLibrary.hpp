@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace helloVulkan {
+
+  // A view of SPIR-V words, either compiled into the binary or loaded from the override directory
+  struct ShaderCode {
+    const uint32_t *words = nullptr;
+    size_t wordCount = 0;
+
+    size_t sizeInBytes() const { return wordCount * sizeof(uint32_t); }
+    bool empty() const { return wordCount == 0; }
+  };
+
+  // Shaders are looked up by their .spv path, e.g. "shaders/simpleShader.vert.spv". The Makefile
+  // compiles every shader into the binary (build/generated/embeddedShaders.inc), so normally
+  // nothing touches the filesystem. For iterating on shaders without a rebuild, set
+  // HELLO_VULKAN_SHADER_DIR and the .spv files in that directory are read instead, every time a
+  // pipeline is built. A binary built without the generated index falls back to the relative path.
+  class ShaderLibrary {
+    public:
+      // code loaded from a file stays valid until the same path is loaded again
+      static ShaderCode load(const std::string &path);
+      static bool isEmbedded(const std::string &path);
+      // total time spent in load() since startup
+      static double loadTimeMs();
+  };
+}
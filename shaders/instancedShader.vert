@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec3 colour;
+layout (location = 2) in mat4 instanceTransform;
+
+layout (push_constant) uniform Push {
+  mat4 transform;
+} push;
+
+layout (location = 0) out vec3 fragColour;
+
+void main() {
+  gl_Position = instanceTransform * (push.transform * position);
+  fragColour = colour;
+}
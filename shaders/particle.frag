@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec3 fragColour;
+layout (location = 1) in vec2 fragOffset;
+layout (location = 2) in float fragAlpha;
+
+layout (location = 0) out vec4 outColour;
+
+void main() {
+  // round particles with soft edges, blended additively
+  float falloff = 1.0 - dot(fragOffset, fragOffset);
+  if (falloff <= 0.0) {
+    discard;
+  }
+  outColour = vec4(fragColour, fragAlpha * falloff);
+}
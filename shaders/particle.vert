@@ -0,0 +1,47 @@
+#version 450
+
+// One quad per alive particle, built from gl_VertexIndex. The draw's instance count is the alive
+// list's length, so gl_InstanceIndex indexes the list.
+
+struct Particle {
+  // w is the age in seconds
+  vec4 position;
+  vec4 velocity;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Particles {
+  Particle particles[];
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer AliveLists {
+  uint aliveLists[];
+};
+
+layout (push_constant) uniform Push {
+  mat4 transform;
+  float particleSize;
+  float lifetime;
+  uint current;
+  uint maxParticles;
+} push;
+
+layout (location = 0) out vec3 fragColour;
+layout (location = 1) out vec2 fragOffset;
+layout (location = 2) out float fragAlpha;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+  Particle particle = particles[aliveLists[push.current * push.maxParticles + gl_InstanceIndex]];
+  vec2 corner = CORNERS[gl_VertexIndex];
+  vec4 centre = push.transform * vec4(particle.position.xyz, 1.0);
+  // screen aligned, the size is in clip space
+  gl_Position = centre + vec4(corner * push.particleSize * centre.w, 0.0, 0.0);
+
+  float life = clamp(particle.position.w / push.lifetime, 0.0, 1.0);
+  fragColour = mix(vec3(1.0, 0.8, 0.3), vec3(0.8, 0.2, 0.1), life);
+  fragOffset = corner;
+  fragAlpha = 1.0 - life;
+}
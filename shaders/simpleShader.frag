@@ -1,9 +1,18 @@
 #version 450
 
+// 0: vertex colour, 1: flat white, 2: depth
+layout (constant_id = 0) const uint COLOUR_MODE = 0;
+
 layout (location = 0) in vec3 inColour;
 
 layout (location = 0) out vec4 outColour;
 
 void main() {
-  outColour = vec4(inColour, 1.0);
+  if (COLOUR_MODE == 1) {
+    outColour = vec4(1.0);
+  } else if (COLOUR_MODE == 2) {
+    outColour = vec4(vec3(gl_FragCoord.z), 1.0);
+  } else {
+    outColour = vec4(inColour, 1.0);
+  }
 }
@@ -0,0 +1,53 @@
+#version 450
+
+// Programmable vertex pulling, see vertexPulling.hpp. There is no vertex input: the draw's record
+// is found by gl_InstanceIndex, every draw being one instance whose first instance is its index,
+// and the vertex is decoded from the words at gl_VertexIndex in the record's format.
+
+// VertexFormat
+const uint FORMAT_FULL = 0;
+const uint FORMAT_COMPACT = 1;
+const uint FORMAT_QUANTIZED = 2;
+
+layout (set = 0, binding = 0) readonly buffer Vertices {
+  uint words[];
+} vertices;
+
+struct Draw {
+  mat4 transform;
+  vec4 boundsMin;
+  vec4 boundsExtent;
+  uint format;
+  uint firstWord;
+  uint strideWords;
+  uint padding;
+};
+
+layout (set = 0, binding = 1) readonly buffer Draws {
+  Draw draws[];
+};
+
+layout (location = 0) out vec3 fragColour;
+
+void main() {
+  Draw draw = draws[gl_InstanceIndex];
+  uint base = draw.firstWord + uint(gl_VertexIndex) * draw.strideWords;
+
+  vec4 position;
+  vec3 colour;
+  if (draw.format == FORMAT_FULL) {
+    position = uintBitsToFloat(uvec4(
+        vertices.words[base], vertices.words[base + 1], vertices.words[base + 2], vertices.words[base + 3]));
+    colour = uintBitsToFloat(uvec3(vertices.words[base + 4], vertices.words[base + 5], vertices.words[base + 6]));
+  } else if (draw.format == FORMAT_COMPACT) {
+    position = vec4(uintBitsToFloat(uvec3(vertices.words[base], vertices.words[base + 1], vertices.words[base + 2])), 1.0);
+    colour = unpackUnorm4x8(vertices.words[base + 3]).rgb;
+  } else {
+    vec3 fraction = vec3(unpackUnorm2x16(vertices.words[base]), unpackUnorm2x16(vertices.words[base + 1]).x);
+    position = vec4(draw.boundsMin.xyz + fraction * draw.boundsExtent.xyz, 1.0);
+    colour = unpackUnorm4x8(vertices.words[base + 2]).rgb;
+  }
+
+  gl_Position = draw.transform * position;
+  fragColour = colour;
+}
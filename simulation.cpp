@@ -0,0 +1,91 @@
+#include "simulation.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+namespace helloVulkan {
+
+  Simulation::Simulation(const SimulationConfig &config)
+      : config{config},
+        stepDuration{std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(config.stepSeconds))} {
+    state.rotation = config.initialRotation;
+    SimulationSnapshot &snapshot = snapshots.back();
+    snapshot.previous = state;
+    snapshot.current = state;
+    snapshot.publishedAt = std::chrono::steady_clock::now();
+    snapshots.publish();
+    nextTick = snapshot.publishedAt + stepDuration;
+  }
+
+  Simulation::~Simulation() {
+    stop();
+  }
+
+  void Simulation::start() {
+    if (running()) {
+      return;
+    }
+    stopping.store(false);
+    nextTick = std::chrono::steady_clock::now() + stepDuration;
+    thread = std::thread{&Simulation::threadLoop, this};
+  }
+
+  void Simulation::stop() {
+    if (!running()) {
+      return;
+    }
+    stopping.store(true);
+    thread.join();
+  }
+
+  void Simulation::advance() {
+    auto now = std::chrono::steady_clock::now();
+    while (nextTick <= now) {
+      step();
+      nextTick += stepDuration;
+    }
+  }
+
+  void Simulation::threadLoop() {
+    while (!stopping.load(std::memory_order_relaxed)) {
+      std::this_thread::sleep_until(nextTick);
+      step();
+      // when a tick runs long the next ones follow straight away until it has caught up
+      nextTick += stepDuration;
+    }
+  }
+
+  void Simulation::step() {
+    PROFILE_FUNCTION();
+    auto stepStart = std::chrono::steady_clock::now();
+    SimulationState previous = state;
+    state.tick++;
+    state.rotation += config.rotationSpeed * static_cast<float>(config.stepSeconds);
+    if (config.stepCostMs > 0.0) {
+      auto busyUntil = stepStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double, std::milli>(config.stepCostMs));
+      while (std::chrono::steady_clock::now() < busyUntil) {
+      }
+    }
+
+    SimulationSnapshot &snapshot = snapshots.back();
+    snapshot.previous = previous;
+    snapshot.current = state;
+    snapshot.publishedAt = std::chrono::steady_clock::now();
+    snapshots.publish();
+    tickCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SimulationState Simulation::sample() {
+    const SimulationSnapshot &snapshot = snapshots.latest();
+    double sinceTick = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot.publishedAt).count();
+    float alpha = static_cast<float>(std::clamp(sinceTick / config.stepSeconds, 0.0, 1.0));
+
+    SimulationState sampled = snapshot.current;
+    sampled.rotation = glm::mix(snapshot.previous.rotation, snapshot.current.rotation, alpha);
+    return sampled;
+  }
+}
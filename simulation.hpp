@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace helloVulkan {
+
+  struct SimulationConfig {
+    double stepSeconds = 1.0 / 60.0;
+    // busy work per tick standing in for game logic, to measure what it costs the frame
+    double stepCostMs = 0.0;
+    // of the meshes about the x axis, in radians and radians a second. The start is a quarter turn
+    // back and the speed what the old per frame step of 0.01 came to at 60 frames a second.
+    float initialRotation = -1.57079633f;
+    float rotationSpeed = 0.6f;
+  };
+
+  // the state after one tick, never changed once published
+  struct SimulationState {
+    uint64_t tick = 0;
+    // of the meshes about the x axis, in radians
+    float rotation = 0.0f;
+  };
+
+  // the two latest ticks, frames are drawn somewhere between them
+  struct SimulationSnapshot {
+    SimulationState previous;
+    SimulationState current;
+    std::chrono::steady_clock::time_point publishedAt;
+  };
+
+  // One writer and one reader passing whole values without either waiting on the other. The writer
+  // fills the back slot and swaps it with the middle one, the reader swaps its front slot with the
+  // middle one whenever something newer is there.
+  template <typename T>
+  class TripleBuffer {
+    public:
+      // writer only
+      T &back() { return slots[backIndex]; }
+      void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+      }
+
+      // reader only, the latest published value
+      const T &latest() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+          frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+        return slots[frontIndex];
+      }
+
+    private:
+      static constexpr uint32_t INDEX_MASK = 3;
+      // set while the middle slot holds something the reader hasn't taken
+      static constexpr uint32_t FRESH = 4;
+
+      std::array<T, 3> slots{};
+      uint32_t backIndex = 0;
+      std::atomic<uint32_t> middle{1};
+      uint32_t frontIndex = 2;
+  };
+
+  // Fixed timestep simulation of the scene. start() runs the ticks in real time on a thread of
+  // its own, otherwise advance() runs whatever ticks are due on the caller's thread. Either way
+  // every tick publishes a snapshot and sample() interpolates the latest one, so what is drawn
+  // moves smoothly whatever the frame rate. That puts it up to one tick behind.
+  //
+  // One thread samples, the render thread or whoever calls advance().
+  class Simulation {
+    public:
+      explicit Simulation(const SimulationConfig &config);
+      ~Simulation();
+
+      Simulation(const Simulation &) = delete;
+      Simulation &operator=(const Simulation &) = delete;
+
+      void start();
+      void stop();
+      bool running() const { return thread.joinable(); }
+      // the ticks due by now, on the caller's thread. Not while running().
+      void advance();
+
+      SimulationState sample();
+      uint64_t ticks() const { return tickCount.load(std::memory_order_relaxed); }
+
+    private:
+      void step();
+      void threadLoop();
+
+      SimulationConfig config;
+      std::chrono::steady_clock::duration stepDuration;
+      // owned by whichever thread is stepping
+      SimulationState state;
+      std::chrono::steady_clock::time_point nextTick;
+      TripleBuffer<SimulationSnapshot> snapshots;
+      std::atomic<uint64_t> tickCount{0};
+
+      std::thread thread;
+      std::atomic<bool> stopping{false};
+  };
+}
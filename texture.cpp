@@ -0,0 +1,567 @@
+#include "texture.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  namespace {
+    constexpr uint8_t KTX2_IDENTIFIER[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    // identifier, 9 header words, 4 index words and 2 index quadwords
+    constexpr size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+    constexpr size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+    // KTX2 is little endian, so is everything this runs on
+    template <typename T>
+    T readLittleEndian(const uint8_t *data, size_t offset) {
+      T value;
+      std::memcpy(&value, data + offset, sizeof(T));
+      return value;
+    }
+
+    struct AstcFormat {
+      VkFormat unorm;
+      VkFormat srgb;
+      uint32_t blockWidth;
+      uint32_t blockHeight;
+    };
+
+    constexpr AstcFormat ASTC_FORMATS[] = {
+        {VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, 4, 4},
+        {VK_FORMAT_ASTC_5x4_UNORM_BLOCK, VK_FORMAT_ASTC_5x4_SRGB_BLOCK, 5, 4},
+        {VK_FORMAT_ASTC_5x5_UNORM_BLOCK, VK_FORMAT_ASTC_5x5_SRGB_BLOCK, 5, 5},
+        {VK_FORMAT_ASTC_6x5_UNORM_BLOCK, VK_FORMAT_ASTC_6x5_SRGB_BLOCK, 6, 5},
+        {VK_FORMAT_ASTC_6x6_UNORM_BLOCK, VK_FORMAT_ASTC_6x6_SRGB_BLOCK, 6, 6},
+        {VK_FORMAT_ASTC_8x5_UNORM_BLOCK, VK_FORMAT_ASTC_8x5_SRGB_BLOCK, 8, 5},
+        {VK_FORMAT_ASTC_8x6_UNORM_BLOCK, VK_FORMAT_ASTC_8x6_SRGB_BLOCK, 8, 6},
+        {VK_FORMAT_ASTC_8x8_UNORM_BLOCK, VK_FORMAT_ASTC_8x8_SRGB_BLOCK, 8, 8},
+        {VK_FORMAT_ASTC_10x5_UNORM_BLOCK, VK_FORMAT_ASTC_10x5_SRGB_BLOCK, 10, 5},
+        {VK_FORMAT_ASTC_10x6_UNORM_BLOCK, VK_FORMAT_ASTC_10x6_SRGB_BLOCK, 10, 6},
+        {VK_FORMAT_ASTC_10x8_UNORM_BLOCK, VK_FORMAT_ASTC_10x8_SRGB_BLOCK, 10, 8},
+        {VK_FORMAT_ASTC_10x10_UNORM_BLOCK, VK_FORMAT_ASTC_10x10_SRGB_BLOCK, 10, 10},
+        {VK_FORMAT_ASTC_12x10_UNORM_BLOCK, VK_FORMAT_ASTC_12x10_SRGB_BLOCK, 12, 10},
+        {VK_FORMAT_ASTC_12x12_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK, 12, 12},
+    };
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void transitionLevels(
+          VkCommandBuffer commandBuffer,
+          VkImage image,
+          uint32_t baseLevel,
+          uint32_t levelCount,
+          VkImageLayout oldLayout,
+          VkImageLayout newLayout,
+          VkAccessFlags srcAccess,
+          VkAccessFlags dstAccess,
+          VkPipelineStageFlags srcStage,
+          VkPipelineStageFlags dstStage) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = oldLayout;
+      barrier.newLayout = newLayout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseMipLevel = baseLevel;
+      barrier.subresourceRange.levelCount = levelCount;
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = 1;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstAccessMask = dstAccess;
+      vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+  }
+
+  VkDeviceSize FormatBlockInfo::levelSize(uint32_t width, uint32_t height) const {
+    VkDeviceSize blocksWide = (width + blockWidth - 1) / blockWidth;
+    VkDeviceSize blocksHigh = (height + blockHeight - 1) / blockHeight;
+    return blocksWide * blocksHigh * blockBytes;
+  }
+
+  FormatBlockInfo formatBlockInfo(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_R8_UNORM:
+        return {1, 1, 1};
+      case VK_FORMAT_R8G8_UNORM:
+        return {2, 1, 1};
+      case VK_FORMAT_R8G8B8A8_UNORM:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+        return {4, 1, 1};
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return {8, 1, 1};
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return {16, 1, 1};
+
+      case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      case VK_FORMAT_BC4_UNORM_BLOCK:
+      case VK_FORMAT_BC4_SNORM_BLOCK:
+        return {8, 4, 4};
+      case VK_FORMAT_BC2_UNORM_BLOCK:
+      case VK_FORMAT_BC2_SRGB_BLOCK:
+      case VK_FORMAT_BC3_UNORM_BLOCK:
+      case VK_FORMAT_BC3_SRGB_BLOCK:
+      case VK_FORMAT_BC5_UNORM_BLOCK:
+      case VK_FORMAT_BC5_SNORM_BLOCK:
+      case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+      case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+      case VK_FORMAT_BC7_UNORM_BLOCK:
+      case VK_FORMAT_BC7_SRGB_BLOCK:
+        return {16, 4, 4};
+
+      case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+      case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+      case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        return {8, 4, 4};
+      case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+      case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        return {16, 4, 4};
+
+      default:
+        break;
+    }
+    for (const AstcFormat &astc : ASTC_FORMATS) {
+      if (format == astc.unorm || format == astc.srgb) {
+        return {16, astc.blockWidth, astc.blockHeight};
+      }
+    }
+    return {};
+  }
+
+  uint32_t fullMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+      levels++;
+    }
+    return levels;
+  }
+
+  Ktx2Header parseKtx2(const uint8_t *data, size_t size, const std::string &name) {
+    if (size < KTX2_LEVEL_INDEX_OFFSET || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+      throw std::runtime_error("Not a KTX2 file: " + name);
+    }
+
+    Ktx2Header header{};
+    header.format = static_cast<VkFormat>(readLittleEndian<uint32_t>(data, 12));
+    header.width = readLittleEndian<uint32_t>(data, 20);
+    header.height = readLittleEndian<uint32_t>(data, 24);
+    uint32_t depth = readLittleEndian<uint32_t>(data, 28);
+    uint32_t layerCount = readLittleEndian<uint32_t>(data, 32);
+    uint32_t faceCount = readLittleEndian<uint32_t>(data, 36);
+    header.levelCount = readLittleEndian<uint32_t>(data, 40);
+    uint32_t supercompressionScheme = readLittleEndian<uint32_t>(data, 44);
+
+    if (header.format == VK_FORMAT_UNDEFINED) {
+      throw std::runtime_error("KTX2 file needs transcoding, which isn't supported: " + name);
+    }
+    if (supercompressionScheme != 0) {
+      throw std::runtime_error("KTX2 supercompression isn't supported: " + name);
+    }
+    if (header.width == 0 || header.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+      throw std::runtime_error("Only 2D KTX2 textures are supported: " + name);
+    }
+    FormatBlockInfo block = formatBlockInfo(header.format);
+    if (block.blockBytes == 0) {
+      throw std::runtime_error("Unsupported KTX2 format " + std::to_string(header.format) + ": " + name);
+    }
+    if (header.levelCount > fullMipLevelCount(header.width, header.height)) {
+      throw std::runtime_error("KTX2 file has more levels than its size allows: " + name);
+    }
+
+    uint32_t storedLevels = std::max(header.levelCount, 1u);
+    if (size < KTX2_LEVEL_INDEX_OFFSET + storedLevels * KTX2_LEVEL_INDEX_ENTRY_SIZE) {
+      throw std::runtime_error("KTX2 level index is truncated: " + name);
+    }
+    header.levels.resize(storedLevels);
+    for (uint32_t level = 0; level < storedLevels; level++) {
+      size_t entry = KTX2_LEVEL_INDEX_OFFSET + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+      Ktx2Level &info = header.levels[level];
+      info.byteOffset = readLittleEndian<uint64_t>(data, entry);
+      info.byteLength = readLittleEndian<uint64_t>(data, entry + 8);
+
+      VkDeviceSize expected = block.levelSize(
+          std::max(header.width >> level, 1u), std::max(header.height >> level, 1u));
+      if (info.byteLength != expected || info.byteOffset > size || info.byteLength > size - info.byteOffset) {
+        throw std::runtime_error("KTX2 level " + std::to_string(level) + " is malformed: " + name);
+      }
+    }
+    return header;
+  }
+
+  Texture::Texture(
+        HelloVulkanDevice &device,
+        VkFormat format,
+        VkExtent2D extent,
+        uint32_t mipLevels,
+        VkImageUsageFlags usage) :
+        device{device},
+        format_{format},
+        extent_{extent},
+        mipLevels_{mipLevels} {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image_, memory);
+    gpuBytes_ = device.allocationSize(memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image_;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &view_) != VK_SUCCESS) {
+      vkDestroyImage(device.device(), image_, nullptr);
+      device.freeMemory(memory);
+      throw std::runtime_error("failed to create texture image view!");
+    }
+  }
+
+  Texture::~Texture() {
+    // frames in flight may still sample it, e.g. when the streamer replaces or evicts a level
+    device.deferDestroyImage(image_, view_, memory);
+  }
+
+  TextureLoader::TextureLoader(HelloVulkanDevice &device, SamplerCache &samplerCache) :
+        device{device},
+        samplerCache{samplerCache} {}
+
+  TextureLoader::~TextureLoader() {
+    for (InFlightBatch &batch : inFlight) {
+      vkWaitForFences(device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+      retire(batch);
+    }
+  }
+
+  bool TextureLoader::canGenerateMips(VkFormat format) {
+    constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+        VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (device.getFormatProperties(format).optimalTilingFeatures & required) == required;
+  }
+
+  VkDeviceSize TextureLoader::stage(const void *data, VkDeviceSize size, uint32_t alignment) {
+    // copy offsets have to be a multiple of the texel block size and of 4, block sizes are powers of two
+    VkDeviceSize align = std::max<VkDeviceSize>(
+        {alignment, 4, device.properties.limits.optimalBufferCopyOffsetAlignment});
+    VkDeviceSize offset = (staging.size() + align - 1) / align * align;
+    staging.resize(offset + size);
+    std::memcpy(staging.data() + offset, data, size);
+    return offset;
+  }
+
+  std::shared_ptr<Texture> TextureLoader::createTexture(
+        VkFormat format,
+        uint32_t width,
+        uint32_t height,
+        uint32_t mipLevels,
+        bool generateMips,
+        const SamplerDesc &sampler) {
+    // transfer support is implied by sampling on a 1.0 device, there is no feature bit for it
+    if ((device.getFormatProperties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+      throw std::runtime_error("Texture format " + std::to_string(format) + " isn't supported by the device");
+    }
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (generateMips) {
+      usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    std::shared_ptr<Texture> texture{new Texture{device, format, {width, height}, mipLevels, usage}};
+    texture->sampler_ = samplerCache.get(sampler);
+    return texture;
+  }
+
+  std::shared_ptr<Texture> TextureLoader::loadKtx2(const std::string &path, const SamplerDesc &sampler) {
+    std::ifstream file{path, std::ios::ate | std::ios::binary};
+    if (!file.is_open()) {
+      throw std::runtime_error("Failed to open file: " + path);
+    }
+    std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return loadKtx2(bytes, path, sampler);
+  }
+
+  std::shared_ptr<Texture> TextureLoader::loadKtx2(
+        const std::vector<uint8_t> &bytes,
+        const std::string &name,
+        const SamplerDesc &sampler) {
+    auto parseStart = std::chrono::steady_clock::now();
+    Ktx2Header header = parseKtx2(bytes.data(), bytes.size(), name);
+    stats_.loadMs += millisecondsSince(parseStart);
+    return loadKtx2Levels(bytes.data(), header, 0, sampler);
+  }
+
+  std::shared_ptr<Texture> TextureLoader::loadKtx2Levels(
+        const uint8_t *data,
+        const Ktx2Header &header,
+        uint32_t firstLevel,
+        const SamplerDesc &sampler) {
+    PROFILE_FUNCTION();
+    auto loadStart = std::chrono::steady_clock::now();
+    uint32_t storedLevels = static_cast<uint32_t>(header.levels.size());
+    if (firstLevel >= storedLevels) {
+      throw std::runtime_error("KTX2 file doesn't store level " + std::to_string(firstLevel));
+    }
+    FormatBlockInfo block = formatBlockInfo(header.format);
+    uint32_t width = std::max(header.width >> firstLevel, 1u);
+    uint32_t height = std::max(header.height >> firstLevel, 1u);
+
+    bool generateMips = header.levelCount == 0 && canGenerateMips(header.format);
+    uint32_t mipLevels = generateMips ? fullMipLevelCount(width, height) : storedLevels - firstLevel;
+    std::shared_ptr<Texture> texture = createTexture(header.format, width, height, mipLevels, generateMips, sampler);
+
+    PendingUpload upload{texture, {}};
+    for (uint32_t level = firstLevel; level < storedLevels; level++) {
+      const Ktx2Level &info = header.levels[level];
+      VkBufferImageCopy region{};
+      region.bufferOffset = stage(data + info.byteOffset, info.byteLength, block.blockBytes);
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = level - firstLevel;
+      region.imageSubresource.baseArrayLayer = 0;
+      region.imageSubresource.layerCount = 1;
+      region.imageOffset = {0, 0, 0};
+      region.imageExtent = {std::max(header.width >> level, 1u), std::max(header.height >> level, 1u), 1};
+      upload.regions.push_back(region);
+    }
+    pending.push_back(std::move(upload));
+
+    stats_.textures++;
+    stats_.compressedTextures += block.compressed() ? 1 : 0;
+    stats_.loadMs += millisecondsSince(loadStart);
+    return texture;
+  }
+
+  std::shared_ptr<Texture> TextureLoader::loadPixels(
+        uint32_t width,
+        uint32_t height,
+        VkFormat format,
+        const void *pixels,
+        const SamplerDesc &sampler) {
+    PROFILE_FUNCTION();
+    auto loadStart = std::chrono::steady_clock::now();
+    FormatBlockInfo block = formatBlockInfo(format);
+    if (block.blockBytes == 0 || block.compressed()) {
+      throw std::runtime_error("loadPixels needs a known uncompressed format, got " + std::to_string(format));
+    }
+
+    bool generateMips = canGenerateMips(format);
+    uint32_t mipLevels = generateMips ? fullMipLevelCount(width, height) : 1;
+    std::shared_ptr<Texture> texture = createTexture(format, width, height, mipLevels, generateMips, sampler);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = stage(pixels, block.levelSize(width, height), block.blockBytes);
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width, height, 1};
+    pending.push_back({texture, {region}});
+
+    stats_.textures++;
+    stats_.loadMs += millisecondsSince(loadStart);
+    return texture;
+  }
+
+  void TextureLoader::recordUpload(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const PendingUpload &upload) {
+    Texture &texture = *upload.texture;
+    uint32_t copiedLevels = static_cast<uint32_t>(upload.regions.size());
+
+    transitionLevels(
+        commandBuffer, texture.image_, 0, texture.mipLevels_,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(
+        commandBuffer,
+        stagingBuffer,
+        texture.image_,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        copiedLevels,
+        upload.regions.data());
+
+    // levels before the last copied one aren't blit sources, they're done
+    if (copiedLevels > 1) {
+      transitionLevels(
+          commandBuffer, texture.image_, 0, copiedLevels - 1,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    // each generated level is a linear downsample of the one above it
+    for (uint32_t level = copiedLevels; level < texture.mipLevels_; level++) {
+      transitionLevels(
+          commandBuffer, texture.image_, level - 1, 1,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+      VkImageBlit blit{};
+      blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+      blit.srcOffsets[1] = {
+          static_cast<int32_t>(std::max(texture.extent_.width >> (level - 1), 1u)),
+          static_cast<int32_t>(std::max(texture.extent_.height >> (level - 1), 1u)),
+          1};
+      blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+      blit.dstOffsets[1] = {
+          static_cast<int32_t>(std::max(texture.extent_.width >> level, 1u)),
+          static_cast<int32_t>(std::max(texture.extent_.height >> level, 1u)),
+          1};
+      vkCmdBlitImage(
+          commandBuffer,
+          texture.image_,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          texture.image_,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          1,
+          &blit,
+          VK_FILTER_LINEAR);
+
+      transitionLevels(
+          commandBuffer, texture.image_, level - 1, 1,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+      stats_.generatedMipLevels++;
+    }
+
+    transitionLevels(
+        commandBuffer, texture.image_, texture.mipLevels_ - 1, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  }
+
+  void TextureLoader::submit() {
+    PROFILE_FUNCTION();
+    if (pending.empty()) {
+      return;
+    }
+    auto submitStart = std::chrono::steady_clock::now();
+
+    InFlightBatch batch{};
+    device.createBuffer(
+        staging.size(),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        batch.stagingBuffer,
+        batch.stagingMemory);
+    void *data;
+    vkMapMemory(device.device(), batch.stagingMemory, 0, staging.size(), 0, &data);
+    std::memcpy(data, staging.data(), staging.size());
+    vkUnmapMemory(device.device(), batch.stagingMemory);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = device.getCommandPool();
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate texture upload command buffer!");
+    }
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+    for (const PendingUpload &upload : pending) {
+      recordUpload(batch.commandBuffer, batch.stagingBuffer, upload);
+    }
+    vkEndCommandBuffer(batch.commandBuffer);
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create texture upload fence!");
+    }
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit texture uploads!");
+    }
+
+    FormatBlockInfo rgba8 = formatBlockInfo(VK_FORMAT_R8G8B8A8_UNORM);
+    for (PendingUpload &upload : pending) {
+      const Texture &texture = *upload.texture;
+      stats_.gpuBytes += texture.gpuBytes_;
+      for (uint32_t level = 0; level < texture.mipLevels_; level++) {
+        stats_.uncompressedGpuBytes += rgba8.levelSize(
+            std::max(texture.extent_.width >> level, 1u), std::max(texture.extent_.height >> level, 1u));
+      }
+      batch.textures.push_back(std::move(upload.texture));
+    }
+    inFlight.push_back(std::move(batch));
+    stats_.bytesUploaded += staging.size();
+    stats_.batches++;
+    staging.clear();
+    pending.clear();
+    stats_.loadMs += millisecondsSince(submitStart);
+  }
+
+  void TextureLoader::flush() {
+    submit();
+    auto waitStart = std::chrono::steady_clock::now();
+    for (InFlightBatch &batch : inFlight) {
+      vkWaitForFences(device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    }
+    poll();
+    stats_.loadMs += millisecondsSince(waitStart);
+  }
+
+  uint32_t TextureLoader::poll() {
+    uint32_t readyCount = 0;
+    for (auto batch = inFlight.begin(); batch != inFlight.end();) {
+      if (vkGetFenceStatus(device.device(), batch->fence) != VK_SUCCESS) {
+        ++batch;
+        continue;
+      }
+      readyCount += static_cast<uint32_t>(batch->textures.size());
+      retire(*batch);
+      batch = inFlight.erase(batch);
+    }
+    return readyCount;
+  }
+
+  void TextureLoader::retire(InFlightBatch &batch) {
+    for (const std::shared_ptr<Texture> &texture : batch.textures) {
+      texture->ready_ = true;
+    }
+    vkDestroyFence(device.device(), batch.fence, nullptr);
+    vkFreeCommandBuffers(device.device(), device.getCommandPool(), 1, &batch.commandBuffer);
+    vkDestroyBuffer(device.device(), batch.stagingBuffer, nullptr);
+    device.freeMemory(batch.stagingMemory);
+  }
+}
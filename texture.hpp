@@ -0,0 +1,167 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+#include "samplerCache.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  // Size of a texel block, 1x1 for uncompressed formats. blockBytes is 0 for formats the texture
+  // code doesn't know about.
+  struct FormatBlockInfo {
+    uint32_t blockBytes = 0;
+    uint32_t blockWidth = 1;
+    uint32_t blockHeight = 1;
+
+    bool compressed() const { return blockWidth > 1 || blockHeight > 1; }
+    VkDeviceSize levelSize(uint32_t width, uint32_t height) const;
+  };
+  FormatBlockInfo formatBlockInfo(VkFormat format);
+
+  // One mip level of a KTX2 file, offsets are into the file
+  struct Ktx2Level {
+    uint64_t byteOffset = 0;
+    uint64_t byteLength = 0;
+  };
+
+  // The parts of a KTX2 header the loader needs. Only 2D, non-array, non-supercompressed files
+  // with a real vkFormat are accepted, Basis Universal payloads would need transcoding.
+  struct Ktx2Header {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // 0 in the file means "generate the chain", the single stored level is in levels[0]
+    uint32_t levelCount = 0;
+    std::vector<Ktx2Level> levels;
+  };
+
+  // throws on anything malformed or unsupported, name is only used in the messages
+  Ktx2Header parseKtx2(const uint8_t *data, size_t size, const std::string &name);
+
+  // A sampled 2D image. Created by TextureLoader, not usable until the loader's flush() has run.
+  class Texture {
+    public:
+      ~Texture();
+
+      Texture(const Texture &) = delete;
+      Texture &operator=(const Texture &) = delete;
+
+      VkImage image() const { return image_; }
+      VkImageView view() const { return view_; }
+      VkSampler sampler() const { return sampler_; }
+      VkFormat format() const { return format_; }
+      VkExtent2D extent() const { return extent_; }
+      uint32_t mipLevels() const { return mipLevels_; }
+      VkDeviceSize gpuBytes() const { return gpuBytes_; }
+      bool ready() const { return ready_; }
+
+    private:
+      friend class TextureLoader;
+      Texture(HelloVulkanDevice &device, VkFormat format, VkExtent2D extent, uint32_t mipLevels, VkImageUsageFlags usage);
+
+      HelloVulkanDevice &device;
+      VkImage image_ = VK_NULL_HANDLE;
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      VkImageView view_ = VK_NULL_HANDLE;
+      VkSampler sampler_ = VK_NULL_HANDLE;
+      VkFormat format_;
+      VkExtent2D extent_;
+      uint32_t mipLevels_;
+      VkDeviceSize gpuBytes_ = 0;
+      bool ready_ = false;
+  };
+
+  struct TextureLoadStats {
+    uint32_t textures = 0;
+    uint32_t compressedTextures = 0;
+    uint32_t batches = 0;
+    uint32_t generatedMipLevels = 0;
+    VkDeviceSize bytesUploaded = 0;
+    VkDeviceSize gpuBytes = 0;
+    // what the same textures would have taken as RGBA8 with the same mip chains
+    VkDeviceSize uncompressedGpuBytes = 0;
+    // parsing, staging, submitting and, for flush(), waiting for the uploads
+    double loadMs = 0.0;
+  };
+
+  // Queues texture uploads and submits them in batches. The load functions create the image and copy
+  // the data into a CPU side staging area, submit() uploads everything queued with one staging buffer,
+  // one command buffer and one submit, generating missing mips with vkCmdBlitImage on the way.
+  // Textures become ready() once poll() sees their batch's fence signalled, flush() submits and waits.
+  //
+  // Compressed KTX2 payloads are copied as they are, they are never decoded on the CPU. Mips are
+  // generated only for formats the device can blit and filter linearly, which rules out the
+  // compressed ones, so those get just the levels in the file.
+  class TextureLoader {
+    public:
+      TextureLoader(HelloVulkanDevice &device, SamplerCache &samplerCache);
+      // waits for batches still in flight
+      ~TextureLoader();
+
+      TextureLoader(const TextureLoader &) = delete;
+      TextureLoader &operator=(const TextureLoader &) = delete;
+
+      std::shared_ptr<Texture> loadKtx2(const std::string &path, const SamplerDesc &sampler = {});
+      std::shared_ptr<Texture> loadKtx2(const std::vector<uint8_t> &bytes, const std::string &name, const SamplerDesc &sampler = {});
+      // levels [firstLevel, levelCount) of an already parsed file as an image the size of firstLevel,
+      // for streaming in part of the chain. The file must store every level.
+      std::shared_ptr<Texture> loadKtx2Levels(
+          const uint8_t *data,
+          const Ktx2Header &header,
+          uint32_t firstLevel,
+          const SamplerDesc &sampler = {});
+      // tightly packed pixels of an uncompressed format, the whole mip chain is generated from them
+      std::shared_ptr<Texture> loadPixels(
+          uint32_t width,
+          uint32_t height,
+          VkFormat format,
+          const void *pixels,
+          const SamplerDesc &sampler = {});
+
+      // no-ops with nothing queued
+      void submit();
+      void flush();
+      // retires batches the GPU has finished, returns how many textures became ready
+      uint32_t poll();
+      size_t pendingCount() const { return pending.size(); }
+      size_t inFlightBatchCount() const { return inFlight.size(); }
+      const TextureLoadStats &stats() const { return stats_; }
+
+    private:
+      struct PendingUpload {
+        std::shared_ptr<Texture> texture;
+        // levels copied from staging, the rest of the chain is blitted from the last of them
+        std::vector<VkBufferImageCopy> regions;
+      };
+
+      struct InFlightBatch {
+        VkFence fence;
+        VkCommandBuffer commandBuffer;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        std::vector<std::shared_ptr<Texture>> textures;
+      };
+
+      void retire(InFlightBatch &batch);
+      bool canGenerateMips(VkFormat format);
+      VkDeviceSize stage(const void *data, VkDeviceSize size, uint32_t alignment);
+      std::shared_ptr<Texture> createTexture(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool generateMips, const SamplerDesc &sampler);
+      void recordUpload(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const PendingUpload &upload);
+
+      HelloVulkanDevice &device;
+      SamplerCache &samplerCache;
+      std::vector<uint8_t> staging;
+      std::vector<PendingUpload> pending;
+      std::vector<InFlightBatch> inFlight;
+      TextureLoadStats stats_;
+  };
+
+  // levels in a full chain down to 1x1
+  uint32_t fullMipLevelCount(uint32_t width, uint32_t height);
+}
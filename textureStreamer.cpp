@@ -0,0 +1,211 @@
+#include "textureStreamer.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace helloVulkan {
+
+  TextureStreamer::TextureStreamer(
+        HelloVulkanDevice &device,
+        SamplerCache &samplerCache,
+        const TextureStreamerConfig &config) :
+        device{device},
+        config{config},
+        loader{device, samplerCache} {
+    stats_.budgetBytes = config.budgetBytes;
+    if (stats_.budgetBytes == 0) {
+      MemoryBudget budget = device.queryMemoryBudget();
+      stats_.budgetBytes = budget.available && budget.deviceLocalBudget > budget.deviceLocalUsage
+          ? static_cast<VkDeviceSize>((budget.deviceLocalBudget - budget.deviceLocalUsage) * config.budgetFraction)
+          : TextureStreamerConfig::DEFAULT_BUDGET_BYTES;
+    }
+  }
+
+  uint32_t TextureStreamer::levelForCoverage(
+        uint32_t width,
+        uint32_t height,
+        uint32_t levelCount,
+        float screenPixels,
+        float uvRepeat) {
+    float texelsPerPixel = std::max(width, height) * uvRepeat / std::max(screenPixels, 1.0f);
+    if (texelsPerPixel <= 1.0f) {
+      return 0;
+    }
+    uint32_t level = static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel)));
+    return std::min(level, levelCount - 1);
+  }
+
+  StreamedTextureId TextureStreamer::add(std::shared_ptr<const std::vector<uint8_t>> source, const std::string &name) {
+    StreamedTexture texture{};
+    texture.header = parseKtx2(source->data(), source->size(), name);
+    uint32_t levelCount = static_cast<uint32_t>(texture.header.levels.size());
+    if (texture.header.levelCount == 0 || levelCount != fullMipLevelCount(texture.header.width, texture.header.height)) {
+      throw std::runtime_error("Streamed textures need their whole mip chain in the file: " + name);
+    }
+    texture.source = std::move(source);
+
+    texture.tailLevel = levelCount - 1;
+    for (uint32_t level = 0; level < levelCount; level++) {
+      if (std::max(texture.header.width >> level, texture.header.height >> level) <= config.tailSize) {
+        texture.tailLevel = level;
+        break;
+      }
+    }
+    texture.wantedLevel = texture.tailLevel;
+    texture.tail = loader.loadKtx2Levels(texture.source->data(), texture.header, texture.tailLevel);
+    textures.push_back(std::move(texture));
+    stats_.textures++;
+    return static_cast<StreamedTextureId>(textures.size() - 1);
+  }
+
+  void TextureStreamer::request(StreamedTextureId id, float screenPixels, float uvRepeat) {
+    StreamedTexture &texture = textures[id];
+    uint32_t level = levelForCoverage(
+        texture.header.width,
+        texture.header.height,
+        static_cast<uint32_t>(texture.header.levels.size()),
+        screenPixels,
+        uvRepeat);
+    texture.wantedLevel = std::min(texture.wantedLevel, level);
+    texture.lastRequestedFrame = frame;
+  }
+
+  const std::shared_ptr<Texture> &TextureStreamer::texture(StreamedTextureId id) const {
+    const StreamedTexture &texture = textures[id];
+    return texture.detail ? texture.detail : texture.tail;
+  }
+
+  uint32_t TextureStreamer::residentLevel(StreamedTextureId id) const {
+    return currentLevel(textures[id]);
+  }
+
+  uint32_t TextureStreamer::currentLevel(const StreamedTexture &texture) const {
+    return texture.detail ? texture.detailLevel : texture.tailLevel;
+  }
+
+  VkDeviceSize TextureStreamer::estimateBytes(const StreamedTexture &texture, uint32_t firstLevel) const {
+    FormatBlockInfo block = formatBlockInfo(texture.header.format);
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = firstLevel; level < texture.header.levels.size(); level++) {
+      bytes += block.levelSize(
+          std::max(texture.header.width >> level, 1u), std::max(texture.header.height >> level, 1u));
+    }
+    return bytes;
+  }
+
+  VkDeviceSize TextureStreamer::committedBytes() const {
+    VkDeviceSize bytes = 0;
+    for (const StreamedTexture &texture : textures) {
+      bytes += texture.tail->gpuBytes();
+      bytes += texture.detail ? texture.detail->gpuBytes() : 0;
+      bytes += texture.loading ? texture.loading->gpuBytes() : 0;
+    }
+    return bytes;
+  }
+
+  void TextureStreamer::retire(std::shared_ptr<Texture> texture) {
+    if (texture) {
+      retiredBytes.emplace_back(device.currentFrame(), texture->gpuBytes());
+    }
+  }
+
+  bool TextureStreamer::makeRoom(VkDeviceSize bytes, VkDeviceSize &committed) {
+    while (committed + bytes > stats_.budgetBytes) {
+      StreamedTexture *victim = nullptr;
+      for (StreamedTexture &texture : textures) {
+        if (!texture.detail || texture.lastRequestedFrame == frame) {
+          continue;
+        }
+        if (victim == nullptr || texture.lastRequestedFrame < victim->lastRequestedFrame) {
+          victim = &texture;
+        }
+      }
+      if (victim == nullptr) {
+        return false;
+      }
+      committed -= victim->detail->gpuBytes();
+      retire(std::move(victim->detail));
+      victim->detail = nullptr;
+      stats_.evictions++;
+    }
+    return true;
+  }
+
+  void TextureStreamer::update() {
+    PROFILE_FUNCTION();
+    loader.poll();
+    for (StreamedTexture &texture : textures) {
+      if (texture.loading && texture.loading->ready()) {
+        retire(std::move(texture.detail));
+        texture.detail = std::move(texture.loading);
+        texture.detailLevel = texture.loadingLevel;
+        texture.loading = nullptr;
+        stats_.uploadsCompleted++;
+      }
+    }
+    uint64_t completed = device.completedFrame();
+    while (!retiredBytes.empty() && retiredBytes.front().first <= completed) {
+      retiredBytes.pop_front();
+    }
+
+    // textures in view that want more detail, the ones furthest from what they asked for first
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < textures.size(); i++) {
+      const StreamedTexture &texture = textures[i];
+      if (!texture.loading && texture.lastRequestedFrame == frame && texture.wantedLevel < currentLevel(texture)) {
+        candidates.push_back(i);
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+      uint32_t deficitA = currentLevel(textures[a]) - textures[a].wantedLevel;
+      uint32_t deficitB = currentLevel(textures[b]) - textures[b].wantedLevel;
+      return deficitA > deficitB;
+    });
+
+    VkDeviceSize committed = committedBytes();
+    stats_.budgetLimitedRequests = 0;
+    uint32_t started = 0;
+    for (uint32_t index : candidates) {
+      if (started == config.maxUploadsPerUpdate) {
+        break;
+      }
+      StreamedTexture &texture = textures[index];
+      // the finest level at or above the wanted one that fits, the old detail image stays committed
+      // until the new one replaces it
+      uint32_t level = texture.wantedLevel;
+      while (level < currentLevel(texture) && !makeRoom(estimateBytes(texture, level), committed)) {
+        level++;
+      }
+      if (level != texture.wantedLevel) {
+        stats_.budgetLimitedRequests++;
+      }
+      if (level == currentLevel(texture)) {
+        continue;
+      }
+      texture.loading = loader.loadKtx2Levels(texture.source->data(), texture.header, level);
+      texture.loadingLevel = level;
+      committed += texture.loading->gpuBytes();
+      stats_.uploadsStarted++;
+      started++;
+    }
+    loader.submit();
+
+    stats_.committedBytes = committed;
+    stats_.residentBytes = committed;
+    for (const auto &entry : retiredBytes) {
+      stats_.residentBytes += entry.second;
+    }
+    stats_.uploadsInFlight = 0;
+    stats_.levelDeficit = 0;
+    for (StreamedTexture &texture : textures) {
+      stats_.uploadsInFlight += texture.loading ? 1 : 0;
+      if (texture.lastRequestedFrame == frame && texture.wantedLevel < currentLevel(texture)) {
+        stats_.levelDeficit += currentLevel(texture) - texture.wantedLevel;
+      }
+      texture.wantedLevel = texture.tailLevel;
+    }
+    frame++;
+  }
+}
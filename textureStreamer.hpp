@@ -0,0 +1,114 @@
+#pragma once
+
+#include "helloVulkanDevice.hpp"
+#include "samplerCache.hpp"
+#include "texture.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace helloVulkan {
+
+  struct TextureStreamerConfig {
+    static constexpr VkDeviceSize DEFAULT_BUDGET_BYTES = 256ull << 20;
+
+    // 0 derives it from VK_EXT_memory_budget, or uses DEFAULT_BUDGET_BYTES when that's unavailable
+    VkDeviceSize budgetBytes = 0;
+    // share of the free device local memory taken when deriving the budget
+    double budgetFraction = 0.5;
+    // levels this size and smaller are loaded up front and never evicted
+    uint32_t tailSize = 64;
+    // detail uploads started per update, spreads a big camera move over several frames
+    uint32_t maxUploadsPerUpdate = 4;
+  };
+
+  struct TextureStreamerStats {
+    uint32_t textures = 0;
+    VkDeviceSize budgetBytes = 0;
+    // tails, detail images and uploads in flight, what the budget is checked against
+    VkDeviceSize committedBytes = 0;
+    // committed plus replaced and evicted images the device hasn't released yet, what it actually holds
+    VkDeviceSize residentBytes = 0;
+    uint64_t uploadsStarted = 0;
+    uint64_t uploadsCompleted = 0;
+    uint64_t evictions = 0;
+    uint32_t uploadsInFlight = 0;
+    // last update only: requests that got a coarser level than asked for because of the budget
+    uint32_t budgetLimitedRequests = 0;
+    // last update only: levels short of what was requested, summed over the requested textures
+    uint32_t levelDeficit = 0;
+  };
+
+  using StreamedTextureId = uint32_t;
+
+  // Keeps only the mips the current view needs resident. Every texture has its small mip tail loaded
+  // up front, draws request the level their screen coverage calls for and update() uploads a detail
+  // image holding that level and everything below it, asynchronously through a TextureLoader. When
+  // the budget would be exceeded the detail images of the least recently requested textures are
+  // evicted, dropping them back to their tail.
+  //
+  // Sources are KTX2 files storing the whole chain, kept in memory in place of reading them from disk.
+  class TextureStreamer {
+    public:
+      TextureStreamer(HelloVulkanDevice &device, SamplerCache &samplerCache, const TextureStreamerConfig &config = {});
+
+      TextureStreamer(const TextureStreamer &) = delete;
+      TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+      StreamedTextureId add(std::shared_ptr<const std::vector<uint8_t>> source, const std::string &name);
+
+      // screenPixels is how many pixels the texture's longer side covers on screen, uvRepeat how often
+      // it repeats across that. Takes the finest level requested since the last update.
+      void request(StreamedTextureId id, float screenPixels, float uvRepeat = 1.0f);
+      // once per frame, after the frame's requests
+      void update();
+
+      // detail image when there is one, the tail otherwise. Not ready() until the first update has
+      // uploaded the tail.
+      const std::shared_ptr<Texture> &texture(StreamedTextureId id) const;
+      uint32_t residentLevel(StreamedTextureId id) const;
+      const TextureStreamerStats &stats() const { return stats_; }
+
+      // level whose texel density best matches the screen coverage, clamped to [0, levelCount)
+      static uint32_t levelForCoverage(uint32_t width, uint32_t height, uint32_t levelCount, float screenPixels, float uvRepeat);
+
+    private:
+      struct StreamedTexture {
+        std::shared_ptr<const std::vector<uint8_t>> source;
+        Ktx2Header header;
+        uint32_t tailLevel = 0;
+        std::shared_ptr<Texture> tail;
+        // levels [detailLevel, end), null when only the tail is resident
+        std::shared_ptr<Texture> detail;
+        uint32_t detailLevel = 0;
+        std::shared_ptr<Texture> loading;
+        uint32_t loadingLevel = 0;
+        // finest level requested since the last update, tailLevel when there was no request
+        uint32_t wantedLevel = 0;
+        uint64_t lastRequestedFrame = 0;
+      };
+
+      uint32_t currentLevel(const StreamedTexture &texture) const;
+      VkDeviceSize estimateBytes(const StreamedTexture &texture, uint32_t firstLevel) const;
+      VkDeviceSize committedBytes() const;
+      // evicts least recently requested detail images until bytes more fit, never touching textures
+      // requested this frame. committed is kept up to date. False when evicting isn't enough.
+      bool makeRoom(VkDeviceSize bytes, VkDeviceSize &committed);
+      // drops the streamer's reference, the image itself is released through the device's
+      // deferred destruction once the frames that may sample it have retired
+      void retire(std::shared_ptr<Texture> texture);
+
+      HelloVulkanDevice &device;
+      TextureStreamerConfig config;
+      TextureLoader loader;
+      std::vector<StreamedTexture> textures;
+      // device frame and size of each retired image, for residentBytes only
+      std::deque<std::pair<uint64_t, VkDeviceSize>> retiredBytes;
+      uint64_t frame = 1;
+      TextureStreamerStats stats_;
+  };
+}
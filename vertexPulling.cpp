@@ -0,0 +1,325 @@
+#include "vertexPulling.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace helloVulkan {
+
+  namespace {
+    // one per draw, matches Draw in shaders/vertexPulling.vert (std430)
+    struct DrawRecord {
+      glm::mat4 transform;
+      // xyz, quantized meshes only
+      glm::vec4 boundsMin;
+      glm::vec4 boundsExtent;
+      uint32_t format;
+      uint32_t firstWord;
+      uint32_t strideWords;
+      uint32_t padding;
+    };
+    static_assert(sizeof(DrawRecord) == 112, "DrawRecord has to match the shader's std430 layout");
+    static_assert(sizeof(Model::Vertex) == 7 * sizeof(uint32_t), "VertexFormat::full copies Model::Vertex as it is");
+
+    uint32_t floatBits(float value) {
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return bits;
+    }
+
+    // unpackUnorm4x8 order, red in the low byte, alpha 1
+    uint32_t packColour(const glm::vec3 &colour) {
+      auto channel = [](float value) {
+        return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+      };
+      return channel(colour.x) | channel(colour.y) << 8 | channel(colour.z) << 16 | 0xffu << 24;
+    }
+
+    uint32_t quantize(float value, float min, float extent) {
+      return static_cast<uint32_t>(std::lround(std::clamp((value - min) / extent, 0.0f, 1.0f) * 65535.0f));
+    }
+  }
+
+  uint32_t vertexFormatWords(VertexFormat format) {
+    switch (format) {
+      case VertexFormat::full:
+        return 7;
+      case VertexFormat::compact:
+        return 4;
+      case VertexFormat::quantized:
+        return 3;
+    }
+    throw std::runtime_error("Unknown vertex format");
+  }
+
+  VertexPulling::VertexPulling(
+        HelloVulkanDevice &device,
+        uint32_t frameCount,
+        uint32_t wordCapacity,
+        uint32_t indexCapacity)
+      : device{device},
+        pool{device, static_cast<uint32_t>(sizeof(uint32_t)), wordCapacity, indexCapacity} {
+    const VkPhysicalDeviceFeatures &features = device.enabledFeatures();
+    const char *disable = std::getenv("HELLO_VULKAN_DISABLE_MULTI_DRAW");
+    multiDraw_ = features.multiDrawIndirect && features.drawIndirectFirstInstance &&
+        (disable == nullptr || std::string{disable} != "1");
+    frames.resize(frameCount);
+    createLayouts(frameCount);
+  }
+
+  VertexPulling::~VertexPulling() {
+    VkDevice vkDevice = device.device();
+    for (FrameBuffers &buffers : frames) {
+      if (buffers.records != VK_NULL_HANDLE) {
+        device.deferDestroyBuffer(buffers.records, buffers.recordsMemory);
+      }
+      if (buffers.commands != VK_NULL_HANDLE) {
+        device.deferDestroyBuffer(buffers.commands, buffers.commandsMemory);
+      }
+    }
+    VkDescriptorPool retiredPool = descriptorPool;
+    device.deferDestruction([vkDevice, retiredPool] { vkDestroyDescriptorPool(vkDevice, retiredPool, nullptr); });
+    vkDestroyPipelineLayout(vkDevice, pipelineLayout_, nullptr);
+    vkDestroyDescriptorSetLayout(vkDevice, setLayout, nullptr);
+  }
+
+  void VertexPulling::createLayouts(uint32_t frameCount) {
+    VkDevice vkDevice = device.device();
+    // the vertex words and the draw records
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+      bindings[binding].binding = binding;
+      bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[binding].descriptorCount = 1;
+      bindings[binding].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(vkDevice, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create vertex pulling descriptor set layout");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    if (vkCreatePipelineLayout(vkDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout_) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create vertex pulling pipeline layout");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * frameCount;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(vkDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create vertex pulling descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount, setLayout);
+    std::vector<VkDescriptorSet> sets(frameCount);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = frameCount;
+    setInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(vkDevice, &setInfo, sets.data()) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate vertex pulling descriptor sets");
+    }
+
+    // the pool's buffer never moves, the records are written in when the frame's buffer is made
+    VkDescriptorBufferInfo wordsInfo{};
+    wordsInfo.buffer = pool.getVertexBuffer();
+    wordsInfo.offset = 0;
+    wordsInfo.range = VK_WHOLE_SIZE;
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+      frames[frame].descriptorSet = sets[frame];
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = sets[frame];
+      write.dstBinding = 0;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.descriptorCount = 1;
+      write.pBufferInfo = &wordsInfo;
+      vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+    }
+  }
+
+  uint32_t VertexPulling::addMesh(
+        const std::vector<Model::Vertex> &vertices,
+        const std::vector<uint32_t> &indices,
+        VertexFormat format) {
+    Mesh mesh{};
+    mesh.format = format;
+    mesh.boundsMin = glm::vec3{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    if (!vertices.empty()) {
+      mesh.boundsMin = boundsMax = glm::vec3{vertices[0].position};
+      for (const Model::Vertex &vertex : vertices) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, glm::vec3{vertex.position});
+        boundsMax = glm::max(boundsMax, glm::vec3{vertex.position});
+      }
+    }
+    // a flat mesh still needs something to divide by
+    mesh.boundsExtent = glm::max(boundsMax - mesh.boundsMin, glm::vec3{1e-6f});
+
+    uint32_t stride = vertexFormatWords(format);
+    std::vector<uint32_t> words(vertices.size() * stride);
+    for (size_t i = 0; i < vertices.size(); i++) {
+      const Model::Vertex &vertex = vertices[i];
+      uint32_t *out = &words[i * stride];
+      switch (format) {
+        case VertexFormat::full:
+          std::memcpy(out, &vertex, sizeof(Model::Vertex));
+          break;
+        case VertexFormat::compact:
+          out[0] = floatBits(vertex.position.x);
+          out[1] = floatBits(vertex.position.y);
+          out[2] = floatBits(vertex.position.z);
+          out[3] = packColour(vertex.colour);
+          break;
+        case VertexFormat::quantized:
+          out[0] = quantize(vertex.position.x, mesh.boundsMin.x, mesh.boundsExtent.x) |
+                   quantize(vertex.position.y, mesh.boundsMin.y, mesh.boundsExtent.y) << 16;
+          out[1] = quantize(vertex.position.z, mesh.boundsMin.z, mesh.boundsExtent.z);
+          out[2] = packColour(vertex.colour);
+          break;
+      }
+    }
+
+    // every draw is indexed so they can all go in one indirect call
+    std::vector<uint32_t> sequential;
+    if (indices.empty()) {
+      sequential.resize(vertices.size());
+      std::iota(sequential.begin(), sequential.end(), 0u);
+    }
+    const std::vector<uint32_t> &meshIndices = indices.empty() ? sequential : indices;
+    mesh.range = pool.allocate(
+        words.data(),
+        static_cast<uint32_t>(words.size()),
+        meshIndices.data(),
+        static_cast<uint32_t>(meshIndices.size()));
+    meshes.push_back(mesh);
+    return static_cast<uint32_t>(meshes.size() - 1);
+  }
+
+  void VertexPulling::removeMesh(uint32_t mesh) {
+    pool.releaseDeferred(meshes[mesh].range);
+    meshes[mesh].range = {};
+  }
+
+  void VertexPulling::reserve(FrameBuffers &buffers, uint32_t drawCount) {
+    if (drawCount <= buffers.capacity) {
+      return;
+    }
+    uint32_t capacity = std::max(buffers.capacity, 64u);
+    while (capacity < drawCount) {
+      capacity *= 2;
+    }
+    // frames still in flight may be reading the old ones
+    if (buffers.records != VK_NULL_HANDLE) {
+      device.deferDestroyBuffer(buffers.records, buffers.recordsMemory);
+    }
+    if (buffers.commands != VK_NULL_HANDLE) {
+      device.deferDestroyBuffer(buffers.commands, buffers.commandsMemory);
+      buffers.commands = VK_NULL_HANDLE;
+    }
+
+    VkDevice vkDevice = device.device();
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkDeviceSize recordsSize = sizeof(DrawRecord) * static_cast<VkDeviceSize>(capacity);
+    device.createBuffer(recordsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, buffers.records, buffers.recordsMemory);
+    vkMapMemory(vkDevice, buffers.recordsMemory, 0, recordsSize, 0, &buffers.mappedRecords);
+    if (multiDraw_) {
+      VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(capacity);
+      device.createBuffer(commandsSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostVisible, buffers.commands, buffers.commandsMemory);
+      vkMapMemory(vkDevice, buffers.commandsMemory, 0, commandsSize, 0, &buffers.mappedCommands);
+    }
+    buffers.capacity = capacity;
+
+    // the set is only used by this frame, whose last submission has finished by the time it records
+    VkDescriptorBufferInfo recordsInfo{};
+    recordsInfo.buffer = buffers.records;
+    recordsInfo.offset = 0;
+    recordsInfo.range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = buffers.descriptorSet;
+    write.dstBinding = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &recordsInfo;
+    vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+  }
+
+  VertexPullingStats VertexPulling::record(VkCommandBuffer commandBuffer, uint32_t frame) {
+    PROFILE_FUNCTION();
+    VertexPullingStats stats{};
+    stats.multiDraw = multiDraw_;
+    uint32_t drawCount = static_cast<uint32_t>(draws.size());
+    if (drawCount == 0) {
+      return stats;
+    }
+    FrameBuffers &buffers = frames[frame];
+    reserve(buffers, drawCount);
+
+    auto *records = static_cast<DrawRecord *>(buffers.mappedRecords);
+    auto *commands = static_cast<VkDrawIndexedIndirectCommand *>(buffers.mappedCommands);
+    for (uint32_t i = 0; i < drawCount; i++) {
+      const Mesh &mesh = meshes[draws[i].mesh];
+      records[i].transform = draws[i].transform;
+      records[i].boundsMin = glm::vec4{mesh.boundsMin, 0.0f};
+      records[i].boundsExtent = glm::vec4{mesh.boundsExtent, 0.0f};
+      records[i].format = static_cast<uint32_t>(mesh.format);
+      records[i].firstWord = mesh.range.firstVertex;
+      records[i].strideWords = vertexFormatWords(mesh.format);
+      records[i].padding = 0;
+      if (commands != nullptr) {
+        // the draw's index as its first instance is how the shader finds its record
+        commands[i] = {mesh.range.indexCount, 1, mesh.range.firstIndex, 0, i};
+      }
+    }
+
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout_,
+        0,
+        1,
+        &buffers.descriptorSet,
+        0,
+        nullptr);
+    vkCmdBindIndexBuffer(commandBuffer, pool.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    if (multiDraw_) {
+      uint32_t maxDrawCount = std::max(1u, device.properties.limits.maxDrawIndirectCount);
+      for (uint32_t first = 0; first < drawCount; first += maxDrawCount) {
+        vkCmdDrawIndexedIndirect(
+            commandBuffer,
+            buffers.commands,
+            first * sizeof(VkDrawIndexedIndirectCommand),
+            std::min(maxDrawCount, drawCount - first),
+            sizeof(VkDrawIndexedIndirectCommand));
+        stats.drawCalls++;
+      }
+    } else {
+      for (uint32_t i = 0; i < drawCount; i++) {
+        const GeometryRange &range = meshes[draws[i].mesh].range;
+        vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, 0, i);
+        stats.drawCalls++;
+      }
+    }
+    stats.draws = drawCount;
+    return stats;
+  }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "geometryPool.hpp"
+#include "helloVulkanDevice.hpp"
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace helloVulkan {
+
+  // How a mesh's vertices are laid out in the pulling buffer, decoded in shaders/vertexPulling.vert
+  enum class VertexFormat : uint32_t {
+    // Model::Vertex as it is, 7 words
+    full = 0,
+    // float position with w = 1 and the colour as RGBA8, 4 words
+    compact = 1,
+    // position as 16 bit fractions of the mesh's bounding box with w = 1 and the colour as RGBA8,
+    // 3 words
+    quantized = 2,
+  };
+
+  uint32_t vertexFormatWords(VertexFormat format);
+
+  struct VertexPullingStats {
+    uint32_t draws = 0;
+    // vkCmdDrawIndexedIndirect or vkCmdDrawIndexed calls the draws went out in
+    uint32_t drawCalls = 0;
+    bool multiDraw = false;
+  };
+
+  // Programmable vertex pulling. Meshes are stored as plain words in one storage buffer, each in
+  // its own VertexFormat, and the vertex shader reads its vertex by gl_VertexIndex using the
+  // format and offset in a per draw record, found by gl_InstanceIndex as each draw's first
+  // instance is its index. There is no vertex input state, so meshes of any format share one
+  // pipeline, and with multiDrawIndirect a frame's draws go out in a single indirect call.
+  // Without it, or without drawIndirectFirstInstance, the draws are recorded one by one with the
+  // same pipeline and bindings.
+  //
+  // The pipeline is built by the caller from shaders/vertexPulling.vert with pipelineLayout() and
+  // no vertex bindings or attributes.
+  class VertexPulling {
+    public:
+      VertexPulling(
+          HelloVulkanDevice &device,
+          uint32_t frameCount,
+          uint32_t wordCapacity = GeometryPool::DEFAULT_VERTEX_CAPACITY,
+          uint32_t indexCapacity = GeometryPool::DEFAULT_INDEX_CAPACITY);
+      ~VertexPulling();
+
+      VertexPulling(const VertexPulling &) = delete;
+      VertexPulling &operator=(const VertexPulling &) = delete;
+
+      // encodes the mesh into format and returns its id, without indices it's a triangle list.
+      // Throws when the pool is out of space.
+      uint32_t addMesh(const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &indices, VertexFormat format);
+      // frames in flight may still draw it, the space is reused once they've retired
+      void removeMesh(uint32_t mesh);
+
+      // a frame's draws, mirroring DrawList: resize and set from several jobs, or push
+      void clear() { draws.clear(); }
+      void resize(size_t count) { draws.resize(count); }
+      void set(size_t index, uint32_t mesh, const glm::mat4 &transform) { draws[index] = {mesh, transform}; }
+      void push(uint32_t mesh, const glm::mat4 &transform) { draws.push_back({mesh, transform}); }
+
+      // Writes the draws into frame's buffers and records them. The caller binds the pipeline and
+      // sets its dynamic state first.
+      VertexPullingStats record(VkCommandBuffer commandBuffer, uint32_t frame);
+
+      VkPipelineLayout pipelineLayout() { return pipelineLayout_; }
+      bool multiDraw() const { return multiDraw_; }
+      uint32_t meshTriangles(uint32_t mesh) const { return meshes[mesh].range.indexCount / 3; }
+
+    private:
+      struct Mesh {
+        GeometryRange range;
+        VertexFormat format;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsExtent;
+      };
+
+      struct Draw {
+        uint32_t mesh;
+        glm::mat4 transform;
+      };
+
+      // per frame in flight, grown as needed
+      struct FrameBuffers {
+        VkBuffer records = VK_NULL_HANDLE;
+        VkDeviceMemory recordsMemory = VK_NULL_HANDLE;
+        void *mappedRecords = nullptr;
+        VkBuffer commands = VK_NULL_HANDLE;
+        VkDeviceMemory commandsMemory = VK_NULL_HANDLE;
+        void *mappedCommands = nullptr;
+        uint32_t capacity = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+      };
+
+      void createLayouts(uint32_t frameCount);
+      void reserve(FrameBuffers &buffers, uint32_t drawCount);
+
+      HelloVulkanDevice &device;
+      GeometryPool pool;
+      bool multiDraw_ = false;
+      std::vector<Mesh> meshes;
+      std::vector<Draw> draws;
+      std::vector<FrameBuffers> frames;
+
+      VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+      VkPipelineLayout pipelineLayout_ = VK_NULL_HANDLE;
+      VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  };
+}